@@ -0,0 +1,82 @@
+// Allocation accounting for the MEMORY line (phasetimer.h)
+//
+// The variants must still build against the original rawimage.h, so they allocate
+// with LoadFile / malloc / calloc as before and charge each allocation here once it
+// has succeeded:
+//
+//   LoadFile(searchfilename, &search, 0);
+//   AllocChargeImage(&search, ALLOC_SEARCH);
+//   unsigned long *counter = malloc(search.length * sizeof(unsigned long));
+//   if (!counter) FatalError("malloc failed for counter");
+//   AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
+//
+// The totals are bytes requested per kind and never decremented (frees are not
+// tracked), so they describe the run, not the live heap. Charging is atomic, so
+// per-thread allocations inside parallel regions can be charged where they happen.
+//
+// Include after rawimage.h.
+
+#ifndef ALLOCSTATS_H
+#define ALLOCSTATS_H
+
+#include <stdlib.h>
+
+// What an allocation is for, so memory use can be reported per subsystem
+enum AllocKind {
+    ALLOC_IMAGE,      // input image lines and line pointers
+    ALLOC_SEARCH,     // search image
+    ALLOC_COUNTERS,   // shared and per-thread search counters
+    ALLOC_SCRATCH,    // anything else a variant allocates
+    ALLOC_KINDS
+};
+
+static const char *const AllocNames[ALLOC_KINDS] = { "image", "search", "counters", "scratch" };
+
+// Bytes requested and allocation calls per kind
+unsigned long long AllocBytes[ALLOC_KINDS];
+unsigned long long AllocCalls[ALLOC_KINDS];
+
+// Charge calls allocations totalling bytes to a kind (safe inside parallel regions)
+void AllocChargeCalls(enum AllocKind kind, unsigned long long bytes, unsigned long long calls)
+{
+#ifdef _OPENMP
+    #pragma omp atomic
+#endif
+    AllocBytes[kind] += bytes;
+#ifdef _OPENMP
+    #pragma omp atomic
+#endif
+    AllocCalls[kind] += calls;
+}
+
+// Charge one allocation to a kind
+void AllocCharge(enum AllocKind kind, unsigned long long bytes)
+{
+    AllocChargeCalls(kind, bytes, 1);
+}
+
+// Charge an Image from LoadFile / ImageData: its line pointers and one block per line
+void AllocChargeImage(const struct Image *imagedata, enum AllocKind kind)
+{
+    AllocChargeCalls(kind,
+        (unsigned long long)imagedata->lines * (sizeof(struct Pixel*) + imagedata->linesize * sizeof(struct Pixel)),
+        imagedata->lines + 1);
+}
+
+// malloc, charged to kind
+void *RawAlloc(enum AllocKind kind, size_t bytes)
+{
+    void *p = malloc(bytes);
+    if (p != NULL) AllocCharge(kind, bytes);
+    return p;
+}
+
+// calloc, charged to kind
+void *RawCalloc(enum AllocKind kind, size_t count, size_t size)
+{
+    void *p = calloc(count, size);
+    if (p != NULL) AllocCharge(kind, (unsigned long long)count * size);
+    return p;
+}
+
+#endif
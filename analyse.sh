@@ -0,0 +1,383 @@
+#!/usr/bin/env bash
+# analyse.sh — scaling analysis and regression check over run_all.sh results
+#
+# Usage: bash analyse.sh [-b baseline_results.csv] [-t threshold_pct] [-T thresholds.csv]
+#                        [-r roofline.txt] [-o outdir] [results.csv]
+#
+# Times come from results.csv (default outputs/results.csv, verified runs only, the last
+# row per tag); where a stats.csv sits next to it the per-tag median replaces the single
+# run. A "variant" is a tag with its thread count taken out (A_tc2_t4_static_64 ->
+# A_tc2_static_64), so each variant is one thread series on one input set.
+#
+# Strong scaling (fixed input): the reference is the a_seq/b_seq row of the same input
+# set (a_seq_pgo/b_seq_pgo for _pgo variants, when build.pgo recorded them), or the
+# variant's own 1-thread time when no baseline was recorded.
+#   speedup S = T_ref / T_p, efficiency E = S / p,
+#   Karp-Flatt serial fraction e = (1/S - 1/p) / (1 - 1/p)   (p > 1)
+# and an Amdahl fit T_p = a + b/p by least squares: serial fraction a / (a + b) and the
+# limit T_ref / a as p grows. A Karp-Flatt e that rises with p points at overhead
+# (barriers, scheduling) rather than serial work, which the fit then underestimates.
+# Weak scaling (input grows with p): efficiency T_1 / T_p and scaled speedup p T_1 / T_p,
+# against the variant's own 1-thread run.
+#
+# With -b every tag is compared against the baseline results file (its stats.csv medians
+# likewise when present). A tag FAILs when it is slower by more than its threshold: -t
+# (default 5 %), or the first matching glob in a thresholds file of "pattern,pct" lines
+# (e.g. "B_tc1_*,15"). When both sides have bootstrap CIs a slowdown whose CIs still
+# overlap is reported as PASS (noise) rather than FAIL.
+#
+# With -r (the ab_roofline output run_all.sh keeps in outputs/roofline.txt) every run is
+# placed against the node's roofs, using the transform phase of its results.csv row:
+#   bandwidth roof  min(p * bw1, domains touched * bw_domain, bw_all) for p threads
+#                   packed onto NUMA domains in order (OMP_PROC_BIND=close)
+#   integer roof    min(p * int1, int_all), in instructions: ab_roofline's intops kernel
+#                   is scalar, one instruction per operation
+#   bw_util         compulsory traffic (each 12-byte pixel read and written once,
+#                   24 B/px) over the bandwidth roof: well below 1 means the run is
+#                   not limited by memory bandwidth
+# and, where the perf counters were available, retired instructions per pixel and
+# 64 B per LLC miss as the DRAM bytes: instructions/byte, achieved Ginstr/s, the roof at
+# that intensity, the fraction of it reached and which roof binds (memory / compute).
+#
+# Tags ending in _pgo (before any input-set suffix) come from the build.pgo flavour of an
+# executable, A_seq_pgo / B_seq_pgo included. Each is paired with the plain tag it was
+# built from: pgo_speedup is the plain time over the PGO time. When both have bootstrap
+# CIs and those overlap, the difference is reported as noise.
+#
+# Where results.csv has RAPL energy (run_all.sh energy_* columns), every run's joules per
+# gigapixel (package + DRAM over the input pixels) is set against the A_seq/B_seq run of
+# the same input set: energy_ratio above 1 means more joules for the same work, which
+# many threads can cost even when they are faster.
+#
+# Output: a text report on stdout and, in outdir (default outputs/analysis),
+#   scaling.csv      one row per tag
+#   variants.csv     one row per variant (best point, Amdahl fit)
+#   regressions.csv  one row per tag with -b (PASS / FAIL / IMPROVED / NEW / MISSING)
+#   roofline.csv     one row per tag with -r
+#   pgo.csv          one row per PGO / plain pair, when PGO builds ran
+#   energy.csv       one row per tag, when energy was measured
+# Exit status 1 when any tag FAILs, so a job or CI step can gate on it.
+
+set -euo pipefail
+
+BASELINE=""; THRESHOLD=5; THRESHOLDS=""; ROOFLINE=""; ANALYSIS_DIR="outputs/analysis"
+usage() { sed -n '4,5p' "$0" | sed 's/^# \{0,1\}//' >&2; exit 2; }
+while getopts "b:t:T:r:o:h" opt; do
+  case "$opt" in
+    b) BASELINE="$OPTARG" ;;
+    t) THRESHOLD="$OPTARG" ;;
+    T) THRESHOLDS="$OPTARG" ;;
+    r) ROOFLINE="$OPTARG" ;;
+    o) ANALYSIS_DIR="$OPTARG" ;;
+    *) usage ;;
+  esac
+done
+shift $(( OPTIND - 1 ))
+RESULTS="${1:-outputs/results.csv}"
+
+[[ -f "$RESULTS" ]] || { echo "analyse: no results file $RESULTS" >&2; exit 2; }
+[[ -z "$BASELINE" || -f "$BASELINE" ]] || { echo "analyse: no baseline file $BASELINE" >&2; exit 2; }
+[[ -z "$THRESHOLDS" || -f "$THRESHOLDS" ]] || { echo "analyse: no thresholds file $THRESHOLDS" >&2; exit 2; }
+if [[ -n "$ROOFLINE" ]] && ! grep -q '^ROOF summary ' "$ROOFLINE" 2>/dev/null; then
+  echo "analyse: no 'ROOF summary' line in $ROOFLINE" >&2; exit 2
+fi
+[[ "$THRESHOLD" =~ ^[0-9]+(\.[0-9]+)?$ ]] || { echo "analyse: -t wants a percentage, got '$THRESHOLD'" >&2; exit 2; }
+mkdir -p "$ANALYSIS_DIR"
+
+# load_times <results.csv> -> "tag,exe,threads,pixels,search_len,scaling,ms,ci_lo,ci_hi,n"
+# Only rows whose output MD5 and search counts matched are kept. Columns are found by
+# header name, so results.csv files from before the input set columns existed still
+# load (with empty pixels/search_len/scaling).
+load_times() {
+  local stats; stats="$(dirname "$1")/stats.csv"
+  [[ -f "$stats" ]] || stats=/dev/null
+  awk -F',' -v OFS=',' '
+    FNR == 1 { for (i = 1; i <= NF; ++i) col[FILENAME, $i] = i; next }
+    FILENAME == stats {
+      tag = $col[FILENAME, "tag"]
+      med[tag] = $col[FILENAME, "median_ms"]; lo[tag] = $col[FILENAME, "ci_lo_ms"]
+      hi[tag] = $col[FILENAME, "ci_hi_ms"]; n[tag] = $col[FILENAME, "n"]
+      next
+    }
+    $col[FILENAME, "md5_ok"] == 1 && !((FILENAME, "counts_ok") in col && $col[FILENAME, "counts_ok"] == "0") {
+      tag = $2
+      if (!(tag in row)) order[++ntags] = tag
+      get["pixels"] = get["search_len"] = get["scaling"] = ""
+      for (k in get) if ((FILENAME, k) in col) get[k] = $col[FILENAME, k]
+      row[tag] = $1 OFS $3 OFS get["pixels"] OFS get["search_len"] OFS get["scaling"]
+      ms[tag] = $col[FILENAME, "time_ms"]
+    }
+    END {
+      for (o = 1; o <= ntags; ++o) {
+        tag = order[o]
+        if (tag in med) print tag, row[tag], med[tag], lo[tag], hi[tag], n[tag]
+        else print tag, row[tag], ms[tag], "", "", 1
+      }
+    }' stats="$stats" "$stats" "$1"
+}
+
+CURRENT="$ANALYSIS_DIR/.current"
+load_times "$RESULTS" > "$CURRENT"
+trap 'rm -f "$CURRENT" "$ANALYSIS_DIR/.baseline"' EXIT
+
+# ---------- Scaling ----------
+awk -F',' -v OFS=',' -v dir="$ANALYSIS_DIR" '
+  # A_tc2_t4_static_64_n1M_s61 -> method A, threads 4, variant A_tc2_static_64_n1M_s61;
+  # weak sets also lose their pixel count, which changes with the thread count
+  function variant(tag, scaling,   v) {
+    v = tag
+    sub(/_t[0-9]+/, "", v)
+    if (scaling == "weak") sub(/_n[0-9]+[kMG]?/, "", v)
+    return v
+  }
+  function num(x) { return x == "" ? "" : sprintf("%.3f", x) }
+  {
+    tag = $1; exe = $2; p = $3 + 0; px = $4; sl = $5; sc = $6; t = $7 + 0
+    if (sc == "") sc = tag ~ /_weak_n/ ? "weak" : "strong"   # results.csv from before the set columns
+    m = substr(tag, 1, 1); fl = tag ~ /_pgo(_|$)/ ? "_pgo" : ""
+    if (exe ~ /_seq(_pgo)?$/) { seq[m, fl, px, sl] = t; next }
+    if (tag !~ /^[AB]_tc[0-9]+_t[0-9]+/ || t <= 0) next
+    v = variant(tag, sc)
+    if (!(v in vm)) { vorder[++nv] = v; vm[v] = m; vfl[v] = fl; vpx[v] = px; vsl[v] = sl; vsc[v] = (sc == "" ? "strong" : sc) }
+    k = ++np[v]; pt[v, k] = p; tm[v, k] = t; tg[v, k] = tag; pxs[v, k] = px
+    if (p == 1) one[v] = t
+  }
+  END {
+    SC = dir "/scaling.csv"; VC = dir "/variants.csv"
+    print "tag,variant,method,scaling,threads,pixels,search_len,time_ms,ref_ms,ref,speedup,efficiency,karp_flatt" > SC
+    print "variant,method,scaling,pixels,search_len,points,ref_ms,ref,best_threads,best_time_ms,best_speedup,best_efficiency,serial_fraction,max_speedup,r2" > VC
+    for (o = 1; o <= nv; ++o) {
+      v = vorder[o]; m = vm[v]; weak = vsc[v] == "weak"
+      # _pgo variants against the PGO baseline when it ran, else the plain one
+      fl = ((m, vfl[v], vpx[v], vsl[v]) in seq) ? vfl[v] : ""
+      if (!weak && (m, fl, vpx[v], vsl[v]) in seq) { ref = seq[m, fl, vpx[v], vsl[v]]; rk = m "_seq" fl }
+      else if (v in one) { ref = one[v]; rk = "t1" }
+      else { ref = ""; rk = "none" }
+
+      best = 0; sx = sy = sxx = sxy = 0; n = np[v]
+      for (k = 1; k <= n; ++k) {
+        p = pt[v, k]; t = tm[v, k]; S = E = kf = ""
+        if (ref != "") {
+          S = weak ? p * ref / t : ref / t
+          E = S / p
+          if (!weak && p > 1) kf = (1 / S - 1 / p) / (1 - 1 / p)
+        }
+        print tg[v, k], v, m, vsc[v], p, pxs[v, k], vsl[v], t, ref, rk, num(S), num(E), num(kf) > SC
+        if (best == 0 || t < tm[v, best]) best = k
+        x = 1 / p; sx += x; sy += t; sxx += x * x; sxy += x * t
+      }
+
+      # Amdahl: T_p = a + b/p over the strong series (needs two distinct thread counts)
+      f = mx = r2 = ""
+      if (!weak && n >= 2 && (d = n * sxx - sx * sx) > 1e-12) {
+        b = (n * sxy - sx * sy) / d; a = (sy - b * sx) / n
+        if (a < 0) a = 0
+        f = (a + b > 0) ? a / (a + b) : ""
+        if (f != "" && f > 1) f = 1
+        if (a > 0 && ref != "") mx = ref / a
+        ss = sr = 0
+        for (k = 1; k <= n; ++k) {
+          e = tm[v, k] - (a + b / pt[v, k]); sr += e * e
+          e = tm[v, k] - sy / n; ss += e * e
+        }
+        r2 = ss > 0 ? 1 - sr / ss : ""
+      }
+      bS = bE = ""
+      if (ref != "") {
+        bp = pt[v, best]
+        bS = weak ? bp * ref / tm[v, best] : ref / tm[v, best]; bE = bS / bp
+      }
+      print v, m, vsc[v], vpx[v], vsl[v], n, ref, rk, pt[v, best], tm[v, best], num(bS), num(bE), num(f), num(mx), num(r2) > VC
+    }
+  }' "$CURRENT"
+
+echo "==================== SCALING ($RESULTS) ===================="
+awk -F',' 'NR == 1 { next }
+  { rows[$3] = rows[$3] sprintf("  %-40s %-6s %3d %8s %4s %8.1f %8s %6s %8s %8s %6s\n",
+      $1, $3, $6, $8, $9, $10, $11 == "" ? "-" : $11, $12 == "" ? "-" : $12,
+      $13 == "" ? "-" : $13, $14 == "" ? "-" : $14, $15 == "" ? "-" : $15) }
+  END {
+    printf "  %-40s %-6s %3s %8s %4s %8s %8s %6s %8s %8s %6s\n",
+      "variant", "set", "pts", "ref", "bestT", "best_ms", "speedup", "eff", "serial_f", "max_S", "r2"
+    for (s in rows) printf "%s", rows[s]
+  }' "$ANALYSIS_DIR/variants.csv"
+echo "  (ref: A_seq/B_seq baseline run, A_seq_pgo/B_seq_pgo for _pgo variants, or t1 = the variant at 1 thread; weak sets show scaled speedup)"
+echo "  Per tag: $ANALYSIS_DIR/scaling.csv   Per variant: $ANALYSIS_DIR/variants.csv"
+
+# ---------- PGO against plain builds ----------
+if grep -q '^[AB]_\(tc\|seq\)[^,]*_pgo[_,]' "$CURRENT"; then
+  echo
+  echo "==================== PGO ($RESULTS) ===================="
+  awk -F',' -v OFS=',' -v out="$ANALYSIS_DIR/pgo.csv" '
+    { t[$1] = $7; lo[$1] = $8; hi[$1] = $9; th[$1] = $3; if ($1 ~ /_pgo(_|$)/) order[++n] = $1 }
+    END {
+      print "tag,plain_tag,threads,plain_ms,pgo_ms,pgo_speedup,verdict" > out
+      printf "  %-44s %4s %10s %10s %8s  %s\n", "tag", "p", "plain_ms", "pgo_ms", "speedup", "verdict"
+      for (o = 1; o <= n; ++o) {
+        tag = order[o]; plain = tag; sub(/_pgo/, "", plain)
+        if (!(plain in t) || t[tag] <= 0) { print tag, "", th[tag], "", t[tag], "", "NO_PLAIN" > out; continue }
+        sp = t[plain] / t[tag]
+        verdict = sp >= 1 ? "FASTER" : "SLOWER"
+        if (lo[tag] != "" && lo[plain] != "" && lo[tag] + 0 <= hi[plain] + 0 && lo[plain] + 0 <= hi[tag] + 0) verdict = "NOISE"
+        print tag, plain, th[tag], t[plain], t[tag], sprintf("%.3f", sp), verdict > out
+        printf "  %-44s %4d %10.3f %10.3f %8.3f  %s\n", tag, th[tag], t[plain], t[tag], sp, verdict
+        m = substr(tag, 1, 1); lsum[m] += log(sp); cnt[m]++
+      }
+      for (m in cnt) printf "  Method %s: geometric mean PGO speedup %.3f over %d pair(s)\n", m, exp(lsum[m] / cnt[m]), cnt[m]
+    }' "$CURRENT"
+  echo "  (speedup: plain time / PGO time; NOISE: bootstrap CIs overlap; NO_PLAIN: no plain run of that tag)"
+  echo "  Per pair: $ANALYSIS_DIR/pgo.csv"
+fi
+
+# ---------- Roofline placement ----------
+if [[ -n "$ROOFLINE" ]]; then
+  echo
+  echo "==================== ROOFLINE ($ROOFLINE) ===================="
+  awk -F',' -v OFS=',' -v out="$ANALYSIS_DIR/roofline.csv" '
+    function num(x, f) { return x == "" ? "" : sprintf(f, x) }
+    function min(a, b) { return a < b ? a : b }
+    FILENAME == roof {
+      if ($0 !~ /^ROOF summary /) next
+      n = split($0, kv, " ")
+      for (i = 3; i <= n; ++i) { split(kv[i], x, "="); R[x[1]] = x[2] + 0 }
+      next
+    }
+    FNR == 1 { for (i = 1; i <= NF; ++i) col[$i] = i; next }
+    $col["md5_ok"] == 1 && !("counts_ok" in col && $col["counts_ok"] == "0") && ("transform_ms" in col) && ("pixels" in col) {
+      tag = $2
+      if (!(tag in row)) order[++ntags] = tag
+      row[tag] = $0
+    }
+    END {
+      print "tag,threads,pixels,transform_ms,bw_roof_gb_s,int_roof_ginstr_s,compulsory_gb_s,bw_util," \
+            "instr_per_px,dram_bytes_per_px,instr_per_byte,achieved_ginstr_s,roof_ginstr_s,roof_util,bound" > out
+      printf "  %-40s %4s %10s %8s %7s %8s %8s %8s %6s  %s\n",
+        "tag", "p", "xform_ms", "GB/s", "bw_util", "instr/B", "Ginstr/s", "roof", "util", "bound"
+      for (o = 1; o <= ntags; ++o) {
+        split(row[order[o]], f, ",")
+        tag = order[o]; p = f[col["threads"]] + 0; px = f[col["pixels"]]; ms = f[col["transform_ms"]]
+        if (px == "" || ms == "" || ms + 0 <= 0) continue
+        px += 0; ms += 0
+
+        used = R["cpus_per_domain"] > 0 ? int((p + R["cpus_per_domain"] - 1) / R["cpus_per_domain"]) : 1
+        bw = min(min(p * R["bw1_gb_s"], used * R["bw_domain_gb_s"]), R["bw_all_gb_s"])
+        ir = min(p * R["int1_gops"], R["int_all_gops"])
+        gbs = 24 * px / (ms * 1e6)
+        bwu = bw > 0 ? gbs / bw : ""
+
+        ipx = ("transform_instr_per_px" in col) ? f[col["transform_instr_per_px"]] : ""
+        llc = ("transform_llc_miss_per_px" in col) ? f[col["transform_llc_miss_per_px"]] : ""
+        dram = llc == "" ? "" : 64 * llc
+        ai = gops = rf = ru = bound = ""
+        if (ipx != "") {
+          gops = ipx * px / (ms * 1e6)
+          if (dram != "" && dram > 0) {
+            ai = ipx / dram
+            rf = min(ir, ai * bw); bound = ai * bw < ir ? "memory" : "compute"
+          } else { rf = ir; bound = "compute" }
+          ru = rf > 0 ? gops / rf : ""
+        }
+        print tag, p, px, ms, num(bw, "%.3f"), num(ir, "%.3f"), num(gbs, "%.3f"), num(bwu, "%.4f"),
+              ipx, num(dram, "%.3f"), num(ai, "%.4f"), num(gops, "%.3f"), num(rf, "%.3f"), num(ru, "%.4f"), bound > out
+        printf "  %-40s %4d %10.1f %8.3f %6.1f%% %8s %8s %8s %6s  %s\n",
+          tag, p, ms, gbs, 100 * bwu, ai == "" ? "-" : sprintf("%.3f", ai), gops == "" ? "-" : sprintf("%.3f", gops),
+          rf == "" ? "-" : sprintf("%.3f", rf), ru == "" ? "-" : sprintf("%.1f%%", 100 * ru), bound == "" ? "-" : bound
+      }
+      printf "  roofs: bw1=%s bw_domain=%s bw_all=%s GB/s, int1=%s int_all=%s Ginstr/s (%d CPUs, %d domain(s))\n",
+        R["bw1_gb_s"], R["bw_domain_gb_s"], R["bw_all_gb_s"], R["int1_gops"], R["int_all_gops"], R["cpus"], R["domains"]
+    }' roof="$ROOFLINE" "$ROOFLINE" "$RESULTS"
+  echo "  (GB/s and bw_util: compulsory 24 B/px over the bandwidth roof; instr/B, Ginstr/s and roof need perf counters)"
+  echo "  Per tag: $ANALYSIS_DIR/roofline.csv"
+fi
+
+# ---------- Energy ----------
+if awk -F',' 'NR == 1 { for (i = 1; i <= NF; ++i) col[$i] = i; if (!("energy_j_per_gpx" in col)) exit 1; next }
+              $col["energy_j_per_gpx"] != "" { found = 1; exit } END { exit !found }' "$RESULTS"; then
+  echo
+  echo "==================== ENERGY ($RESULTS) ===================="
+  awk -F',' -v OFS=',' -v out="$ANALYSIS_DIR/energy.csv" '
+    FNR == 1 { for (i = 1; i <= NF; ++i) col[$i] = i; next }
+    $col["md5_ok"] == 1 && !("counts_ok" in col && $col["counts_ok"] == "0") && $col["energy_j_per_gpx"] != "" {
+      tag = $2
+      if (!(tag in row)) order[++ntags] = tag
+      row[tag] = $0
+      if ($1 ~ /_seq$/) seq[substr(tag, 1, 1), $col["pixels"], $col["search_len"]] = $col["energy_j_per_gpx"] + 0
+    }
+    END {
+      print "tag,threads,pixels,time_ms,energy_pkg_j,energy_dram_j,power_w,energy_j_per_gpx,ref_j_per_gpx,energy_ratio,transform_energy_j" > out
+      printf "  %-40s %4s %8s %8s %8s %10s %7s %9s\n", "tag", "p", "time_ms", "J", "W", "J/Gpx", "ratio", "xform_J"
+      for (o = 1; o <= ntags; ++o) {
+        split(row[order[o]], f, ",")
+        tag = order[o]; m = substr(tag, 1, 1); jpg = f[col["energy_j_per_gpx"]] + 0
+        k = m SUBSEP f[col["pixels"]] SUBSEP f[col["search_len"]]
+        ref = (k in seq) ? seq[k] : ""
+        ratio = (ref != "" && ref > 0) ? sprintf("%.3f", jpg / ref) : ""
+        j = f[col["energy_pkg_j"]] + f[col["energy_dram_j"]]
+        print tag, f[col["threads"]], f[col["pixels"]], f[col["time_ms"]], f[col["energy_pkg_j"]], f[col["energy_dram_j"]],
+              f[col["power_w"]], f[col["energy_j_per_gpx"]], ref, ratio, f[col["transform_energy_j"]] > out
+        printf "  %-40s %4d %8d %8.3f %8s %10.3f %7s %9s\n", tag, f[col["threads"]], f[col["time_ms"]], j,
+          f[col["power_w"]] == "" ? "-" : f[col["power_w"]], jpg, ratio == "" ? "-" : ratio,
+          f[col["transform_energy_j"]] == "" ? "-" : f[col["transform_energy_j"]]
+      }
+    }' "$RESULTS"
+  echo "  (J: package + DRAM over the whole run; ratio: J/Gpx over the A_seq/B_seq run of the same input set)"
+  echo "  Per tag: $ANALYSIS_DIR/energy.csv"
+fi
+
+# ---------- Regressions against a baseline ----------
+status=0
+if [[ -n "$BASELINE" ]]; then
+  load_times "$BASELINE" > "$ANALYSIS_DIR/.baseline"
+  echo
+  echo "==================== REGRESSIONS (vs $BASELINE, default threshold ${THRESHOLD}%) ===================="
+  awk -F',' -v OFS=',' -v def="$THRESHOLD" -v out="$ANALYSIS_DIR/regressions.csv" '
+    # glob (* ? only) -> anchored regex
+    function glob2re(g,   r) {
+      r = g
+      gsub(/[][.^$+(){}|\\]/, "\\\\&", r)
+      gsub(/\*/, ".*", r); gsub(/\?/, ".", r)
+      return "^" r "$"
+    }
+    function limit(tag,   i) {
+      for (i = 1; i <= nrules; ++i) if (tag ~ rule[i]) return pct[i]
+      return def
+    }
+    FILENAME == thr {
+      sub(/\r$/, "")
+      if ($0 ~ /^[[:space:]]*(#|$)/ || NF < 2) next
+      rule[++nrules] = glob2re($1); pct[nrules] = $2 + 0
+      next
+    }
+    FILENAME == base { b[$1] = $7; blo[$1] = $8; bhi[$1] = $9; next }
+    { c[$1] = $7; clo[$1] = $8; chi[$1] = $9; order[++n] = $1 }
+    END {
+      print "tag,baseline_ms,current_ms,change_pct,threshold_pct,status,note" > out
+      for (o = 1; o <= n; ++o) {
+        tag = order[o]; lim = limit(tag)
+        if (!(tag in b)) { print tag, "", c[tag], "", lim, "NEW", "" > out; ++cnt["NEW"]; continue }
+        ch = b[tag] > 0 ? 100 * (c[tag] - b[tag]) / b[tag] : 0
+        st = "PASS"; note = ""
+        if (ch > lim) {
+          st = "FAIL"
+          if (clo[tag] != "" && bhi[tag] != "" && clo[tag] + 0 <= bhi[tag] + 0) { st = "PASS"; note = "ci_overlap" }
+        } else if (ch < -lim) st = "IMPROVED"
+        ++cnt[st]
+        print tag, b[tag], c[tag], sprintf("%.1f", ch), lim, st, note > out
+        if (st != "PASS" || note != "")
+          printf "  %-8s %-40s %10.1f -> %10.1f ms  (%+.1f%%, limit %s%%)%s\n",
+            st, tag, b[tag], c[tag], ch, lim, note == "" ? "" : "  " note
+        seen[tag] = 1
+      }
+      for (tag in b) if (!(tag in seen) && !(tag in c)) {
+        print tag, b[tag], "", "", limit(tag), "MISSING", "" > out; ++cnt["MISSING"]
+      }
+      printf "  compared=%d pass=%d fail=%d improved=%d new=%d missing=%d\n",
+        cnt["PASS"] + cnt["FAIL"] + cnt["IMPROVED"], cnt["PASS"], cnt["FAIL"], cnt["IMPROVED"],
+        cnt["NEW"], cnt["MISSING"]
+      exit (cnt["FAIL"] > 0)
+    }' thr="${THRESHOLDS:-/dev/null}" base="$ANALYSIS_DIR/.baseline" \
+      "${THRESHOLDS:-/dev/null}" "$ANALYSIS_DIR/.baseline" "$CURRENT" || status=$?
+  echo "  Per tag: $ANALYSIS_DIR/regressions.csv"
+  if (( status )); then echo "  RESULT: FAIL (regressions beyond threshold)"; else echo "  RESULT: PASS"; fi
+fi
+exit "$status"
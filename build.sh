@@ -1,6 +1,8 @@
 #!/usr/bin/env bash
 # build.sh – builds baselines, then scans each *_tcN.c and, if schedule(runtime) is present,
 # generates baked schedule/chunk executables per config.json. Otherwise builds a single exe.
+# With build.pgo every variant and both baselines are then rebuilt as <exe>_pgo: instrumented,
+# trained on a synthetic input, and recompiled with its profile (see "PGO flavour" at the end).
 set -euo pipefail
 
 source ./conf.sh
@@ -29,6 +31,10 @@ echo ">>> CC=${CC}"
 echo ">>> CFLAGS_SEQ=${CFLAGS_SEQ}"
 echo ">>> CFLAGS_OMP=${CFLAGS_OMP}"
 echo ">>> LDFLAGS=${LDFLAGS:-<empty>}"
+echo ">>> PGO=${BUILD_PGO} (${PGO_CFLAGS}, training on ${PGO_TRAIN_PIXELS} px / ${PGO_TRAIN_SEARCH} colours)"
+
+# Every PGO-able build's recipe "out|src|defs|objs|cflags", replayed by the PGO flavour
+BUILT=()
 
 echo "==> Building sequential baselines"
 for m in a b; do
@@ -37,6 +43,7 @@ for m in a b; do
   [[ -f "$src" ]] || { echo "Missing $src"; exit 1; }
   echo "  $src -> $out"
   $CC $CFLAGS_SEQ "$src" -o "$out" $LDFLAGS
+  BUILT+=("$out|$src|||$CFLAGS_SEQ")
 done
 
 # Compile the OpenMP schedule shim once (needed for baked variants).
@@ -74,6 +81,7 @@ build_single() {
   local src="$1" out="$2"
   echo "  $src -> $out  [no runtime schedule found → single build]"
   $CC $CFLAGS_OMP "$src" -o "$out" $LDFLAGS
+  BUILT+=("$out|$src|||$CFLAGS_OMP")
 }
 
 build_baked() {
@@ -94,6 +102,7 @@ build_baked() {
   fi
   echo "  $src -> $out  [baked: ${kind}${chunk:+,$chunk}]"
   $CC $CFLAGS_OMP $defs "$src" omp_sched_init.o -o "$out" $LDFLAGS
+  BUILT+=("$out|$src|$defs|omp_sched_init.o|$CFLAGS_OMP")
 }
 
 if (( ${#variants[@]} == 0 )); then
@@ -156,4 +165,82 @@ else
 fi
 shopt -u nullglob
 echo "Built ${built_count:-0} variant executable(s)."
+
+# Tools share the search index / transform kernel headers and are not part of the matrix
+# (run_all.sh only discovers a_tc* / b_tc*).
+build_tool() {
+  local src="$1" out="$2"; shift 2
+  [[ -f "$src" ]] || { echo "  (skip $out: $src not found)"; return 0; }
+  echo "  $src -> $out"
+  $CC $CFLAGS_OMP "$src" -o "$out" $LDFLAGS "$@"
+}
+
+# librawimage: the header functions compiled once, as a static and a shared library.
+# -ffat-lto-objects keeps both LTO bytecode and ordinary code in the objects, so a
+# program linking librawimage.a with -flto inlines across the boundary and one
+# without -flto still links.
+echo "==> Building librawimage"
+echo "  librawimage.c -> librawimage.a librawimage.so"
+$CC $CFLAGS_OMP -fPIC -flto -ffat-lto-objects -c librawimage.c -o librawimage.o
+rm -f librawimage.a
+if command -v gcc-ar >/dev/null 2>&1; then gcc-ar rcs librawimage.a librawimage.o
+else ar rcs librawimage.a librawimage.o
+fi
+$CC $CFLAGS_OMP -flto -shared librawimage.o -o librawimage.so $LDFLAGS
+
+echo "==> Building tools"
+build_tool process-batch.c   ab_batch -flto librawimage.a
+build_tool process-daemon.c  ab_daemon
+build_tool process-loadgen.c ab_loadgen -lpthread
+build_tool process-cache.c   ab_cache
+build_tool process-incr.c    ab_incr
+build_tool process-roi.c     ab_roi
+build_tool process-shm.c     ab_shm -lrt
+build_tool process-bench.c   ab_bench
+build_tool process-gen.c     ab_gen
+build_tool process-roofline.c ab_roofline
+
+# ---------- PGO flavour (build.pgo) ----------
+# Each variant is compiled with -fprofile-generate, run once on an ab_gen input of
+# build.pgo_train_pixels pixels (output checked against a_seq / b_seq), and compiled
+# again with -fprofile-use and build.pgo_cflags (default -flto -march=native) into
+# <exe>_pgo. run_all.sh tags it <tag>_pgo, next to the plain build's <tag>, so the
+# matrix and analyse.sh compare the two directly. Objects are compiled separately at
+# the same path in both passes, so each .gcda is found again; one profile directory
+# per variant keeps baked builds of the same source apart. -fprofile-update=atomic
+# keeps the counters exact when the training run is multithreaded. a_seq / b_seq go
+# through the same steps with their own CFLAGS_SEQ, so the PGO variants have a PGO
+# baseline (a_seq_pgo / b_seq_pgo) as well as the plain one.
+if [[ "$BUILD_PGO" == "true" ]]; then
+  echo "==> PGO flavour: -fprofile-generate -> training run -> -fprofile-use ${PGO_CFLAGS}"
+  [[ -x ab_gen ]] || { echo "ERROR: ab_gen is required for the PGO training input"; exit 1; }
+  PGO_DIR="$PWD/.pgo"
+  rm -rf "$PGO_DIR" && mkdir -p "$PGO_DIR"
+  # shellcheck disable=SC2086  # GEN_ARGS is a list of ab_gen options
+  ./ab_gen -n "$PGO_TRAIN_PIXELS" -s "$PGO_TRAIN_SEARCH" $GEN_ARGS "$PGO_DIR/train.raw" "$PGO_DIR/search.raw" | tail -n1
+  for m in a b; do
+    "./${m}_seq" "$PGO_DIR/train.raw" "$PGO_DIR/gold_$m.bin" "$PGO_DIR/search.raw" >/dev/null 2>&1
+  done
+
+  pgo_count=0
+  for rec in "${BUILT[@]}"; do
+    IFS='|' read -r out src defs objs cflags <<<"$rec"
+    d="$PGO_DIR/$out"; mkdir -p "$d"
+    $CC -c $cflags $PGO_CFLAGS $defs -fprofile-generate="$d" -fprofile-update=atomic "$src" -o "$d/$out.o"
+    $CC $cflags $PGO_CFLAGS -fprofile-generate="$d" "$d/$out.o" $objs -o "$d/train" $LDFLAGS
+    t0=$(date +%s%N)
+    "$d/train" "$PGO_DIR/train.raw" "$d/train.bin" "$PGO_DIR/search.raw" >/dev/null 2>&1 || true
+    t1=$(date +%s%N)
+    if ! cmp -s "$d/train.bin" "$PGO_DIR/gold_${out%%_*}.bin"; then
+      echo "  !! $out: training output differs from ${out%%_*}_seq, ${out}_pgo not built"
+      continue
+    fi
+    $CC -c $cflags $PGO_CFLAGS $defs -fprofile-use="$d" "$src" -o "$d/$out.o"
+    $CC $cflags $PGO_CFLAGS "$d/$out.o" $objs -o "${out}_pgo" $LDFLAGS
+    echo "  $src -> ${out}_pgo  [trained $(( (t1 - t0)/1000000 )) ms]"
+    pgo_count=$((pgo_count+1))
+  done
+  rm -f "$PGO_DIR"/*.raw "$PGO_DIR"/*.bin "$PGO_DIR"/*/train.bin
+  echo "Built ${pgo_count} PGO executable(s) (profiles in ${PGO_DIR})."
+fi
 echo "Build complete"
@@ -7,6 +7,8 @@ CONFIG="${CONFIG:-config.json}"
 declare -a THREADS=()
 declare -a SCHEDULES=()
 declare -a CHUNKS=()
+declare -a PIXELS=()
+declare -a SEARCH_SIZES=()
 
 _have_jq() { command -v jq >/dev/null 2>&1; }
 
@@ -38,6 +40,14 @@ load_config() {
       _json_to_arr THREADS   '.matrix.threads'
       _json_to_arr SCHEDULES '.matrix.schedules'
       mapfile -t CHUNKS < <(jq -r '.matrix.chunks // [] | map(if .==null then "" else tostring end)[]' "$CONFIG")
+      # Input sizes: null (or an empty list) means the dataset's own files
+      mapfile -t PIXELS < <(jq -r '.matrix.pixels // [] | map(if .==null then "" else tostring end)[]' "$CONFIG")
+      mapfile -t SEARCH_SIZES < <(jq -r '.matrix.search_sizes // [] | map(if .==null then "" else tostring end)[]' "$CONFIG")
+      export WEAK_PIXELS_PER_THREAD="$(jq -r '.matrix.weak_pixels_per_thread // 0' "$CONFIG")"
+      export GEN_ARGS="$(jq -r '.inputs.gen_args // ""' "$CONFIG")"
+      export KEEP_GENERATED="$(jq -r '.inputs.keep_generated // false' "$CONFIG")"
+      export GOLD_CACHE="$(jq -r '.inputs.gold_cache // true' "$CONFIG")"
+      export GOLD_CACHE_DIR="$(jq -r '.inputs.gold_cache_dir // "golds"' "$CONFIG")"
 
       # Behaviour
       local strict stopfail verifycfg
@@ -47,12 +57,40 @@ load_config() {
       export STRICT_MD5=$([[ "$strict" == "true" ]] && echo 1 || echo 0)
       export STOP_ON_TESTCASE_FAIL=$([[ "$stopfail" == "true" ]] && echo 1 || echo 0)
       export VERIFY_EACH_CONFIG=$([[ "$verifycfg" == "true" ]] && echo 1 || echo 0)
+      export REPETITIONS="$(jq -r '.behaviour.repetitions // 1' "$CONFIG")"
+      export WARMUPS="$(jq -r '.behaviour.warmups // 0' "$CONFIG")"
+      export SHUFFLE_SEED="$(jq -r '.behaviour.shuffle_seed // 0' "$CONFIG")"
+      export UNSTABLE_REL_MAD="$(jq -r '.behaviour.unstable_rel_mad // 0.05' "$CONFIG")"
+
+      # Sweep (full matrix, or successive halving on input prefixes)
+      export SWEEP_MODE="$(jq -r '.sweep.mode // "full"' "$CONFIG")"
+      export SWEEP_ETA="$(jq -r '.sweep.eta // 2' "$CONFIG")"
+      export SWEEP_KEEP="$(jq -r '.sweep.keep // 3' "$CONFIG")"
+      export SWEEP_REPS="$(jq -r '.sweep.repetitions // 3' "$CONFIG")"
+      export SWEEP_MIN_PIXELS="$(jq -r '.sweep.min_pixels // 1000' "$CONFIG")"
+
+      # Analysis (analyse.sh after the run; a baseline results.csv turns on the regression check)
+      export ANALYSIS_BASELINE="$(jq -r '.analysis.baseline // ""' "$CONFIG")"
+      export REGRESSION_PCT="$(jq -r '.analysis.threshold_pct // 5' "$CONFIG")"
+      export REGRESSION_THRESHOLDS="$(jq -r '.analysis.thresholds // ""' "$CONFIG")"
+      export ROOFLINE="$(jq -r '.analysis.roofline // false' "$CONFIG")"
+      export INSTRUMENT="$(jq -r '.analysis.instrument // false' "$CONFIG")"
+
+      # Execution backend (slurm / local / auto), local CPU list and cgroup isolation
+      export EXEC_BACKEND="$(jq -r '.execution.backend // "auto"' "$CONFIG")"
+      export EXEC_CPUS="$(jq -r '.execution.cpus // ""' "$CONFIG")"
+      export EXEC_CGROUP="$(jq -r '.execution.cgroup // "off"' "$CONFIG")"
 
       # Build
       export CC="$(jq -r '.build.cc // "gcc"' "$CONFIG")"
       export CFLAGS_SEQ="$(jq -r '.build.cflags_seq // "-O3 -std=c11"' "$CONFIG")"
       export CFLAGS_OMP="$(jq -r '.build.cflags_omp // "-O3 -fopenmp -std=c11"' "$CONFIG")"
       export LDFLAGS="$(jq -r '.build.ldflags // ""' "$CONFIG")"
+      # PGO flavour: every variant also built as <exe>_pgo after a training run
+      export BUILD_PGO="$(jq -r '.build.pgo // false' "$CONFIG")"
+      export PGO_CFLAGS="$(jq -r '.build.pgo_cflags // "-flto -march=native"' "$CONFIG")"
+      export PGO_TRAIN_PIXELS="$(jq -r '.build.pgo_train_pixels // 2000000' "$CONFIG")"
+      export PGO_TRAIN_SEARCH="$(jq -r '.build.pgo_train_search // 61' "$CONFIG")"
 
       # SLURM info (used by run logs / submission)
       export SLURM_JOB_NAME_CFG="$(jq -r '.slurm.job_name // "csc4010-batch"' "$CONFIG")"
@@ -80,13 +118,41 @@ load_config() {
       THREADS=(${THREADS:-1 2 4 8 16 32})
       SCHEDULES=(${SCHEDULES:-static dynamic guided auto})
       CHUNKS=(${CHUNKS:-} 64 256 1024)
+      PIXELS=(${PIXELS:-})
+      SEARCH_SIZES=(${SEARCH_SIZES:-})
+      WEAK_PIXELS_PER_THREAD=${WEAK_PIXELS_PER_THREAD:-0}
+      GEN_ARGS=${GEN_ARGS:-}
+      KEEP_GENERATED=${KEEP_GENERATED:-false}
+      GOLD_CACHE=${GOLD_CACHE:-true}
+      GOLD_CACHE_DIR=${GOLD_CACHE_DIR:-golds}
       STRICT_MD5=${STRICT_MD5:-0}
       STOP_ON_TESTCASE_FAIL=${STOP_ON_TESTCASE_FAIL:-1}
       VERIFY_EACH_CONFIG=${VERIFY_EACH_CONFIG:-1}
+      REPETITIONS=${REPETITIONS:-1}
+      WARMUPS=${WARMUPS:-0}
+      SHUFFLE_SEED=${SHUFFLE_SEED:-0}
+      SWEEP_MODE=${SWEEP_MODE:-full}
+      SWEEP_ETA=${SWEEP_ETA:-2}
+      SWEEP_KEEP=${SWEEP_KEEP:-3}
+      SWEEP_REPS=${SWEEP_REPS:-3}
+      SWEEP_MIN_PIXELS=${SWEEP_MIN_PIXELS:-1000}
+      UNSTABLE_REL_MAD=${UNSTABLE_REL_MAD:-0.05}
+      ANALYSIS_BASELINE=${ANALYSIS_BASELINE:-}
+      REGRESSION_PCT=${REGRESSION_PCT:-5}
+      REGRESSION_THRESHOLDS=${REGRESSION_THRESHOLDS:-}
+      ROOFLINE=${ROOFLINE:-false}
+      INSTRUMENT=${INSTRUMENT:-false}
+      EXEC_BACKEND=${EXEC_BACKEND:-auto}
+      EXEC_CPUS=${EXEC_CPUS:-}
+      EXEC_CGROUP=${EXEC_CGROUP:-off}
       CC=${CC:-gcc}
       CFLAGS_SEQ=${CFLAGS_SEQ:-"-O3 -std=c11"}
       CFLAGS_OMP=${CFLAGS_OMP:-"-O3 -fopenmp -std=c11"}
       LDFLAGS=${LDFLAGS:-}
+      BUILD_PGO=${BUILD_PGO:-false}
+      PGO_CFLAGS=${PGO_CFLAGS:-"-flto -march=native"}
+      PGO_TRAIN_PIXELS=${PGO_TRAIN_PIXELS:-2000000}
+      PGO_TRAIN_SEARCH=${PGO_TRAIN_SEARCH:-61}
       SLURM_NOTIFY_EMAIL=${SLURM_NOTIFY_EMAIL:-}
       SLURM_NOTIFY_BEGIN=${SLURM_NOTIFY_BEGIN:-false}
       SLURM_NOTIFY_END=${SLURM_NOTIFY_END:-true}
@@ -101,13 +167,41 @@ load_config() {
     THREADS=(${THREADS:-1 2 4 8 16 32})
     SCHEDULES=(${SCHEDULES:-static dynamic guided auto})
     CHUNKS=(${CHUNKS:-} 64 256 1024)
+    PIXELS=(${PIXELS:-})
+    SEARCH_SIZES=(${SEARCH_SIZES:-})
+    WEAK_PIXELS_PER_THREAD=${WEAK_PIXELS_PER_THREAD:-0}
+    GEN_ARGS=${GEN_ARGS:-}
+    KEEP_GENERATED=${KEEP_GENERATED:-false}
+    GOLD_CACHE=${GOLD_CACHE:-true}
+    GOLD_CACHE_DIR=${GOLD_CACHE_DIR:-golds}
     STRICT_MD5=${STRICT_MD5:-0}
     STOP_ON_TESTCASE_FAIL=${STOP_ON_TESTCASE_FAIL:-1}
     VERIFY_EACH_CONFIG=${VERIFY_EACH_CONFIG:-1}
+    REPETITIONS=${REPETITIONS:-1}
+    WARMUPS=${WARMUPS:-0}
+    SHUFFLE_SEED=${SHUFFLE_SEED:-0}
+    SWEEP_MODE=${SWEEP_MODE:-full}
+    SWEEP_ETA=${SWEEP_ETA:-2}
+    SWEEP_KEEP=${SWEEP_KEEP:-3}
+    SWEEP_REPS=${SWEEP_REPS:-3}
+    SWEEP_MIN_PIXELS=${SWEEP_MIN_PIXELS:-1000}
+    UNSTABLE_REL_MAD=${UNSTABLE_REL_MAD:-0.05}
+    ANALYSIS_BASELINE=${ANALYSIS_BASELINE:-}
+    REGRESSION_PCT=${REGRESSION_PCT:-5}
+    REGRESSION_THRESHOLDS=${REGRESSION_THRESHOLDS:-}
+    ROOFLINE=${ROOFLINE:-false}
+    INSTRUMENT=${INSTRUMENT:-false}
+    EXEC_BACKEND=${EXEC_BACKEND:-auto}
+    EXEC_CPUS=${EXEC_CPUS:-}
+    EXEC_CGROUP=${EXEC_CGROUP:-off}
     CC=${CC:-gcc}
     CFLAGS_SEQ=${CFLAGS_SEQ:-"-O3 -std=c11"}
     CFLAGS_OMP=${CFLAGS_OMP:-"-O3 -fopenmp -std=c11"}
     LDFLAGS=${LDFLAGS:-}
+    BUILD_PGO=${BUILD_PGO:-false}
+    PGO_CFLAGS=${PGO_CFLAGS:-"-flto -march=native"}
+    PGO_TRAIN_PIXELS=${PGO_TRAIN_PIXELS:-2000000}
+    PGO_TRAIN_SEARCH=${PGO_TRAIN_SEARCH:-61}
     SLURM_NOTIFY_EMAIL=${SLURM_NOTIFY_EMAIL:-}
     SLURM_NOTIFY_BEGIN=${SLURM_NOTIFY_BEGIN:-false}
     SLURM_NOTIFY_END=${SLURM_NOTIFY_END:-true}
@@ -135,6 +229,38 @@ validate_config() {
   for c in "${CHUNKS[@]}"; do
     [[ -z "$c" || ( "$c" =~ ^[0-9]+$ && "$c" -ge 1 ) ]] || { echo "Invalid chunk: '$c'"; exit 2; }
   done
+  # input sizes "" (the dataset's) or positive ints; weak scaling 0 (off) or pixels per thread
+  for n in "${PIXELS[@]}" "${SEARCH_SIZES[@]}"; do
+    [[ -z "$n" || ( "$n" =~ ^[0-9]+$ && "$n" -ge 1 ) ]] || { echo "Invalid pixels / search size: '$n'"; exit 2; }
+  done
+  [[ "$WEAK_PIXELS_PER_THREAD" =~ ^[0-9]+$ ]] || { echo "Invalid weak_pixels_per_thread: '$WEAK_PIXELS_PER_THREAD'"; exit 2; }
+  # repetitions >= 1, warmups >= 0, seed a non-negative int (0 = from the clock)
+  [[ "$REPETITIONS" =~ ^[0-9]+$ && "$REPETITIONS" -ge 1 ]] || { echo "Invalid repetitions: '$REPETITIONS'"; exit 2; }
+  [[ "$WARMUPS" =~ ^[0-9]+$ ]] || { echo "Invalid warmups: '$WARMUPS'"; exit 2; }
+  [[ "$SHUFFLE_SEED" =~ ^[0-9]+$ ]] || { echo "Invalid shuffle_seed: '$SHUFFLE_SEED'"; exit 2; }
+  # sweep: full or halving; eta >= 2, keep / repetitions / min_pixels positive
+  [[ "$SWEEP_MODE" =~ ^(full|halving)$ ]] || { echo "Invalid sweep.mode: '$SWEEP_MODE'"; exit 2; }
+  [[ "$SWEEP_ETA" =~ ^[0-9]+$ && "$SWEEP_ETA" -ge 2 ]] || { echo "Invalid sweep.eta: '$SWEEP_ETA'"; exit 2; }
+  for n in "$SWEEP_KEEP" "$SWEEP_REPS" "$SWEEP_MIN_PIXELS"; do
+    [[ "$n" =~ ^[0-9]+$ && "$n" -ge 1 ]] || { echo "Invalid sweep.keep / repetitions / min_pixels: '$n'"; exit 2; }
+  done
+  # PGO flavour: a boolean and positive training sizes
+  [[ "$BUILD_PGO" =~ ^(true|false)$ ]] || { echo "Invalid build.pgo: '$BUILD_PGO'"; exit 2; }
+  for n in "$PGO_TRAIN_PIXELS" "$PGO_TRAIN_SEARCH"; do
+    [[ "$n" =~ ^[0-9]+$ && "$n" -ge 1 ]] || { echo "Invalid build.pgo_train_pixels / pgo_train_search: '$n'"; exit 2; }
+  done
+  [[ "$UNSTABLE_REL_MAD" =~ ^[0-9]*\.?[0-9]+$ ]] || { echo "Invalid unstable_rel_mad: '$UNSTABLE_REL_MAD'"; exit 2; }
+  # regression threshold a percentage; baseline / thresholds files must exist when named
+  [[ "$REGRESSION_PCT" =~ ^[0-9]*\.?[0-9]+$ ]] || { echo "Invalid analysis.threshold_pct: '$REGRESSION_PCT'"; exit 2; }
+  [[ -z "$ANALYSIS_BASELINE" || -f "$ANALYSIS_BASELINE" ]] || { echo "analysis.baseline not found: '$ANALYSIS_BASELINE'"; exit 2; }
+  [[ -z "$REGRESSION_THRESHOLDS" || -f "$REGRESSION_THRESHOLDS" ]] || { echo "analysis.thresholds not found: '$REGRESSION_THRESHOLDS'"; exit 2; }
+  [[ "$GOLD_CACHE" =~ ^(true|false)$ && -n "$GOLD_CACHE_DIR" ]] || { echo "Invalid inputs.gold_cache / gold_cache_dir: '$GOLD_CACHE' '$GOLD_CACHE_DIR'"; exit 2; }
+  [[ "$ROOFLINE" =~ ^(true|false)$ ]] || { echo "Invalid analysis.roofline: '$ROOFLINE'"; exit 2; }
+  [[ "$INSTRUMENT" =~ ^(true|false)$ ]] || { echo "Invalid analysis.instrument: '$INSTRUMENT'"; exit 2; }
+  # backend and cgroup mode from fixed sets; cpus empty or a cpulist (0-3,8,10-11)
+  [[ "$EXEC_BACKEND" =~ ^(auto|slurm|local)$ ]] || { echo "Invalid execution.backend: '$EXEC_BACKEND'"; exit 2; }
+  [[ "$EXEC_CGROUP" =~ ^(off|confine|exclusive)$ ]] || { echo "Invalid execution.cgroup: '$EXEC_CGROUP'"; exit 2; }
+  [[ -z "$EXEC_CPUS" || "$EXEC_CPUS" =~ ^[0-9]+(-[0-9]+)?(,[0-9]+(-[0-9]+)?)*$ ]] || { echo "Invalid execution.cpus: '$EXEC_CPUS'"; exit 2; }
 }
 
 # Choose INFILE/SEARCH by scanning dataset dir (supports .raw and .bin)
@@ -171,6 +297,12 @@ print_config_summary() {
   local tcnt=${#THREADS[@]} scnt=${#SCHEDULES[@]} ccnt=${#CHUNKS[@]}
   echo "[cfg] dataset=$DATASET data_root=$DATA_ROOT outdir=$OUTDIR log=$LOG"
   echo "[cfg] matrix: threads=$tcnt (${THREADS[*]}) schedules=$scnt (${SCHEDULES[*]}) chunks=$ccnt ($(printf '%s ' "${CHUNKS[@]}"))"
+  echo "[cfg] sizes: pixels=(${PIXELS[*]:-dataset}) search_sizes=(${SEARCH_SIZES[*]:-dataset}) weak_pixels_per_thread=$WEAK_PIXELS_PER_THREAD gen_args='$GEN_ARGS'"
+  echo "[cfg] golds: cache=$GOLD_CACHE dir=$GOLD_CACHE_DIR"
   echo "[cfg] behaviour: strict_md5=$STRICT_MD5 stop_on_testcase_fail=$STOP_ON_TESTCASE_FAIL verify_each_config=$VERIFY_EACH_CONFIG"
+  echo "[cfg] repetitions: timed=$REPETITIONS warmups=$WARMUPS shuffle_seed=$SHUFFLE_SEED unstable_rel_mad=$UNSTABLE_REL_MAD"
+  echo "[cfg] sweep: mode=$SWEEP_MODE eta=$SWEEP_ETA keep=$SWEEP_KEEP repetitions=$SWEEP_REPS min_pixels=$SWEEP_MIN_PIXELS"
+  echo "[cfg] analysis: baseline=${ANALYSIS_BASELINE:-none} threshold_pct=$REGRESSION_PCT thresholds=${REGRESSION_THRESHOLDS:-none} roofline=$ROOFLINE instrument=$INSTRUMENT"
+  echo "[cfg] execution: backend=$EXEC_BACKEND cpus=${EXEC_CPUS:-affinity} cgroup=$EXEC_CGROUP"
   echo "[cfg] notify: email=${SLURM_NOTIFY_EMAIL:-none} begin=${SLURM_NOTIFY_BEGIN} end=${SLURM_NOTIFY_END} fail=${SLURM_NOTIFY_FAIL}"
 }
@@ -0,0 +1,220 @@
+// librawimage.c
+// The one translation unit of librawimage: the definitions from rawimage.h,
+// searchindex.h, transform.h and searchresults.h, plus the image handles and the
+// batch entry points declared in librawimage.h.
+
+#define _POSIX_C_SOURCE 200809L
+#define RAWIMAGE_BUILD
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "librawimage.h"
+
+// --- Image handles ---
+
+struct Image *ImageOpen(const char *filename, unsigned long linesize)
+{
+    FILE *fp = fopen(filename, "rb");
+    if (fp == NULL) return NULL;
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0) { int e = errno; fclose(fp); errno = e; return NULL; }
+    unsigned long length = (unsigned long)st.st_size / sizeof(struct Pixel);
+
+    struct Image *img = (struct Image*)malloc(sizeof(struct Image));
+    if (img == NULL) FatalError("Cannot allocate memory for an image handle");
+    ImageData(img, length, linesize, NONE);
+
+    // whole lines per fread; the file is the in-memory Pixel layout, as WriteFile leaves it
+    unsigned long left = length;
+    for (unsigned long l=0; l<img->lines; ++l)
+    {
+        unsigned long n = left < img->linesize ? left : img->linesize;
+        if (n > 0 && fread(img->pixels[l], sizeof(struct Pixel), n, fp) != n)
+        {
+            int e = ferror(fp) ? errno : EIO;
+            fclose(fp);
+            ImageClose(img);
+            errno = e;
+            return NULL;
+        }
+        if (n < img->linesize)
+            memset(img->pixels[l] + n, 0, (img->linesize - n) * sizeof(struct Pixel));
+        left -= n;
+    }
+    fclose(fp);
+    return img;
+}
+
+int ImageSave(const struct Image *img, const char *filename)
+{
+    FILE *fp = fopen(filename, "wb");
+    if (fp == NULL) return -1;
+    for (unsigned long l=0; l<img->lines; ++l)
+    {
+        if (fwrite(img->pixels[l], sizeof(struct Pixel), img->linesize, fp) != img->linesize)
+        {
+            int e = errno;
+            fclose(fp);
+            errno = e;
+            return -1;
+        }
+    }
+    return fclose(fp) == 0 ? 0 : -1;
+}
+
+void ImageClose(struct Image *img)
+{
+    if (img == NULL) return;
+    FreeImage(img);
+    free(img);
+}
+
+// --- Batch entry points ---
+
+// A job with its size, for ordering biggest first
+struct ProcessOrder {
+    unsigned long pixels;
+    unsigned long j;
+};
+
+static int CompareOrder(const void *a, const void *b)
+{
+    const struct ProcessOrder *oa = (const struct ProcessOrder*)a;
+    const struct ProcessOrder *ob = (const struct ProcessOrder*)b;
+    if (oa->pixels != ob->pixels)
+        return (oa->pixels < ob->pixels) ? 1 : -1;
+    return (oa->j < ob->j) ? -1 : (oa->j > ob->j);
+}
+
+// Run one job and report it
+// parallel - rows across the team (called outside a parallel region)
+// hits, counter - the calling thread's per-slot / per-entry scratch
+static void ProcessOne(const struct SearchIndex *index, struct ProcessJob *job, unsigned long linesize,
+                       int parallel, unsigned long *hits, unsigned long *counter, ProcessDone done, void *arg)
+{
+    double t0 = omp_get_wtime();
+    struct Image *img = ImageOpen(job->infilename, linesize);
+    if (img == NULL)
+    {
+        job->error = errno;
+        job->seconds = omp_get_wtime() - t0;
+        if (done) done(job, NULL, NULL, arg);
+        return;
+    }
+
+    memset(hits, 0, (index->slots ? index->slots : 1) * sizeof(unsigned long));
+    if (parallel)
+    {
+        #pragma omp parallel default(none) shared(img, index, hits)
+        {
+            unsigned long *local = SearchIndexCounters(index);
+
+            #pragma omp for schedule(runtime)
+            for (unsigned long l=0; l<img->lines; ++l)
+                TransformRange(img->pixels[l], 0, img->linesize, index, local);
+
+            for (unsigned long s=0; s<index->slots; ++s)
+            {
+                if (local[s])
+                {
+                    #pragma omp atomic
+                    hits[s] += local[s];
+                }
+            }
+            free(local);
+        }
+    }
+    else
+    {
+        for (unsigned long l=0; l<img->lines; ++l)
+            TransformRange(img->pixels[l], 0, img->linesize, index, hits);
+    }
+
+    job->error = (ImageSave(img, job->outfilename) == 0) ? 0 : errno;
+    SearchIndexExpand(index, hits, counter);
+    job->seconds = omp_get_wtime() - t0;
+    if (done) done(job, job->error ? NULL : img, counter, arg);
+    ImageClose(img);
+}
+
+// ProcessA / ProcessB; linesize 0 (Method B) never runs a job wide
+static unsigned long ProcessJobs(const struct SearchIndex *index, struct ProcessJob *jobs, unsigned long njobs,
+                                 unsigned long linesize, unsigned long widemin, ProcessDone done, void *arg)
+{
+    if (njobs == 0) return 0;
+    struct ProcessOrder *order = (struct ProcessOrder*)malloc(njobs * sizeof(struct ProcessOrder));
+    if (order == NULL) FatalError("Cannot allocate memory for the job order");
+
+    unsigned long total = 0;
+    for (unsigned long j=0; j<njobs; ++j)
+    {
+        struct stat st;
+        jobs[j].pixels = (stat(jobs[j].infilename, &st) == 0) ? (unsigned long)st.st_size / sizeof(struct Pixel) : 0;
+        jobs[j].wide = 0;
+        jobs[j].seconds = 0;
+        jobs[j].error = 0;
+        order[j].pixels = jobs[j].pixels;
+        order[j].j = j;
+        total += jobs[j].pixels;
+    }
+    qsort(order, njobs, sizeof(struct ProcessOrder), CompareOrder);
+
+    int nthreads = omp_get_max_threads();
+    if (widemin == 0) widemin = total / (unsigned long)nthreads;
+    if (widemin == 0) widemin = 1;
+    unsigned long nwide = 0;
+    while (nwide < njobs && linesize != 0 && nthreads > 1 && order[nwide].pixels >= widemin)
+        jobs[order[nwide++].j].wide = 1;
+
+    size_t entries = index->length ? index->length : 1;
+
+    // Wide jobs: one at a time, rows in parallel (biggest first, so order[0..nwide))
+    if (nwide > 0)
+    {
+        unsigned long *hits = SearchIndexCounters(index);
+        unsigned long *counter = (unsigned long*)malloc(entries * sizeof(unsigned long));
+        if (counter == NULL) FatalError("Cannot allocate memory for search counters");
+        for (unsigned long k=0; k<nwide; ++k)
+            ProcessOne(index, &jobs[order[k].j], linesize, 1, hits, counter, done, arg);
+        free(counter);
+        free(hits);
+    }
+
+    // Narrow jobs: one thread each, biggest first
+    #pragma omp parallel default(none) shared(index, jobs, njobs, nwide, order, linesize, entries, done, arg)
+    {
+        unsigned long *hits = SearchIndexCounters(index);
+        unsigned long *counter = (unsigned long*)malloc(entries * sizeof(unsigned long));
+        if (counter == NULL) FatalError("Cannot allocate memory for search counters");
+
+        #pragma omp for schedule(dynamic,1)
+        for (unsigned long k=nwide; k<njobs; ++k)
+            ProcessOne(index, &jobs[order[k].j], linesize, 0, hits, counter, done, arg);
+
+        free(counter);
+        free(hits);
+    }
+
+    free(order);
+    unsigned long failed = 0;
+    for (unsigned long j=0; j<njobs; ++j)
+        failed += (jobs[j].error != 0);
+    return failed;
+}
+
+unsigned long ProcessA(const struct SearchIndex *index, struct ProcessJob *jobs, unsigned long njobs,
+                       unsigned long widemin, ProcessDone done, void *arg)
+{
+    return ProcessJobs(index, jobs, njobs, RAWIMAGE_LINESIZE_A, widemin, done, arg);
+}
+
+unsigned long ProcessB(const struct SearchIndex *index, struct ProcessJob *jobs, unsigned long njobs,
+                       ProcessDone done, void *arg)
+{
+    return ProcessJobs(index, jobs, njobs, RAWIMAGE_LINESIZE_B, 0, done, arg);
+}
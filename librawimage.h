@@ -0,0 +1,79 @@
+// librawimage – the raw image library, compiled once and linked
+//
+// rawimage.h, searchindex.h, transform.h and searchresults.h define their functions
+// in the header, so every program is a single translation unit with its own copy.
+// This header declares the same functions (it sets RAWIMAGE_LIB for them) for
+// programs that link librawimage.a or librawimage.so instead, and adds:
+//  - image handles: loaders and writers that move a whole line per read / write
+//    instead of a pixel, and return errors instead of exiting
+//  - search engine: SearchIndex (searchindex.h), one hash probe per pixel
+//  - transform kernel: TransformRange (transform.h), Greyscale, XOR
+//  - batch entry points ProcessA / ProcessB: many input files against one
+//    SearchIndex, outputs and counts identical to a_seq / b_seq
+//
+// build.sh compiles librawimage.c once with -fPIC -flto -ffat-lto-objects into
+// librawimage.a (archived with gcc-ar) and librawimage.so. A program linking the
+// static library with -flto gets the library inlined into it as if it were one
+// translation unit; without -flto the fat objects link as ordinary code.
+//
+// Needs _POSIX_C_SOURCE >= 200809L.
+
+#ifndef LIBRAWIMAGE_H
+#define LIBRAWIMAGE_H
+
+#ifndef RAWIMAGE_BUILD  // librawimage.c itself takes the definitions
+#define RAWIMAGE_LIB
+#endif
+
+#include "rawimage.h"
+#include "searchindex.h"
+#include "transform.h"
+#include "searchresults.h"
+
+#define RAWIMAGE_LINESIZE_A 1000  // Method A: lines of 1000 pixels
+#define RAWIMAGE_LINESIZE_B 0     // Method B: the whole file as one line
+
+// --- Image handles ---
+
+// Load a raw file into a new Image split into lines of linesize (0: one line), the
+// last line zero-padded as LoadFile does
+// returns the Image, or NULL with errno set if the file cannot be read
+struct Image *ImageOpen(const char *filename, unsigned long linesize);
+
+// Write every line of an Image (padding included, as WriteFile does)
+// returns 0, or -1 with errno set
+int ImageSave(const struct Image *img, const char *filename);
+
+// Free an Image from ImageOpen
+void ImageClose(struct Image *img);
+
+// --- Batch entry points ---
+
+// One input / output pair; ProcessA / ProcessB fill in pixels, wide, seconds, error
+struct ProcessJob {
+    const char *infilename;
+    const char *outfilename;
+    void *user;               // the caller's, passed through untouched
+    unsigned long pixels;     // input pixels
+    int wide;                 // rows ran across the whole team (Method A only)
+    double seconds;           // load to write, or to the failure
+    int error;                // 0, or the errno of the failed load / write
+};
+
+// Called once per job as it finishes, on the thread that ran it and possibly on
+// several threads at once. img is the transformed image (NULL if the job failed)
+// and counter holds one count per search entry; both are only valid during the call.
+typedef void (*ProcessDone)(struct ProcessJob *job, const struct Image *img,
+                            const unsigned long *counter, void *arg);
+
+// Transform and search every job with one SearchIndex, biggest jobs first. Jobs
+// holding at least widemin pixels (0: 1/threads of the batch) run one at a time
+// with their rows across the OpenMP team; the rest run one per thread. Method B is
+// a single bleed chain per file, so its jobs always run one per thread.
+// returns the number of failed jobs
+unsigned long ProcessA(const struct SearchIndex *index, struct ProcessJob *jobs, unsigned long njobs,
+                       unsigned long widemin, ProcessDone done, void *arg);
+unsigned long ProcessB(const struct SearchIndex *index, struct ProcessJob *jobs, unsigned long njobs,
+                       ProcessDone done, void *arg);
+
+#endif
@@ -0,0 +1,815 @@
+// In-process phase timers for the testcase variants
+//
+// Wall time around srun includes launch, load, processing, write and printing.
+// These timers split a run into phases and report them as one structured line on
+// stderr, which run_all.sh parses into results.csv:
+//
+//   PHASES exe=a_tc2 threads=8 load_ms=... index_ms=... transform_ms=... search_ms=...
+//          merge_ms=... write_ms=... print_ms=... total_ms=...
+//
+// Phases are timed back to back from one mark, so they add up to total_ms.
+// search_ms is "-" where the search is fused into the transform loop (it is then
+// part of transform_ms). Times come from omp_get_wtime (a monotonic clock in libgomp).
+//
+// On Linux each OpenMP thread also gets a perf_event_open counter group (cycles,
+// instructions, cache misses, branch misses, stalled backend cycles), read at every
+// phase mark, so hardware counts are split per phase and per thread:
+//
+//   PERF phase=transform threads=8 cycles=... instructions=... ipc=... instructions_per_px=...
+//        cache_misses=... llc_misses_per_px=... branch_misses=... branch_misses_per_px=...
+//        stalled_cycles=...
+//   PERFTHREAD phase=transform thread=3 cycles=... instructions=... ipc=... ...
+//
+// Counters only cover user space. Events the CPU/VM doesn't offer print "-"; if perf
+// events are restricted altogether (perf_event_paranoid, containers) a single
+// "PERF unavailable" line is printed and timing is unaffected. The counters are off
+// unless PHASE_PERF=1 is in the environment.
+//
+// Inside parallel regions each thread's time is split into busy (kernel work), wait
+// (barriers, including the join at the end of the region), sync (atomic / critical
+// merges) and idle (between work items, e.g. waiting for tasks). The hooks below charge
+// the time since the thread's previous hook to one of these, and the run ends with
+//
+//   SYNC exe=b_tc3 threads=8 busy_ms=... wait_ms=... sync_ms=... idle_ms=... imbalance=...
+//        sync_points=...
+//   SYNCTHREAD thread=3 busy_ms=... wait_ms=... sync_ms=... idle_ms=... sync_points=...
+//
+// where the *_ms values are means over the threads, imbalance is max/mean busy time and
+// sync_points counts barriers, joins, merges and atomics executed by all threads.
+// Each hook reads the clock, which costs a few percent where the hooks are per pixel
+// (the b_tc2-b_tc4 barriers), so the accounting is off unless PHASE_SYNC=1 is set or
+// a trace is being written.
+//
+// Package and DRAM energy come from the RAPL counters under /sys/class/powercap, read at
+// every phase mark and summed over sockets:
+//
+//   ENERGY phase=transform ms=... pkg_j=... dram_j=... pkg_w=... dram_w=...
+//   ENERGY phase=total ms=... pkg_j=... dram_j=... pkg_w=... dram_w=... j_per_gpx=...
+//
+// The counters are per socket, so they include whatever else runs there. A domain the
+// machine lacks prints "-"; without readable counters (no RAPL, or energy_uj is root
+// only, as on most recent kernels) a single "ENERGY unavailable" line is printed.
+// The readings are off unless PHASE_ENERGY=1 is set.
+//
+// All three are opt-in so a plain run times the kernels alone; run_all.sh turns them on
+// for the verified run when analysis.instrument is set, never for repetitions.
+//
+// Memory comes from getrusage, read at every phase mark, and the per-subsystem
+// allocation totals the variant charges through allocstats.h:
+//
+//   MEMORY exe=b_tc3 maxrss_kb=... minflt=... majflt=... transform_minflt=... image_bytes=...
+//          search_bytes=... counters_bytes=... scratch_bytes=... allocs=...
+//
+// maxrss_kb is the peak resident set; the faults are counted from PhaseInit on, with the
+// transform phase's minor faults (first touch of per-thread counters, pages the load
+// did not fault in) split out. The *_bytes are totals requested over the run (frees are
+// not tracked); scratch includes these timers' own counter state.
+//
+// Phases, work items, barriers and merges are also recorded on the timeline trace when
+// TRACE_FILE is set (trace.h).
+//
+// Include after rawimage.h and omp.h; the including file needs _GNU_SOURCE (syscall).
+
+#ifndef PHASETIMER_H
+#define PHASETIMER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <omp.h>
+#include "trace.h"
+#include "allocstats.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+enum Phase {
+    PHASE_LOAD,       // input and search file loading
+    PHASE_INDEX,      // search set preparation (counters, index)
+    PHASE_TRANSFORM,  // bleed / greyscale / XOR (and fused search)
+    PHASE_SEARCH,     // search, where it is a separate phase
+    PHASE_MERGE,      // combining thread-local counters
+    PHASE_WRITE,      // writing the output file
+    PHASE_PRINT,      // printing the search results
+    PHASE_COUNT
+};
+
+#define PHASE_MAX_THREADS 256
+
+enum PhaseEvent {
+    PEV_CYCLES,       // group leader
+    PEV_INSTRUCTIONS,
+    PEV_CACHE_MISSES, // the kernel's generic cache-misses event (last level on most CPUs)
+    PEV_BRANCH_MISSES,
+    PEV_STALLED,      // stalled cycles, backend
+    PEV_COUNT
+};
+
+static const char *const PhaseNames[PHASE_COUNT] = {
+    "load", "index", "transform", "search", "merge", "write", "print"
+};
+
+// What a thread spent its time on inside parallel regions
+enum PhaseUse {
+    USE_BUSY,         // kernel work
+    USE_WAIT,         // barriers and the region join
+    USE_SYNC,         // atomic / critical merges
+    USE_IDLE,         // between work items
+    USE_COUNT
+};
+
+// Per-thread accounting, cache-line aligned per thread
+struct PhaseThread {
+    _Alignas(64) double lastmark;   // end of the last charged interval
+    int open;                       // charged since the last phase mark
+    int seen;                       // ran any hook at all
+    double workstart;               // start of the current work item
+    double regionstart;
+    double use[USE_COUNT];          // seconds
+    unsigned long syncs;            // sync points executed
+};
+
+// Per-thread hardware counter state (allocated only when counters open)
+struct PhasePerf {
+    int nthreads;
+    int available[PEV_COUNT];                          // opened on thread 0
+    int fd[PHASE_MAX_THREADS][PEV_COUNT];              // -1 where not open
+    unsigned long long id[PHASE_MAX_THREADS][PEV_COUNT];
+    unsigned long long last[PHASE_MAX_THREADS][PEV_COUNT];  // counts at the last mark
+    unsigned long long snap[PHASE_MAX_THREADS][PEV_COUNT];  // counts at PhaseThreadDone
+    int snapped[PHASE_MAX_THREADS];
+    unsigned long long total[PHASE_COUNT][PHASE_MAX_THREADS][PEV_COUNT];
+};
+
+#ifndef PHASE_POWERCAP
+#define PHASE_POWERCAP "/sys/class/powercap"
+#endif
+#define PHASE_MAX_RAPL 32
+
+enum RaplDomain {
+    RAPL_PKG,         // package-N zones
+    RAPL_DRAM,        // dram subzones
+    RAPL_COUNT
+};
+
+// RAPL energy counters (zones of every socket), in microjoules
+struct PhaseRapl {
+    int nzones;
+    int fd[PHASE_MAX_RAPL];                         // open energy_uj files
+    int domain[PHASE_MAX_RAPL];
+    unsigned long long range[PHASE_MAX_RAPL];       // max_energy_range_uj, where the counter wraps
+    unsigned long long last[PHASE_MAX_RAPL];        // reading at the last mark
+    int available[RAPL_COUNT];
+    double uj[PHASE_COUNT][RAPL_COUNT];
+};
+
+struct PhaseTimer {
+    double start;               // time of PhaseInit
+    double mark;                // end of the last timed phase
+    double loopend;             // latest thread loop end (PhaseThreadDone)
+    double ms[PHASE_COUNT];
+    int fused;                  // search is part of the transform phase
+    unsigned long pixels;       // pixels processed (for per-pixel metrics)
+    struct PhasePerf *perf;     // NULL when hardware counters are unavailable
+    char perfreason[96];
+    struct PhaseRapl rapl;      // nzones 0 when energy is unavailable
+    char energyreason[96];
+    long faults[2];             // minor / major faults at the last mark
+    long phasefaults[PHASE_COUNT][2];
+    int account;                // per-thread accounting is on
+    unsigned long syncs;        // sync points not tied to a thread (PhaseSyncPoints)
+    struct PhaseThread threads[PHASE_MAX_THREADS];
+};
+
+#ifdef __linux__
+// Open one counter of the calling thread's group (leader -1 opens the leader)
+static int PhasePerfOpen(unsigned long long config, int leader)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+// Read thread t's group into counts (scaled if the kernel multiplexed it)
+static void PhasePerfRead(struct PhasePerf *pp, int t, unsigned long long *counts)
+{
+    unsigned long long buf[3 + 2 * PEV_COUNT];
+    memcpy(counts, pp->last[t], sizeof(pp->last[t]));  // unchanged if the read fails
+    if (pp->fd[t][PEV_CYCLES] < 0 || read(pp->fd[t][PEV_CYCLES], buf, sizeof(buf)) <= 0)
+        return;
+    unsigned long long nr = buf[0], enabled = buf[1], running = buf[2];
+    for (unsigned long long k=0; k<nr && k<PEV_COUNT; ++k)
+    {
+        unsigned long long v = buf[3 + 2*k], id = buf[4 + 2*k];
+        if (running > 0 && running < enabled)
+            v = (unsigned long long)((double)v * (double)enabled / (double)running);
+        for (int e=0; e<PEV_COUNT; ++e)
+            if (pp->fd[t][e] >= 0 && pp->id[t][e] == id)
+                counts[e] = v;
+    }
+}
+#endif
+
+// 1 if the environment variable name is set to something other than "" or "0"
+static int PhaseEnvOn(const char *name)
+{
+    const char *env = getenv(name);
+    return env != NULL && *env != '\0' && strcmp(env, "0") != 0;
+}
+
+// Open a counter group on every thread of the team (called from PhaseInit)
+static void PhasePerfInit(struct PhaseTimer *t)
+{
+    if (!PhaseEnvOn("PHASE_PERF"))
+    {
+        snprintf(t->perfreason, sizeof(t->perfreason), "off (set PHASE_PERF=1)");
+        return;
+    }
+#ifdef __linux__
+    struct PhasePerf *pp = (struct PhasePerf*)RawCalloc(ALLOC_SCRATCH, 1, sizeof(struct PhasePerf));
+    if (pp == NULL) return;
+    int nthreads = omp_get_max_threads();
+    pp->nthreads = nthreads < PHASE_MAX_THREADS ? nthreads : PHASE_MAX_THREADS;
+    const unsigned long long config[PEV_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_STALLED_CYCLES_BACKEND
+    };
+    int err = 0;
+
+    // each thread opens its own group (pid 0 = the calling thread); libgomp keeps the
+    // same OS thread per thread number for later regions of the same team size
+    #pragma omp parallel num_threads(pp->nthreads) default(none) shared(pp, config, err)
+    {
+        int me = omp_get_thread_num();
+        for (int e=0; e<PEV_COUNT; ++e)
+        {
+            pp->fd[me][e] = -1;
+            if (e > 0 && pp->fd[me][PEV_CYCLES] < 0) continue;
+            int fd = PhasePerfOpen(config[e], e == 0 ? -1 : pp->fd[me][PEV_CYCLES]);
+            if (fd < 0)
+            {
+                if (e == 0)
+                {
+                    #pragma omp atomic write
+                    err = errno;
+                }
+                continue;
+            }
+            if (ioctl(fd, PERF_EVENT_IOC_ID, &pp->id[me][e]) != 0)
+            {
+                close(fd);
+                continue;
+            }
+            pp->fd[me][e] = fd;
+        }
+    }
+
+    if (pp->fd[0][PEV_CYCLES] < 0)
+    {
+        snprintf(t->perfreason, sizeof(t->perfreason), "%s%s", strerror(err ? err : ENODEV),
+            (err == EACCES || err == EPERM) ? " (check /proc/sys/kernel/perf_event_paranoid)" : "");
+        for (int th=0; th<pp->nthreads; ++th)
+            for (int e=0; e<PEV_COUNT; ++e)
+                if (pp->fd[th][e] >= 0) close(pp->fd[th][e]);
+        free(pp);
+        return;
+    }
+    for (int e=0; e<PEV_COUNT; ++e)
+        pp->available[e] = (pp->fd[0][e] >= 0);
+    for (int th=0; th<pp->nthreads; ++th)
+        PhasePerfRead(pp, th, pp->last[th]);
+    t->perf = pp;
+#else
+    snprintf(t->perfreason, sizeof(t->perfreason), "not supported on this platform");
+#endif
+}
+
+// Charge the counts since the last mark to a phase (threads that called
+// PhaseThreadDone are charged up to that point instead)
+static void PhasePerfSample(struct PhaseTimer *t, enum Phase phase, int usesnap)
+{
+#ifdef __linux__
+    struct PhasePerf *pp = t->perf;
+    if (pp == NULL) return;
+    for (int th=0; th<pp->nthreads; ++th)
+    {
+        unsigned long long now[PEV_COUNT];
+        if (usesnap && pp->snapped[th]) memcpy(now, pp->snap[th], sizeof(now));
+        else PhasePerfRead(pp, th, now);
+        for (int e=0; e<PEV_COUNT; ++e)
+        {
+            if (now[e] >= pp->last[th][e])
+                pp->total[phase][th][e] += now[e] - pp->last[th][e];
+            pp->last[th][e] = now[e];
+        }
+        pp->snapped[th] = 0;
+    }
+#else
+    (void)t; (void)phase; (void)usesnap;
+#endif
+}
+
+#ifdef __linux__
+// Read a sysfs counter from an open file (0 on error)
+static unsigned long long PhaseRaplValue(int fd)
+{
+    char buf[32];
+    ssize_t n = pread(fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return 0;
+    buf[n] = '\0';
+    return strtoull(buf, NULL, 10);
+}
+#endif
+
+// Open the package and DRAM energy counters (called from PhaseInit)
+static void PhaseEnergyInit(struct PhaseTimer *t)
+{
+    if (!PhaseEnvOn("PHASE_ENERGY"))
+    {
+        snprintf(t->energyreason, sizeof(t->energyreason), "off (set PHASE_ENERGY=1)");
+        return;
+    }
+#ifdef __linux__
+    struct PhaseRapl *r = &t->rapl;
+    DIR *dir = opendir(PHASE_POWERCAP);
+    int err = 0;
+    struct dirent *de;
+    while (dir != NULL && (de = readdir(dir)) != NULL && r->nzones < PHASE_MAX_RAPL)
+    {
+        if (strncmp(de->d_name, "intel-rapl:", 11) != 0) continue;  // also the AMD zones
+
+        char path[512], name[32] = "";
+        snprintf(path, sizeof(path), "%s/%s/name", PHASE_POWERCAP, de->d_name);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) continue;
+        if (fscanf(f, "%31s", name) != 1) name[0] = '\0';
+        fclose(f);
+        int domain = strncmp(name, "package-", 8) == 0 ? RAPL_PKG : strcmp(name, "dram") == 0 ? RAPL_DRAM : -1;
+        if (domain < 0) continue;  // core, uncore, psys
+
+        snprintf(path, sizeof(path), "%s/%s/energy_uj", PHASE_POWERCAP, de->d_name);
+        int fd = open(path, O_RDONLY);
+        char probe[8];
+        if (fd < 0 || pread(fd, probe, sizeof(probe), 0) <= 0)
+        {
+            err = errno;
+            if (fd >= 0) close(fd);
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s/max_energy_range_uj", PHASE_POWERCAP, de->d_name);
+        int rfd = open(path, O_RDONLY);
+        r->range[r->nzones] = rfd >= 0 ? PhaseRaplValue(rfd) : 0;
+        if (rfd >= 0) close(rfd);
+        r->fd[r->nzones] = fd;
+        r->domain[r->nzones] = domain;
+        r->last[r->nzones] = PhaseRaplValue(fd);
+        r->available[domain] = 1;
+        r->nzones++;
+    }
+    if (dir != NULL) closedir(dir);
+
+    if (r->nzones == 0)
+    {
+        if (dir == NULL) snprintf(t->energyreason, sizeof(t->energyreason), "no %s", PHASE_POWERCAP);
+        else if (err) snprintf(t->energyreason, sizeof(t->energyreason), "energy_uj: %s%s", strerror(err),
+            (err == EACCES || err == EPERM) ? " (root only on this kernel)" : "");
+        else snprintf(t->energyreason, sizeof(t->energyreason), "no RAPL package/dram zones");
+    }
+#else
+    snprintf(t->energyreason, sizeof(t->energyreason), "not supported on this platform");
+#endif
+}
+
+// Charge the energy since the last mark to a phase
+static void PhaseEnergySample(struct PhaseTimer *t, enum Phase phase)
+{
+#ifdef __linux__
+    struct PhaseRapl *r = &t->rapl;
+    for (int z=0; z<r->nzones; ++z)
+    {
+        unsigned long long now = PhaseRaplValue(r->fd[z]);
+        if (now == 0) continue;  // failed read, charged at the next mark instead
+        unsigned long long d = now >= r->last[z] ? now - r->last[z] : now + r->range[z] - r->last[z];
+        r->uj[phase][r->domain[z]] += (double)d;
+        r->last[z] = now;
+    }
+#else
+    (void)t; (void)phase;
+#endif
+}
+
+// Read the process's minor / major page faults so far
+static void PhaseFaults(long *faults)
+{
+#ifdef __linux__
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+    {
+        faults[0] = ru.ru_minflt;
+        faults[1] = ru.ru_majflt;
+    }
+#else
+    (void)faults;
+#endif
+}
+
+// Charge the page faults since the last mark to a phase
+static void PhaseFaultSample(struct PhaseTimer *t, enum Phase phase)
+{
+    long now[2] = { t->faults[0], t->faults[1] };
+    PhaseFaults(now);
+    t->phasefaults[phase][0] += now[0] - t->faults[0];
+    t->phasefaults[phase][1] += now[1] - t->faults[1];
+    t->faults[0] = now[0];
+    t->faults[1] = now[1];
+}
+
+// Start timing (call first thing in main)
+// fused - 1 if the variant searches inside its transform loop
+void PhaseInit(struct PhaseTimer *t, int fused)
+{
+    memset(t, 0, sizeof(*t));
+    t->fused = fused;
+    PhasePerfInit(t);
+    PhaseEnergyInit(t);
+    TraceInit();
+    t->account = PhaseEnvOn("PHASE_SYNC") || Trace.on;  // tracing uses the hooks
+    PhaseFaults(t->faults);
+    t->start = t->mark = omp_get_wtime();
+}
+
+// Set the number of pixels processed (for the per-pixel hardware metrics)
+void PhasePixels(struct PhaseTimer *t, unsigned long pixels)
+{
+    t->pixels = pixels;
+}
+
+// After a parallel region: charge each thread's time from its last hook up to `when`
+// as waiting at the join
+static void PhaseThreadsClose(struct PhaseTimer *t, double when)
+{
+    for (int th=0; th<PHASE_MAX_THREADS; ++th)
+    {
+        struct PhaseThread *pt = &t->threads[th];
+        if (!pt->open || pt->lastmark > when) continue;  // still busy after `when`
+        pt->use[USE_WAIT] += when - pt->lastmark;
+        pt->open = 0;
+        pt->syncs++;
+    }
+}
+
+// Charge the time since the last mark to a phase
+void PhaseMark(struct PhaseTimer *t, enum Phase phase)
+{
+    double now = omp_get_wtime();
+    PhaseThreadsClose(t, now);
+    TracePhase(PhaseNames[phase], t->mark, now);
+    t->ms[phase] += (now - t->mark) * 1e3;
+    t->mark = now;
+    PhasePerfSample(t, phase, 0);
+    PhaseEnergySample(t, phase);
+    PhaseFaultSample(t, phase);
+}
+
+// Charge the time up to `when` (an earlier time) to a phase
+void PhaseMarkAt(struct PhaseTimer *t, enum Phase phase, double when)
+{
+    if (when < t->mark) when = t->mark;
+    PhaseThreadsClose(t, when);
+    TracePhase(PhaseNames[phase], t->mark, when);
+    t->ms[phase] += (when - t->mark) * 1e3;
+    t->mark = when;
+    PhasePerfSample(t, phase, 1);
+    PhaseEnergySample(t, phase);  // up to now: the counters cannot be read back in time
+    PhaseFaultSample(t, phase);
+}
+
+// Record that the calling thread has finished its share of a parallel loop;
+// after the region PhaseMarkAt(t, phase, t->loopend) splits the loop from what
+// followed it in the region (e.g. a counter merge), for times and counters alike
+void PhaseThreadDone(struct PhaseTimer *t)
+{
+    double now = omp_get_wtime();
+#ifdef __linux__
+    struct PhasePerf *pp = t->perf;
+    int me = omp_get_thread_num();
+    if (pp != NULL && me < pp->nthreads)
+    {
+        PhasePerfRead(pp, me, pp->snap[me]);
+        pp->snapped[me] = 1;
+    }
+#endif
+    #pragma omp critical(phase_timer)
+    {
+        if (now > t->loopend) t->loopend = now;
+    }
+}
+
+// The calling thread's accounting slot (NULL if off or past PHASE_MAX_THREADS)
+static struct PhaseThread *PhaseSelf(struct PhaseTimer *t)
+{
+    if (!t->account) return NULL;
+    int me = omp_get_thread_num();
+    return me < PHASE_MAX_THREADS ? &t->threads[me] : NULL;
+}
+
+// Charge the calling thread's time since its last hook (or since the last phase
+// mark, for its first hook in a region) to use; returns the current time
+static double PhaseCharge(struct PhaseTimer *t, struct PhaseThread *pt, enum PhaseUse use)
+{
+    double now = omp_get_wtime();
+    double from = pt->open ? pt->lastmark : t->mark;
+    if (now > from) pt->use[use] += now - from;
+    pt->lastmark = now;
+    pt->open = pt->seen = 1;
+    return now;
+}
+
+// Start of a thread's part of a parallel region (the time since the fork is idle)
+void PhaseRegionBegin(struct PhaseTimer *t)
+{
+    struct PhaseThread *pt = PhaseSelf(t);
+    if (pt == NULL) return;
+    pt->regionstart = PhaseCharge(t, pt, USE_IDLE);
+}
+
+// End of a thread's part of a parallel region (the time since the last hook is work);
+// the wait at the region's join is charged at the next phase mark
+void PhaseRegionEnd(struct PhaseTimer *t)
+{
+    struct PhaseThread *pt = PhaseSelf(t);
+    if (pt == NULL) return;
+    PhaseCharge(t, pt, USE_BUSY);
+    if (Trace.on) TraceSpan(TRACE_REGION, pt->regionstart, 0);
+}
+
+// Start of a work item (row or task); the time since the last hook is idle
+void PhaseWorkBegin(struct PhaseTimer *t)
+{
+    struct PhaseThread *pt = PhaseSelf(t);
+    if (pt == NULL) return;
+    pt->workstart = PhaseCharge(t, pt, USE_IDLE);
+}
+
+// End of a work item started by PhaseWorkBegin
+// kind - trace event kind (TRACE_ROW)
+// arg - trace argument (the row)
+void PhaseWorkEnd(struct PhaseTimer *t, enum TraceKind kind, unsigned long arg)
+{
+    struct PhaseThread *pt = PhaseSelf(t);
+    if (pt == NULL) return;
+    PhaseCharge(t, pt, USE_BUSY);
+    if (Trace.on) TraceSpan(kind, pt->workstart, arg);
+}
+
+// Team barrier that charges the work before it and the wait in it (must be reached
+// by every thread of the team, like the barrier it replaces)
+void PhaseBarrier(struct PhaseTimer *t)
+{
+    struct PhaseThread *pt = PhaseSelf(t);
+    double start = pt != NULL ? PhaseCharge(t, pt, USE_BUSY) : 0.0;
+    #pragma omp barrier
+    if (pt == NULL) return;
+    double now = PhaseCharge(t, pt, USE_WAIT);
+    pt->syncs++;
+    if (Trace.on) TraceWait(start, now);
+}
+
+// Start of an atomic / critical merge (the time since the last hook is work)
+void PhaseSyncBegin(struct PhaseTimer *t)
+{
+    struct PhaseThread *pt = PhaseSelf(t);
+    if (pt == NULL) return;
+    pt->workstart = PhaseCharge(t, pt, USE_BUSY);
+}
+
+// End of a merge started by PhaseSyncBegin
+// points - atomic updates / critical sections it executed
+void PhaseSyncEnd(struct PhaseTimer *t, unsigned long points)
+{
+    struct PhaseThread *pt = PhaseSelf(t);
+    if (pt == NULL) return;
+    PhaseCharge(t, pt, USE_SYNC);
+    pt->syncs += points;
+    if (Trace.on) TraceSpan(TRACE_MERGE, pt->workstart, 0);
+}
+
+// Count sync points that no thread hook saw (e.g. per-match atomics, whose number is
+// the sum of the final counts, or fork/join regions on a sequential path)
+void PhaseSyncPoints(struct PhaseTimer *t, unsigned long points)
+{
+    t->syncs += points;
+}
+
+// Print the SYNC / SYNCTHREAD lines
+static void PhaseSyncReport(struct PhaseTimer *t, const char *base)
+{
+    if (!t->account)
+    {
+        fprintf(stderr, "SYNC unavailable: off (set PHASE_SYNC=1)\n");
+        return;
+    }
+    double sum[USE_COUNT] = {0}, maxbusy = 0.0;
+    unsigned long syncs = t->syncs;
+    int active = 0;
+    for (int th=0; th<PHASE_MAX_THREADS; ++th)
+    {
+        const struct PhaseThread *pt = &t->threads[th];
+        if (!pt->seen) continue;
+        active++;
+        for (int u=0; u<USE_COUNT; ++u)
+            sum[u] += pt->use[u];
+        if (pt->use[USE_BUSY] > maxbusy) maxbusy = pt->use[USE_BUSY];
+        syncs += pt->syncs;
+    }
+    if (active == 0)
+    {
+        fprintf(stderr, "SYNC exe=%s threads=0 busy_ms=- wait_ms=- sync_ms=- idle_ms=- imbalance=- sync_points=%lu\n",
+            base, syncs);
+        return;
+    }
+
+    char imbalance[32];
+    double meanbusy = sum[USE_BUSY] / active;
+    snprintf(imbalance, sizeof(imbalance), meanbusy > 0 ? "%.3f" : "-", meanbusy > 0 ? maxbusy / meanbusy : 0.0);
+    fprintf(stderr, "SYNC exe=%s threads=%d busy_ms=%.3f wait_ms=%.3f sync_ms=%.3f idle_ms=%.3f imbalance=%s sync_points=%lu\n",
+        base, active, sum[USE_BUSY] / active * 1e3, sum[USE_WAIT] / active * 1e3, sum[USE_SYNC] / active * 1e3,
+        sum[USE_IDLE] / active * 1e3, imbalance, syncs);
+    if (active < 2) return;
+    for (int th=0; th<PHASE_MAX_THREADS; ++th)
+    {
+        const struct PhaseThread *pt = &t->threads[th];
+        if (!pt->seen) continue;
+        fprintf(stderr, "SYNCTHREAD thread=%d busy_ms=%.3f wait_ms=%.3f sync_ms=%.3f idle_ms=%.3f sync_points=%lu\n",
+            th, pt->use[USE_BUSY] * 1e3, pt->use[USE_WAIT] * 1e3, pt->use[USE_SYNC] * 1e3, pt->use[USE_IDLE] * 1e3,
+            pt->syncs);
+    }
+}
+
+// Format one counter (or "-" if the event is unavailable)
+static const char *PhasePerfValue(char *buf, size_t size, const struct PhasePerf *pp, int e, unsigned long long v)
+{
+    if (pp->available[e]) snprintf(buf, size, "%llu", v);
+    else snprintf(buf, size, "-");
+    return buf;
+}
+
+// Print the PERF / PERFTHREAD lines for every phase that ran
+static void PhasePerfReport(struct PhaseTimer *t)
+{
+    struct PhasePerf *pp = t->perf;
+    if (pp == NULL)
+    {
+        fprintf(stderr, "PERF unavailable: %s\n", t->perfreason);
+        return;
+    }
+
+    char b[PEV_COUNT][32], ipc[32], inpx[32], llc[32], brpx[32];
+    for (int ph=0; ph<PHASE_COUNT; ++ph)
+    {
+        unsigned long long sum[PEV_COUNT] = {0};
+        int active = 0;
+        for (int th=0; th<pp->nthreads; ++th)
+        {
+            for (int e=0; e<PEV_COUNT; ++e)
+                sum[e] += pp->total[ph][th][e];
+            active += (pp->total[ph][th][PEV_CYCLES] > 0);
+        }
+        if (sum[PEV_CYCLES] == 0) continue;
+
+        snprintf(ipc, sizeof(ipc), pp->available[PEV_INSTRUCTIONS] ? "%.3f" : "-",
+            (double)sum[PEV_INSTRUCTIONS] / (double)sum[PEV_CYCLES]);
+        snprintf(inpx, sizeof(inpx), (pp->available[PEV_INSTRUCTIONS] && t->pixels) ? "%.3f" : "-",
+            t->pixels ? (double)sum[PEV_INSTRUCTIONS] / (double)t->pixels : 0.0);
+        snprintf(llc, sizeof(llc), (pp->available[PEV_CACHE_MISSES] && t->pixels) ? "%.5f" : "-",
+            t->pixels ? (double)sum[PEV_CACHE_MISSES] / (double)t->pixels : 0.0);
+        snprintf(brpx, sizeof(brpx), (pp->available[PEV_BRANCH_MISSES] && t->pixels) ? "%.5f" : "-",
+            t->pixels ? (double)sum[PEV_BRANCH_MISSES] / (double)t->pixels : 0.0);
+        fprintf(stderr, "PERF phase=%s threads=%d cycles=%llu instructions=%s ipc=%s instructions_per_px=%s cache_misses=%s "
+                        "llc_misses_per_px=%s branch_misses=%s branch_misses_per_px=%s stalled_cycles=%s\n",
+            PhaseNames[ph], active, sum[PEV_CYCLES],
+            PhasePerfValue(b[1], sizeof(b[1]), pp, PEV_INSTRUCTIONS, sum[PEV_INSTRUCTIONS]), ipc, inpx,
+            PhasePerfValue(b[2], sizeof(b[2]), pp, PEV_CACHE_MISSES, sum[PEV_CACHE_MISSES]), llc,
+            PhasePerfValue(b[3], sizeof(b[3]), pp, PEV_BRANCH_MISSES, sum[PEV_BRANCH_MISSES]), brpx,
+            PhasePerfValue(b[4], sizeof(b[4]), pp, PEV_STALLED, sum[PEV_STALLED]));
+
+        // per-thread breakdown where the phase ran on more than one thread
+        if (active < 2) continue;
+        for (int th=0; th<pp->nthreads; ++th)
+        {
+            const unsigned long long *c = pp->total[ph][th];
+            if (c[PEV_CYCLES] == 0) continue;
+            snprintf(ipc, sizeof(ipc), pp->available[PEV_INSTRUCTIONS] ? "%.3f" : "-",
+                (double)c[PEV_INSTRUCTIONS] / (double)c[PEV_CYCLES]);
+            fprintf(stderr, "PERFTHREAD phase=%s thread=%d cycles=%llu instructions=%s ipc=%s cache_misses=%s "
+                            "branch_misses=%s stalled_cycles=%s\n",
+                PhaseNames[ph], th, c[PEV_CYCLES],
+                PhasePerfValue(b[1], sizeof(b[1]), pp, PEV_INSTRUCTIONS, c[PEV_INSTRUCTIONS]), ipc,
+                PhasePerfValue(b[2], sizeof(b[2]), pp, PEV_CACHE_MISSES, c[PEV_CACHE_MISSES]),
+                PhasePerfValue(b[3], sizeof(b[3]), pp, PEV_BRANCH_MISSES, c[PEV_BRANCH_MISSES]),
+                PhasePerfValue(b[4], sizeof(b[4]), pp, PEV_STALLED, c[PEV_STALLED]));
+        }
+    }
+}
+
+// Format joules and mean watts of one domain over ms (or "-" if the domain is missing)
+static void PhaseEnergyValues(char *j, char *w, size_t size, const struct PhaseRapl *r, int d, double uj, double ms)
+{
+    snprintf(j, size, r->available[d] ? "%.3f" : "-", uj * 1e-6);
+    snprintf(w, size, (r->available[d] && ms > 0) ? "%.2f" : "-", ms > 0 ? uj * 1e-3 / ms : 0.0);
+}
+
+// Print the ENERGY lines for every phase that ran, then the run total
+static void PhaseEnergyReport(struct PhaseTimer *t)
+{
+    struct PhaseRapl *r = &t->rapl;
+    if (r->nzones == 0)
+    {
+        fprintf(stderr, "ENERGY unavailable: %s\n", t->energyreason);
+        return;
+    }
+
+    char pj[32], pw[32], dj[32], dw[32], gpx[32];
+    double sum[RAPL_COUNT] = {0}, ms = (t->mark - t->start) * 1e3;
+    for (int ph=0; ph<PHASE_COUNT; ++ph)
+    {
+        sum[RAPL_PKG] += r->uj[ph][RAPL_PKG];
+        sum[RAPL_DRAM] += r->uj[ph][RAPL_DRAM];
+        if (t->ms[ph] <= 0) continue;
+        PhaseEnergyValues(pj, pw, sizeof(pj), r, RAPL_PKG, r->uj[ph][RAPL_PKG], t->ms[ph]);
+        PhaseEnergyValues(dj, dw, sizeof(dj), r, RAPL_DRAM, r->uj[ph][RAPL_DRAM], t->ms[ph]);
+        fprintf(stderr, "ENERGY phase=%s ms=%.3f pkg_j=%s dram_j=%s pkg_w=%s dram_w=%s\n",
+            PhaseNames[ph], t->ms[ph], pj, dj, pw, dw);
+    }
+    PhaseEnergyValues(pj, pw, sizeof(pj), r, RAPL_PKG, sum[RAPL_PKG], ms);
+    PhaseEnergyValues(dj, dw, sizeof(dj), r, RAPL_DRAM, sum[RAPL_DRAM], ms);
+    snprintf(gpx, sizeof(gpx), t->pixels ? "%.2f" : "-",
+        t->pixels ? (sum[RAPL_PKG] + sum[RAPL_DRAM]) * 1e-6 / ((double)t->pixels * 1e-9) : 0.0);
+    fprintf(stderr, "ENERGY phase=total ms=%.3f pkg_j=%s dram_j=%s pkg_w=%s dram_w=%s j_per_gpx=%s\n",
+        ms, pj, dj, pw, dw, gpx);
+}
+
+// Print the MEMORY line
+static void PhaseMemoryReport(struct PhaseTimer *t, const char *base)
+{
+    char rss[32] = "-";
+#ifdef __linux__
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) == 0)
+        snprintf(rss, sizeof(rss), "%ld", ru.ru_maxrss);  // KiB on Linux
+#endif
+    long minflt = 0, majflt = 0;
+    unsigned long long allocs = 0;
+    for (int ph=0; ph<PHASE_COUNT; ++ph)
+    {
+        minflt += t->phasefaults[ph][0];
+        majflt += t->phasefaults[ph][1];
+    }
+    for (int k=0; k<ALLOC_KINDS; ++k)
+        allocs += AllocCalls[k];
+    fprintf(stderr, "MEMORY exe=%s maxrss_kb=%s minflt=%ld majflt=%ld transform_minflt=%ld", base, rss, minflt, majflt,
+        t->phasefaults[PHASE_TRANSFORM][0]);
+    for (int k=0; k<ALLOC_KINDS; ++k)
+        fprintf(stderr, " %s_bytes=%llu", AllocNames[k], AllocBytes[k]);
+    fprintf(stderr, " allocs=%llu\n", allocs);
+}
+
+// Print the PHASES line to stderr (call after the results have been printed)
+// exe - argv[0]
+void PhaseReport(struct PhaseTimer *t, const char *exe)
+{
+    fflush(stdout);
+    PhaseMark(t, PHASE_PRINT);
+
+    const char *base = strrchr(exe, '/');
+    base = base ? base + 1 : exe;
+    TraceName(base);
+    char search[32];
+    if (t->fused) snprintf(search, sizeof(search), "-");
+    else snprintf(search, sizeof(search), "%.3f", t->ms[PHASE_SEARCH]);
+
+    fprintf(stderr, "PHASES exe=%s threads=%d load_ms=%.3f index_ms=%.3f transform_ms=%.3f search_ms=%s "
+                    "merge_ms=%.3f write_ms=%.3f print_ms=%.3f total_ms=%.3f\n",
+        base, omp_get_max_threads(), t->ms[PHASE_LOAD], t->ms[PHASE_INDEX], t->ms[PHASE_TRANSFORM], search,
+        t->ms[PHASE_MERGE], t->ms[PHASE_WRITE], t->ms[PHASE_PRINT], (t->mark - t->start) * 1e3);
+    PhasePerfReport(t);
+    PhaseEnergyReport(t);
+    PhaseMemoryReport(t, base);
+    PhaseSyncReport(t, base);
+}
+
+#endif
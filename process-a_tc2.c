@@ -4,10 +4,14 @@
 //  - Per-thread private counters, merged at end (reduces atomics)
 //  - Pixel processing order per row remains left→right (identical semantics)
 
+#define _GNU_SOURCE // perf_event_open via syscall() in phasetimer.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
 #include "rawimage.h"
+#include "phasetimer.h"
+#include "searchresults.h"
 
 // Loads data as lines of 1000 pixels (same as sequential A)
 int main(int ac, char **av)
@@ -21,32 +25,46 @@ int main(int ac, char **av)
     char *searchfilename = av[3];
 
     struct Image img;
+    struct PhaseTimer timer;
+    PhaseInit(&timer, 1); // search is fused into the transform loop
+
     printf("Loading file %s\n", infilename);
     LoadFile(infilename, &img, 1000);
+    AllocChargeImage(&img, ALLOC_IMAGE);
     printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
            img.length, img.linesize, img.lines);
 
     struct Image search;
     printf("Loading file %s\n", searchfilename);
     LoadFile(searchfilename, &search, 0);
+    AllocChargeImage(&search, ALLOC_SEARCH);
     printf("Found %lu search term pixels\n", search.length);
+    PhaseMark(&timer, PHASE_LOAD);
+    PhasePixels(&timer, img.length);
 
     unsigned long *counter = malloc(search.length * sizeof(unsigned long));
     if (!counter) FatalError("malloc failed for counter");
+    AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
     for (unsigned long i = 0; i < search.length; ++i) counter[i] = 0;
 
+    PhaseMark(&timer, PHASE_INDEX);
+
     printf("Processing Bleeding, Greyscale, XOR and Searching (tc2: parallel rows + thread-local counters)\n");
 
     // Parallel region with per-thread private counters
-    #pragma omp parallel default(none) shared(img, search, counter)
+    #pragma omp parallel default(none) shared(img, search, counter, timer)
     {
+        PhaseRegionBegin(&timer);
         unsigned long *local = (unsigned long*)calloc(search.length, sizeof(unsigned long));
         if (!local) FatalError("calloc failed for local counter");
+        AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
 
         // Parallelise outer row loop; keep inner pixel loop sequential to preserve left->right dependency
-        #pragma omp for schedule(runtime)
+        // (nowait: the loop's barrier is the traced one below)
+        #pragma omp for schedule(runtime) nowait
         for (unsigned long l = 0; l < img.lines; ++l)
         {
+            PhaseWorkBegin(&timer);
             for (unsigned long p = 0; p < img.linesize; ++p)
             {
                 // Search for the original values
@@ -97,34 +115,40 @@ int main(int ac, char **av)
                     }
                 }
             }
+            PhaseWorkEnd(&timer, TRACE_ROW, l);
         }
+        PhaseBarrier(&timer);
+
+        PhaseThreadDone(&timer);
 
         // Merge thread-local counts into the shared counter
-        #pragma omp for schedule(static)
+        unsigned long merged = 0;
+        PhaseSyncBegin(&timer);
+        #pragma omp for schedule(static) nowait
         for (unsigned long i = 0; i < search.length; ++i) {
             #pragma omp atomic
             counter[i] += local[i];
+            ++merged;
         }
+        PhaseSyncEnd(&timer, merged);
+        PhaseBarrier(&timer);  // the loop's own barrier (nowait above)
 
         free(local);
+        PhaseRegionEnd(&timer);
     } // end parallel
 
+    PhaseMarkAt(&timer, PHASE_TRANSFORM, timer.loopend);
+    PhaseMark(&timer, PHASE_MERGE);
+
     // Save the transformed image
     printf("Saving file %s\n", outfilename);
     WriteFile(outfilename, &img);
+    PhaseMark(&timer, PHASE_WRITE);
 
     // Print search results (same format)
     printf("Search Results:\n");
-    for (unsigned long i = 0; i < search.length; ++i)
-    {
-        printf("** (");
-        PrintRGBValue(search.pixels[0][i].red);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].green);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].blue);
-        printf(") = %lu\n", counter[i]);
-    }
+    PrintSearchResults(&search, counter);
 
+    PhaseReport(&timer, av[0]);
     return 0;
 }
@@ -2,10 +2,14 @@
 // Parallel variant for Process A: row-parallel with schedule(runtime),
 // algorithm unchanged, atomics on each match (no per-thread local counters).
 
+#define _GNU_SOURCE // perf_event_open via syscall() in phasetimer.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
 #include "rawimage.h"
+#include "phasetimer.h"
+#include "searchresults.h"
 
 int main(int ac, char **av)
 {
@@ -26,8 +30,12 @@ int main(int ac, char **av)
     // The image for loading from the source file and transformation
     struct Image img;
 
+    struct PhaseTimer timer;
+    PhaseInit(&timer, 1); // search is fused into the transform loop
+
     printf("Loading file %s\n",infilename);
     LoadFile(infilename, &img, 1000); // load the file as lines of 1000 pixels
+    AllocChargeImage(&img, ALLOC_IMAGE);
     printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
         img.length, img.linesize, img.lines);
 
@@ -36,23 +44,34 @@ int main(int ac, char **av)
 
     printf("Loading file %s\n",searchfilename);
     LoadFile(searchfilename, &search, 0); // load the search file onto a single line
+    AllocChargeImage(&search, ALLOC_SEARCH);
     printf("Found %lu search term pixels\n",search.length);
+    PhaseMark(&timer, PHASE_LOAD);
+    PhasePixels(&timer, img.length);
 
     unsigned long *counter = (unsigned long*)malloc(search.length * sizeof(unsigned long)); // allocate the counter array
     if (!counter) FatalError("malloc failed for counter");
+    AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
     for(unsigned long i=0; i<search.length; ++i)
         counter[i] = 0; // initialise as zero
 
     // LOADING COMPLETE
 
+    PhaseMark(&timer, PHASE_INDEX);
+
     printf("Processing Bleeding, Greyscale, XOR and Searching (tc3: row-parallel + atomic on matches)\n");
 
     // Parallelise across rows; keep left->right order within each row for the bleed dependency.
-    #pragma omp parallel default(none) shared(img, search, counter)
+    #pragma omp parallel default(none) shared(img, search, counter, timer)
     {
-        #pragma omp for schedule(runtime)
+        PhaseRegionBegin(&timer);
+
+        // nowait: the loop's barrier is the traced one below
+        #pragma omp for schedule(runtime) nowait
         for(unsigned long l=0; l<img.lines; ++l)
         {
+            PhaseWorkBegin(&timer);
+
             // Loop through the data points in this row (must be sequential for bleed)
             for(unsigned long p=0; p<img.linesize; ++p)
             {
@@ -119,25 +138,27 @@ int main(int ac, char **av)
                     }
                 }
             }
+            PhaseWorkEnd(&timer, TRACE_ROW, l);
         }
+        PhaseBarrier(&timer);
+        PhaseRegionEnd(&timer);
     } // end parallel region
 
+    PhaseMark(&timer, PHASE_TRANSFORM);
+    // one atomic update per match: their number is the sum of the counts
+    unsigned long matches = 0;
+    for (unsigned long i = 0; i < search.length; ++i) matches += counter[i];
+    PhaseSyncPoints(&timer, matches);
+
     // Transformation finished - save the file
     printf("Saving file %s\n",outfilename);
     WriteFile(outfilename, &img);
+    PhaseMark(&timer, PHASE_WRITE);
 
     // Now print the search results (careful of the format!)
     printf("Search Results:\n");
-    for(unsigned long i=0; i<search.length; ++i)
-    {
-        printf("** (");
-        PrintRGBValue(search.pixels[0][i].red);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].green);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].blue);
-        printf(") = %lu\n",counter[i]);
-    }
+    PrintSearchResults(&search, counter);
 
+    PhaseReport(&timer, av[0]);
     return 0;
 }
@@ -6,10 +6,14 @@
 //  - Keeps original O(search.length) scans (no algorithmic changes)
 //  - No schedule(runtime) used here (tasking instead)
 
+#define _GNU_SOURCE // perf_event_open via syscall() in phasetimer.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
 #include "rawimage.h"
+#include "phasetimer.h"
+#include "searchresults.h"
 
 int main(int ac, char **av)
 {
@@ -22,20 +26,30 @@ int main(int ac, char **av)
     char *searchfilename= av[3];
 
     struct Image img;
+    struct PhaseTimer timer;
+    PhaseInit(&timer, 1); // search is fused into the transform loop
+
     printf("Loading file %s\n", infilename);
     LoadFile(infilename, &img, 1000);
+    AllocChargeImage(&img, ALLOC_IMAGE);
     printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
            img.length, img.linesize, img.lines);
 
     struct Image search;
     printf("Loading file %s\n", searchfilename);
     LoadFile(searchfilename, &search, 0);
+    AllocChargeImage(&search, ALLOC_SEARCH);
     printf("Found %lu search term pixels\n", search.length);
+    PhaseMark(&timer, PHASE_LOAD);
+    PhasePixels(&timer, img.length);
 
     unsigned long *counter = (unsigned long*)malloc(search.length * sizeof(unsigned long));
     if (!counter) FatalError("malloc failed for counter");
+    AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
     for (unsigned long i = 0; i < search.length; ++i) counter[i] = 0;
 
+    PhaseMark(&timer, PHASE_INDEX);
+
     printf("Processing Bleeding, Greyscale, XOR and Searching (tc4: task-per-row, no algorithm changes)\n");
 
     // Parallel region that spawns tasks; each row is its own task
@@ -43,12 +57,16 @@ int main(int ac, char **av)
     {
         #pragma omp single nowait
         {
+            double spawnstart = TraceNow();
             for (unsigned long l = 0; l < img.lines; ++l) {
-                #pragma omp task firstprivate(l) default(none) shared(img, search, counter)
+                #pragma omp task firstprivate(l) default(none) shared(img, search, counter, timer)
                 {
+                    PhaseWorkBegin(&timer);
+
                     // Per-task local counter to avoid contention
                     unsigned long *local = (unsigned long*)calloc(search.length, sizeof(unsigned long));
                     if (!local) FatalError("calloc failed for local counter");
+                    AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
 
                     for (unsigned long p = 0; p < img.linesize; ++p)
                     {
@@ -102,32 +120,31 @@ int main(int ac, char **av)
                     }
 
                     // Merge local counts once (atomic per element)
+                    PhaseSyncBegin(&timer);
                     for (unsigned long i = 0; i < search.length; ++i) {
                         #pragma omp atomic
                         counter[i] += local[i];
                     }
+                    PhaseSyncEnd(&timer, search.length);
                     free(local);
+                    PhaseWorkEnd(&timer, TRACE_ROW, l);
                 } // task
             } // rows
+            TraceSpan(TRACE_SPAWN, spawnstart, 0);
         } // single
         #pragma omp taskwait
     } // parallel
 
+    PhaseMark(&timer, PHASE_TRANSFORM);
+
     printf("Saving file %s\n", outfilename);
     WriteFile(outfilename, &img);
+    PhaseMark(&timer, PHASE_WRITE);
 
     // Output format identical to baseline
     printf("Search Results:\n");
-    for (unsigned long i = 0; i < search.length; ++i)
-    {
-        printf("** (");
-        PrintRGBValue(search.pixels[0][i].red);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].green);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].blue);
-        printf(") = %lu\n", counter[i]);
-    }
+    PrintSearchResults(&search, counter);
 
+    PhaseReport(&timer, av[0]);
     return 0;
 }
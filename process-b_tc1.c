@@ -4,10 +4,14 @@
 // - Parallelise only the 'i' search loops with schedule(runtime).
 // - Use atomics for counter[i] updates (no algorithm change).
 
+#define _GNU_SOURCE // perf_event_open via syscall() in phasetimer.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
 #include "rawimage.h"
+#include "phasetimer.h"
+#include "searchresults.h"
 
 int main(int ac, char **av)
 {
@@ -27,8 +31,12 @@ int main(int ac, char **av)
     // The image for loading from the source file and transformation
     struct Image img;
 
+    struct PhaseTimer timer;
+    PhaseInit(&timer, 1); // search is fused into the transform loop
+
     printf("Loading file %s\n", infilename);
     LoadFile(infilename, &img, 0); // load the file as a single line
+    AllocChargeImage(&img, ALLOC_IMAGE);
     printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
            img.length, img.linesize, img.lines);
 
@@ -37,21 +45,29 @@ int main(int ac, char **av)
 
     printf("Loading file %s\n", searchfilename);
     LoadFile(searchfilename, &search, 0); // load the search file onto a single line
+    AllocChargeImage(&search, ALLOC_SEARCH);
     printf("Found %lu search term pixels\n", search.length);
+    PhaseMark(&timer, PHASE_LOAD);
+    PhasePixels(&timer, img.length);
 
     unsigned long *counter = (unsigned long *)malloc(search.length * sizeof(unsigned long));
     if (!counter) {
         FatalError("malloc failed for counter");
     }
+    AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
     for (unsigned long i = 0; i < search.length; ++i) counter[i] = 0;
 
     // LOADING COMPLETE
 
+    PhaseMark(&timer, PHASE_INDEX);
+
     printf("Processing Bleeding, Greyscale, XOR and Searching (b_tc1: i-parallel + atomics, schedule(runtime))\n");
 
     // Loop through the data points (p stays strictly sequential to preserve bleeding)
     for (unsigned long p = 0; p < img.linesize; ++p)
     {
+        TraceBlock(p); // the team is forked per search, so only this driving thread is traced
+
         // Search for the original values (parallel over i)
         #pragma omp parallel for schedule(runtime)
         for (unsigned long i = 0; i < search.length; ++i)
@@ -117,23 +133,25 @@ int main(int ac, char **av)
             }
         }
     }
+    TraceBlockEnd(img.linesize);
+
+    PhaseMark(&timer, PHASE_TRANSFORM);
+
+    // the team is forked per search, so there are no per-thread hooks: count each
+    // region's join for every thread, plus one atomic update per match
+    unsigned long matches = 0;
+    for (unsigned long i = 0; i < search.length; ++i) matches += counter[i];
+    PhaseSyncPoints(&timer, 2 * img.linesize * (unsigned long)omp_get_max_threads() + matches);
 
     // Transformation finished - save the file
     printf("Saving file %s\n", outfilename);
     WriteFile(outfilename, &img);
+    PhaseMark(&timer, PHASE_WRITE);
 
     // Now print the search results (careful of the format!)
     printf("Search Results:\n");
-    for (unsigned long i = 0; i < search.length; ++i)
-    {
-        printf("** (");
-        PrintRGBValue(search.pixels[0][i].red);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].green);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].blue);
-        printf(") = %lu\n", counter[i]);
-    }
+    PrintSearchResults(&search, counter);
 
+    PhaseReport(&timer, av[0]);
     return 0;
 }
@@ -6,10 +6,14 @@
 //   - Pixel values are copied to local scalars before parallel regions to avoid races.
 //   - Small vectorisation hint for averaging (no algorithm change).
 
+#define _GNU_SOURCE // perf_event_open via syscall() in phasetimer.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <omp.h>
 #include "rawimage.h"
+#include "phasetimer.h"
+#include "searchresults.h"
 
 int main(int ac, char **av)
 {
@@ -29,8 +33,12 @@ int main(int ac, char **av)
     // The image for loading from the source file and transformation
     struct Image img;
 
+    struct PhaseTimer timer;
+    PhaseInit(&timer, 1); // search is fused into the transform loop
+
     printf("Loading file %s\n", infilename);
     LoadFile(infilename, &img, 0); // load the file as a single line
+    AllocChargeImage(&img, ALLOC_IMAGE);
     printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
            img.length, img.linesize, img.lines);
 
@@ -39,35 +47,50 @@ int main(int ac, char **av)
 
     printf("Loading file %s\n", searchfilename);
     LoadFile(searchfilename, &search, 0); // load the search file onto a single line
+    AllocChargeImage(&search, ALLOC_SEARCH);
     printf("Found %lu search term pixels\n", search.length);
+    PhaseMark(&timer, PHASE_LOAD);
+    PhasePixels(&timer, img.length);
 
     unsigned long *counter = (unsigned long *)malloc(search.length * sizeof(unsigned long));
     if (!counter) {
         FatalError("malloc failed for counter");
     }
+    AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
     for (unsigned long i = 0; i < search.length; ++i) counter[i] = 0;
 
     // LOADING COMPLETE
 
+    PhaseMark(&timer, PHASE_INDEX);
+
     printf("Processing Bleeding, Greyscale, XOR and Searching (b_tc2: team-per-run + i-parallel, schedule(runtime))\n");
 
     // Single parallel region for entire processing
     #pragma omp parallel
     {
+        PhaseRegionBegin(&timer);
+
+        // Each single/for below is nowait with a PhaseBarrier (a plain barrier that also
+        // accounts the wait in it) straight after, standing in for its implicit barrier,
+        // and each explicit barrier is a PhaseBarrier too: all nine barriers per pixel
+        // stay, so timings compare with the untimed build.
         for (unsigned long p = 0; p < img.linesize; ++p)
         {
+            TraceBlock(p);
+
             // --- Phase 1: search original values (parallel over i) ---
             // Copy pixel to scalars in a single region to avoid races with updates
             int r0, g0, b0;
-            #pragma omp single
+            #pragma omp single nowait
             {
                 r0 = img.pixels[0][p].red;
                 g0 = img.pixels[0][p].green;
                 b0 = img.pixels[0][p].blue;
             }
-            #pragma omp barrier
+            PhaseBarrier(&timer);  // the single's own barrier
+            PhaseBarrier(&timer);
 
-            #pragma omp for schedule(runtime)
+            #pragma omp for schedule(runtime) nowait
             for (unsigned long i = 0; i < search.length; ++i)
             {
                 if (r0 == search.pixels[0][i].red &&
@@ -78,9 +101,10 @@ int main(int ac, char **av)
                     counter[i]++;
                 }
             }
+            PhaseBarrier(&timer);  // the loop's own barrier
 
             // --- Phase 2: sequential bleeding + greyscale + XOR (must be ordered) ---
-            #pragma omp single
+            #pragma omp single nowait
             {
                 // "Bleed" colours from left to right up to 10 pixels (if we have pixels to the left)
                 if (p > 0)
@@ -119,19 +143,21 @@ int main(int ac, char **av)
                 // XOR by 13
                 XOR(&(img.pixels[0][p]), 13);
             }
-            #pragma omp barrier
+            PhaseBarrier(&timer);  // the single's own barrier
+            PhaseBarrier(&timer);
 
             // --- Phase 3: search transformed values (parallel over i) ---
             int r1, g1, b1;
-            #pragma omp single
+            #pragma omp single nowait
             {
                 r1 = img.pixels[0][p].red;
                 g1 = img.pixels[0][p].green;
                 b1 = img.pixels[0][p].blue;
             }
-            #pragma omp barrier
+            PhaseBarrier(&timer);  // the single's own barrier
+            PhaseBarrier(&timer);
 
-            #pragma omp for schedule(runtime)
+            #pragma omp for schedule(runtime) nowait
             for (unsigned long i = 0; i < search.length; ++i)
             {
                 if (r1 == search.pixels[0][i].red &&
@@ -142,28 +168,30 @@ int main(int ac, char **av)
                     counter[i]++;
                 }
             }
+            PhaseBarrier(&timer);  // the loop's own barrier
 
             // Synchronise before proceeding to next pixel p
-            #pragma omp barrier
+            PhaseBarrier(&timer);
         } // end for p
+        TraceBlockEnd(img.linesize);
+        PhaseRegionEnd(&timer);
     } // end parallel
 
+    PhaseMark(&timer, PHASE_TRANSFORM);
+    // one atomic update per match: their number is the sum of the counts
+    unsigned long matches = 0;
+    for (unsigned long i = 0; i < search.length; ++i) matches += counter[i];
+    PhaseSyncPoints(&timer, matches);
+
     // Transformation finished - save the file
     printf("Saving file %s\n", outfilename);
     WriteFile(outfilename, &img);
+    PhaseMark(&timer, PHASE_WRITE);
 
     // Now print the search results (careful of the format!)
     printf("Search Results:\n");
-    for (unsigned long i = 0; i < search.length; ++i)
-    {
-        printf("** (");
-        PrintRGBValue(search.pixels[0][i].red);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].green);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].blue);
-        printf(") = %lu\n", counter[i]);
-    }
+    PrintSearchResults(&search, counter);
 
+    PhaseReport(&timer, av[0]);
     return 0;
 }
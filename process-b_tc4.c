@@ -8,11 +8,15 @@
 //
 // You can change tile size at compile time:  -DTILE_I=2048
 
+#define _GNU_SOURCE // perf_event_open via syscall() in phasetimer.h
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <omp.h>
 #include "rawimage.h"
+#include "phasetimer.h"
+#include "searchresults.h"
 
 #ifndef TILE_I
 #define TILE_I 1024
@@ -36,8 +40,12 @@ int main(int ac, char **av)
     // The image for loading from the source file and transformation
     struct Image img;
 
+    struct PhaseTimer timer;
+    PhaseInit(&timer, 1); // search is fused into the transform loop
+
     printf("Loading file %s\n", infilename);
     LoadFile(infilename, &img, 0); // load the file as a single line
+    AllocChargeImage(&img, ALLOC_IMAGE);
     printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
            img.length, img.linesize, img.lines);
 
@@ -46,39 +54,54 @@ int main(int ac, char **av)
 
     printf("Loading file %s\n", searchfilename);
     LoadFile(searchfilename, &search, 0); // single line
+    AllocChargeImage(&search, ALLOC_SEARCH);
     printf("Found %lu search term pixels\n", search.length);
+    PhaseMark(&timer, PHASE_LOAD);
+    PhasePixels(&timer, img.length);
 
     unsigned long *counter = (unsigned long *)malloc(search.length * sizeof(unsigned long));
     if (!counter) FatalError("malloc failed for counter");
+    AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
     for (unsigned long i = 0; i < search.length; ++i) counter[i] = 0;
 
+    PhaseMark(&timer, PHASE_INDEX);
+
     printf("Processing Bleeding, Greyscale, XOR and Searching (b_tc4: tiled i-parallel, thread-local counters, schedule(runtime))\n");
 
     // One parallel team for the whole processing
     #pragma omp parallel
     {
+        PhaseRegionBegin(&timer);
         // Per-thread local counters (avoid atomics)
         unsigned long *local = (unsigned long *)calloc(search.length, sizeof(unsigned long));
         if (!local) {
             #pragma omp critical
             { FatalError("calloc failed for local counters"); }
         }
+        AllocCharge(ALLOC_COUNTERS, search.length * sizeof(unsigned long));
 
+        // Each single/for below is nowait with a PhaseBarrier (a plain barrier that also
+        // accounts the wait in it) straight after, standing in for its implicit barrier,
+        // and each explicit barrier is a PhaseBarrier too: all nine barriers per pixel
+        // stay, so timings compare with the untimed build.
         for (unsigned long p = 0; p < img.linesize; ++p)
         {
+            TraceBlock(p);
+
             // Capture the current pixel into scalars (before any modification)
             int r0, g0, b0;
-            #pragma omp single
+            #pragma omp single nowait
             {
                 r0 = img.pixels[0][p].red;
                 g0 = img.pixels[0][p].green;
                 b0 = img.pixels[0][p].blue;
             }
-            #pragma omp barrier
+            PhaseBarrier(&timer);  // the single's own barrier
+            PhaseBarrier(&timer);
 
             // -------- Phase 1: search original values (tiled, parallel over tiles) --------
             unsigned long tiles1 = (search.length + TILE_I - 1) / TILE_I;
-            #pragma omp for schedule(runtime)
+            #pragma omp for schedule(runtime) nowait
             for (unsigned long tb = 0; tb < tiles1; ++tb) {
                 unsigned long start = tb * (unsigned long)TILE_I;
                 unsigned long end   = start + (unsigned long)TILE_I;
@@ -94,9 +117,10 @@ int main(int ac, char **av)
                     }
                 }
             }
+            PhaseBarrier(&timer);  // the loop's own barrier
 
             // -------- Phase 2: sequential bleeding + greyscale + XOR (must be ordered) --------
-            #pragma omp single
+            #pragma omp single nowait
             {
                 if (p > 0)
                 {
@@ -129,21 +153,23 @@ int main(int ac, char **av)
                 Greyscale(&(img.pixels[0][p]));
                 XOR(&(img.pixels[0][p]), 13);
             }
-            #pragma omp barrier
+            PhaseBarrier(&timer);  // the single's own barrier
+            PhaseBarrier(&timer);
 
             // Capture the transformed pixel for the second search
             int r1, g1, b1;
-            #pragma omp single
+            #pragma omp single nowait
             {
                 r1 = img.pixels[0][p].red;
                 g1 = img.pixels[0][p].green;
                 b1 = img.pixels[0][p].blue;
             }
-            #pragma omp barrier
+            PhaseBarrier(&timer);  // the single's own barrier
+            PhaseBarrier(&timer);
 
             // -------- Phase 3: search transformed values (tiled, parallel over tiles) --------
             unsigned long tiles2 = (search.length + TILE_I - 1) / TILE_I;
-            #pragma omp for schedule(runtime)
+            #pragma omp for schedule(runtime) nowait
             for (unsigned long tb = 0; tb < tiles2; ++tb) {
                 unsigned long start = tb * (unsigned long)TILE_I;
                 unsigned long end   = start + (unsigned long)TILE_I;
@@ -159,36 +185,39 @@ int main(int ac, char **av)
                     }
                 }
             }
+            PhaseBarrier(&timer);  // the loop's own barrier
 
             // Make sure all threads finish this pixel before advancing
-            #pragma omp barrier
+            PhaseBarrier(&timer);
         } // end for p
 
+        TraceBlockEnd(img.linesize);
+        PhaseThreadDone(&timer);
+
         // Combine thread-local counts once at the end
+        PhaseSyncBegin(&timer);
         #pragma omp critical
         {
             for (unsigned long i = 0; i < search.length; ++i)
                 counter[i] += local[i];
         }
+        PhaseSyncEnd(&timer, 1);
         free(local);
+        PhaseRegionEnd(&timer);
     } // end parallel region
 
+    PhaseMarkAt(&timer, PHASE_TRANSFORM, timer.loopend);
+    PhaseMark(&timer, PHASE_MERGE);
+
     // Save the transformed image
     printf("Saving file %s\n", outfilename);
     WriteFile(outfilename, &img);
+    PhaseMark(&timer, PHASE_WRITE);
 
     // Print the search results (careful of the format!)
     printf("Search Results:\n");
-    for (unsigned long i = 0; i < search.length; ++i)
-    {
-        printf("** (");
-        PrintRGBValue(search.pixels[0][i].red);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].green);
-        printf(",");
-        PrintRGBValue(search.pixels[0][i].blue);
-        printf(") = %lu\n", counter[i]);
-    }
+    PrintSearchResults(&search, counter);
 
+    PhaseReport(&timer, av[0]);
     return 0;
 }
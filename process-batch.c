@@ -0,0 +1,293 @@
+// process-batch.c
+// Batch mode for Process A / Process B: many (input, output) pairs in one process.
+//  - The search file is loaded and indexed once and shared by every job
+//  - One OpenMP team for the whole batch
+//  - Jobs are split by size into "wide" jobs (run one at a time across all threads,
+//    rows in parallel) and "narrow" jobs (one thread each, many at once)
+//  - Method B is a single bleed chain per file so its jobs are always narrow
+//  - Output files and search counts are identical to a_seq / b_seq
+//  - Linked against librawimage: the split and the processing are ProcessA /
+//    ProcessB (librawimage.h); this file reads the manifest and prints the reports
+//  - If RAWIMAGE_CACHE_DIR is set, results are looked up in / stored to the
+//    content-addressed result cache (see resultcache.h)
+//
+// Usage: ab_batch a|b manifest_filename search_filename [wide_min_pixels]
+//
+// The manifest holds one "input_filename output_filename" pair per line; blank
+// lines and lines starting with # are ignored. wide_min_pixels overrides the
+// default split (a job is wide if it holds at least 1/threads of all pixels).
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "librawimage.h"
+#include "resultcache.h"
+
+// One manifest entry
+struct BatchJob {
+    char *infilename;
+    char *outfilename;
+    unsigned long pixels; // input size in pixels (from stat)
+    unsigned long order;  // position in the manifest
+    int wide;
+    int cached;           // answered from the result cache
+    int hashed;           // the input hashed, so key is valid
+    unsigned long long key; // result cache key (for storing on a miss)
+};
+
+static const char *cachedir = NULL;      // NULL when caching is off
+static unsigned long long searchhash = 0;
+
+// Monotonic time in seconds
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Read the manifest into an array of jobs
+// filename - the manifest to read (fatal error if can't open)
+// count - output, number of jobs read
+static struct BatchJob *ReadManifest(const char *filename, unsigned long *count)
+{
+    FILE *fp = fopen(filename, "r");
+    if (fp == NULL) FatalError("Cannot open manifest for reading");
+
+    unsigned long cap = 64, n = 0;
+    struct BatchJob *jobs = (struct BatchJob*)malloc(cap * sizeof(struct BatchJob));
+    if (jobs == NULL) FatalError("Cannot allocate memory for manifest");
+
+    char line[8192];
+    char in[4096], out[4096];
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        char *s = line;
+        while (*s == ' ' || *s == '\t') ++s;
+        if (*s == '#' || *s == '\n' || *s == '\0')
+            continue;
+        if (sscanf(s, "%4095s %4095s", in, out) != 2)
+        {
+            fprintf(stderr, "Manifest line: %s", line);
+            FatalError("Manifest lines must be: input_filename output_filename");
+        }
+
+        struct stat st;
+        if (stat(in, &st) != 0)
+        {
+            fprintf(stderr, "Manifest input: %s\n", in);
+            FatalError("Cannot open file for reading");
+        }
+
+        if (n == cap)
+        {
+            cap *= 2;
+            jobs = (struct BatchJob*)realloc(jobs, cap * sizeof(struct BatchJob));
+            if (jobs == NULL) FatalError("Cannot allocate memory for manifest");
+        }
+        jobs[n].infilename = strdup(in);
+        jobs[n].outfilename = strdup(out);
+        jobs[n].pixels = (unsigned long)st.st_size / sizeof(struct Pixel);
+        jobs[n].order = n;
+        jobs[n].wide = 0;
+        jobs[n].cached = 0;
+        jobs[n].hashed = 0;
+        jobs[n].key = 0;
+        ++n;
+    }
+    fclose(fp);
+
+    *count = n;
+    return jobs;
+}
+
+// Print one job's report and search results (caller holds the output lock)
+static void PrintJob(const struct BatchJob *job, unsigned long njobs, struct Image *search,
+                     const unsigned long *counter, double secs)
+{
+    printf("Job %lu/%lu: %s -> %s [%s%s] %lu pixels in %.3f ms (%.2f Mpixel/s)\n",
+        job->order + 1, njobs, job->infilename, job->outfilename, job->wide ? "wide" : "narrow",
+        job->cached ? ", cached" : "",
+        job->pixels, secs * 1e3, secs > 0 ? (double)job->pixels / secs / 1e6 : 0.0);
+    printf("Search Results:\n");
+    PrintSearchResults(search, counter);
+}
+
+// Answer a job from the result cache if possible
+// parallel - hash the input with the whole team (wide jobs)
+// returns 1 if the output was restored and counter filled in (job->hashed and
+// job->key set either way when the input hashed)
+static int CacheLookupJob(struct BatchJob *job, unsigned long linesize, int parallel,
+                          unsigned long *counter, unsigned long searchlength)
+{
+    unsigned long long inhash;
+    if (cachedir == NULL || HashFile(job->infilename, parallel, &inhash, NULL) != 0)
+        return 0;
+    job->hashed = 1;
+    job->key = ResultCacheKey(inhash, searchhash, linesize);
+
+    struct ResultCacheEntry entry;
+    if (!ResultCacheLookup(cachedir, job->key, searchlength, &entry))
+        return 0;
+    int rc = ResultCacheRestore(&entry, job->outfilename);
+    if (rc == 0)
+        memcpy(counter, entry.counter, searchlength * sizeof(unsigned long));
+    ResultCacheClose(&entry);
+    job->cached = (rc == 0);
+    return job->cached;
+}
+
+// What ProcessJobDone needs besides the job
+struct BatchOutput {
+    struct Image *search;
+    unsigned long njobs;
+};
+
+// ProcessDone callback: report the job and store it in the cache
+static void ProcessJobDone(struct ProcessJob *pj, const struct Image *img, const unsigned long *counter, void *arg)
+{
+    struct BatchOutput *out = (struct BatchOutput*)arg;
+    struct BatchJob *job = (struct BatchJob*)pj->user;
+    if (img == NULL)
+    {
+        fprintf(stderr, "Job %s -> %s: %s\n", pj->infilename, pj->outfilename, strerror(pj->error));
+        FatalError("Cannot process batch job");
+    }
+    job->wide = pj->wide;
+    if (cachedir != NULL && job->hashed)
+        ResultCacheStore(cachedir, job->key, (struct Image*)img, counter, out->search->length);
+    #pragma omp critical(batch_output)
+    PrintJob(job, out->njobs, out->search, counter, pj->seconds);
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 4)
+    {
+        FatalError("Usage: ab_batch a|b manifest_filename search_filename [wide_min_pixels]");
+    }
+
+    unsigned long linesize;
+    if (strcmp(av[1], "a") == 0 || strcmp(av[1], "A") == 0) linesize = 1000;
+    else if (strcmp(av[1], "b") == 0 || strcmp(av[1], "B") == 0) linesize = 0;
+    else FatalError("Method must be a or b");
+
+    char *manifestname = av[2];
+    char *searchfilename = av[3];
+
+    double tstart = Now();
+
+    unsigned long njobs;
+    struct BatchJob *jobs = ReadManifest(manifestname, &njobs);
+    printf("Loaded manifest %s with %lu jobs\n", manifestname, njobs);
+
+    struct Image search;
+    printf("Loading file %s\n", searchfilename);
+    LoadFile(searchfilename, &search, 0);
+    printf("Found %lu search term pixels\n", search.length);
+
+    struct SearchIndex index;
+    SearchIndexBuild(&index, &search);
+    printf("Indexed %lu distinct search colours\n", index.slots);
+
+    cachedir = getenv("RAWIMAGE_CACHE_DIR");
+    if (cachedir != NULL && *cachedir == '\0') cachedir = NULL;
+    if (cachedir != NULL && HashFile(searchfilename, 1, &searchhash, NULL) != 0)
+        FatalError("Cannot open file for reading");
+    if (cachedir != NULL)
+        printf("Using result cache %s\n", cachedir);
+
+    // Partition: a job is wide when it alone is at least one thread's share of the batch
+    // (decided here too, so cached wide jobs hash with the whole team)
+    int nthreads = omp_get_max_threads();
+    unsigned long total = 0;
+    for (unsigned long j=0; j<njobs; ++j)
+        total += jobs[j].pixels;
+    unsigned long widemin = (ac > 4) ? strtoul(av[4], NULL, 10) : total / (unsigned long)nthreads;
+    if (widemin == 0) widemin = 1;
+
+    unsigned long nwide = 0;
+    for (unsigned long j=0; j<njobs; ++j)
+    {
+        jobs[j].wide = (linesize != 0 && nthreads > 1 && jobs[j].pixels >= widemin);
+        nwide += (unsigned long)jobs[j].wide;
+    }
+
+    printf("Processing %lu jobs on %d threads (%lu wide, %lu narrow)\n", njobs, nthreads, nwide, njobs - nwide);
+
+    double tproc = Now();
+
+    // Cache hits are answered here, wide jobs hashing with the whole team and narrow
+    // jobs one per thread; the misses go to librawimage
+    if (cachedir != NULL)
+    {
+        unsigned long *counter = (unsigned long*)malloc((search.length ? search.length : 1) * sizeof(unsigned long));
+        if (counter == NULL) FatalError("malloc failed for counter");
+        for (unsigned long j=0; j<njobs; ++j)
+        {
+            double t0 = Now();
+            if (jobs[j].wide && CacheLookupJob(&jobs[j], linesize, 1, counter, search.length))
+                PrintJob(&jobs[j], njobs, &search, counter, Now() - t0);
+        }
+        free(counter);
+
+        #pragma omp parallel default(none) shared(jobs, njobs, linesize, search)
+        {
+            unsigned long *localcounter = (unsigned long*)malloc((search.length ? search.length : 1) * sizeof(unsigned long));
+            if (localcounter == NULL) FatalError("malloc failed for counter");
+
+            #pragma omp for schedule(dynamic,1)
+            for (unsigned long j=0; j<njobs; ++j)
+            {
+                double t0 = Now();
+                if (!jobs[j].wide && CacheLookupJob(&jobs[j], linesize, 0, localcounter, search.length))
+                {
+                    #pragma omp critical(batch_output)
+                    PrintJob(&jobs[j], njobs, &search, localcounter, Now() - t0);
+                }
+            }
+            free(localcounter);
+        }
+    }
+
+    struct ProcessJob *pjobs = (struct ProcessJob*)calloc(njobs ? njobs : 1, sizeof(struct ProcessJob));
+    if (pjobs == NULL) FatalError("Cannot allocate memory for manifest");
+    unsigned long nmiss = 0;
+    for (unsigned long j=0; j<njobs; ++j)
+    {
+        if (jobs[j].cached) continue;
+        pjobs[nmiss].infilename = jobs[j].infilename;
+        pjobs[nmiss].outfilename = jobs[j].outfilename;
+        pjobs[nmiss].user = &jobs[j];
+        ++nmiss;
+    }
+
+    struct BatchOutput out = { &search, njobs };
+    if (linesize != 0)
+        ProcessA(&index, pjobs, nmiss, widemin, ProcessJobDone, &out);
+    else
+        ProcessB(&index, pjobs, nmiss, ProcessJobDone, &out);
+    free(pjobs);
+
+    double tend = Now();
+    double procsecs = tend - tproc;
+    printf("Batch complete: %lu jobs, %lu pixels in %.3f ms (%.2f Mpixel/s, %.1f files/s), %.3f ms total including setup\n",
+        njobs, total, procsecs * 1e3,
+        procsecs > 0 ? (double)total / procsecs / 1e6 : 0.0,
+        procsecs > 0 ? (double)njobs / procsecs : 0.0,
+        (tend - tstart) * 1e3);
+
+    SearchIndexFree(&index);
+    for (unsigned long j=0; j<njobs; ++j)
+    {
+        free(jobs[j].infilename);
+        free(jobs[j].outfilename);
+    }
+    free(jobs);
+    return 0;
+}
@@ -0,0 +1,598 @@
+// process-bench.c
+// Microbenchmarks for the building blocks of Process A / Process B, each run in
+// isolation on synthetic in-memory data (no input files, no Slurm):
+//  - load, write       LoadFile / WriteFile of a temporary file in lines of 1000 (the
+//                      file stays in the page cache, so this is the library's
+//                      per-pixel stdio cost rather than the disk)
+//  - bleed             the baselines' 10-pixel window average, re-summed per pixel
+//  - greyxor           Greyscale + XOR
+//  - transform         TransformRange without searching (sliding bleed window + greyxor)
+//  - search_linear     the variants' brute-force loop over the search set
+//  - search_tiled      the same loop in tiles of TILE_I entries (b_tc4)
+//  - search_index      the SearchIndex hash probe (searchindex.h)
+//  - merge_atomic      thread-local counters added with one atomic per entry (a_tc4)
+//  - merge_critical    thread-local counters added in a critical section (b_tc3)
+//  - results_printf    the "** (RRR,GGG,BBB) = n" block with PrintRGBValue's printf calls
+//  - results_write     the same text from searchresults.h (buffer + write)
+//  - init_libc         ImageData(RANDOM) as it was: rand() % 255 per channel, one thread
+//  - init_random       ImageData(RANDOM): RandomPixel over the OpenMP team
+//  - init_zero         ImageData(ZERO): calloc'd lines
+// The search, merge and results kernels run once per size in the -s list. The
+// results kernels write to /dev/null and count search entries as "pixels".
+//
+// Every kernel gets untimed warmup iterations, then a fixed number of timed ones; the
+// input is restored (untimed) before each. One line per kernel on stdout:
+//
+//   BENCH kernel=search_index size=61 pixels=1048576 iters=20 median_ms=... min_ms=...
+//         ns_per_px=... gb_per_s=...
+//
+// ns_per_px and gb_per_s use the median. Search kernels do one lookup per pixel, and
+// the linear / tiled ones scale pixels down for sizes above 64 to keep the budget
+// fixed. For the merges "pixels" are counter entries (size x threads, repeated to
+// about -p per iteration). gb_per_s is pixel (12 byte) or counter (8 byte) data
+// processed per second.
+//
+// Usage: ab_bench [-p pixels] [-n iterations] [-w warmups] [-s sizes] [-k kernels]
+//   -p  pixels per iteration (default 1048576)
+//   -n  timed iterations per kernel (default 20)
+//   -w  untimed warmup iterations per kernel (default 3)
+//   -s  comma separated search set sizes (default 1,16,61,256,1024)
+//   -k  comma separated kernel names or prefixes to run, e.g. search,merge (default all)
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <omp.h>
+#include "rawimage.h"
+#include "searchindex.h"
+#include "transform.h"
+#include "searchresults.h"
+
+#ifndef TILE_I
+#define TILE_I 1024
+#endif
+
+#define BENCH_LINESIZE 1000  // Method A line length for load / write
+#define BENCH_MAX_SIZES 32
+
+static unsigned long pixels = 1048576;
+static int iterations = 20;
+static int warmups = 3;
+static const char *kernels = NULL;  // NULL runs everything
+static volatile unsigned long sink;  // keeps results live
+
+// Deterministic pseudo-random numbers (the data must not depend on rand())
+static unsigned long long rngstate = 0x2545F4914F6CDD1DULL;
+static unsigned int Rand(void)
+{
+    rngstate = rngstate * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(rngstate >> 33);
+}
+
+// Is a kernel selected by -k (exact name or prefix of it)
+static int Selected(const char *name)
+{
+    if (kernels == NULL) return 1;
+    const char *s = kernels;
+    while (*s)
+    {
+        size_t n = strcspn(s, ",");
+        if (n > 0 && strncmp(name, s, n) == 0) return 1;
+        s += n;
+        if (*s == ',') ++s;
+    }
+    return 0;
+}
+
+// Fill pixels with colour values 0..255
+static void FillPixels(struct Pixel *px, unsigned long n)
+{
+    for (unsigned long p=0; p<n; ++p)
+    {
+        px[p].red = (int)(Rand() & 255);
+        px[p].green = (int)(Rand() & 255);
+        px[p].blue = (int)(Rand() & 255);
+    }
+}
+
+// Build a search set of n entries: half random colours, half greys (r = g = b), which
+// is what transformed pixels look like, so both kinds of lookup get hits
+static void MakeSearch(struct Image *search, unsigned long n)
+{
+    ImageData(search, n, 0, NONE);
+    for (unsigned long i=0; i<n; ++i)
+    {
+        struct Pixel *px = &(search->pixels[0][i]);
+        if (i % 2)
+        {
+            int v = (int)(Rand() & 255);
+            px->red = px->green = px->blue = v;
+        }
+        else FillPixels(px, 1);
+    }
+}
+
+static int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+// One benchmark: the kernel, an untimed reset before each iteration, and its context
+struct Bench {
+    const char *name;
+    unsigned long size;          // search / counter set size (0: not applicable)
+    unsigned long items;         // pixels (or counters) per iteration
+    unsigned long itembytes;     // bytes per item for gb_per_s
+    void (*reset)(struct Bench *b);
+    void (*run)(struct Bench *b);
+    struct Pixel *line;          // working data
+    struct Pixel *pristine;      // copy restored by ResetLine
+    struct Image *image;         // load / write
+    struct Image *search;
+    struct SearchIndex *index;
+    unsigned long *counters;     // search hits / merge target
+    unsigned long ncounters;     // entries cleared by ResetCounters
+    unsigned long **local;       // per-thread counters for the merges
+    unsigned long reps;          // merge repetitions per iteration
+    const char *filename;
+    FILE *devnull;               // results kernels
+};
+
+// Run warmups and timed iterations and print the BENCH line
+static void RunBench(struct Bench *b)
+{
+    double *ms = (double*)malloc((size_t)iterations * sizeof(double));
+    if (ms == NULL) FatalError("malloc failed for timings");
+    for (int it=-warmups; it<iterations; ++it)
+    {
+        if (b->reset) b->reset(b);
+        double t0 = omp_get_wtime();
+        b->run(b);
+        double t1 = omp_get_wtime();
+        if (it >= 0) ms[it] = (t1 - t0) * 1e3;
+    }
+    qsort(ms, (size_t)iterations, sizeof(double), CompareDouble);
+    double median = (iterations % 2) ? ms[iterations / 2] : (ms[iterations / 2 - 1] + ms[iterations / 2]) / 2;
+    double secs = median * 1e-3;
+
+    char size[32];
+    if (b->size) snprintf(size, sizeof(size), "%lu", b->size);
+    else snprintf(size, sizeof(size), "-");
+    printf("BENCH kernel=%s size=%s pixels=%lu iters=%d median_ms=%.4f min_ms=%.4f ns_per_px=%.3f gb_per_s=%.3f\n",
+        b->name, size, b->items, iterations, median, ms[0],
+        secs > 0 ? secs * 1e9 / (double)b->items : 0.0,
+        secs > 0 ? (double)b->items * (double)b->itembytes / secs * 1e-9 : 0.0);
+    fflush(stdout);
+    free(ms);
+}
+
+static void ResetLine(struct Bench *b)
+{
+    memcpy(b->line, b->pristine, b->items * sizeof(struct Pixel));
+}
+
+static void ResetCounters(struct Bench *b)
+{
+    memset(b->counters, 0, b->ncounters * sizeof(unsigned long));
+}
+
+// --- I/O ---
+
+static void RunWrite(struct Bench *b)
+{
+    WriteFile(b->filename, b->image);
+}
+
+static void RunLoad(struct Bench *b)
+{
+    struct Image img;
+    LoadFile(b->filename, &img, BENCH_LINESIZE);
+    sink += img.pixels[0][0].red;
+    FreeImage(&img);
+}
+
+// --- image initialisation (ImageData + FreeImage, lines of 1000) ---
+
+// ImageData(RANDOM) before RandomPixel: three rand() calls per pixel on one thread
+static void RunInitRand(struct Bench *b)
+{
+    struct Image img;
+    ImageData(&img, b->items, BENCH_LINESIZE, NONE);
+    for (unsigned long l=0; l<img.lines; ++l)
+    {
+        for (unsigned long p=0; p<img.linesize; ++p)
+        {
+            img.pixels[l][p].red = rand() % 255;
+            img.pixels[l][p].green = rand() % 255;
+            img.pixels[l][p].blue = rand() % 255;
+        }
+    }
+    if (img.lines)  // no lines for 0 items
+        sink += (unsigned long)img.pixels[img.lines - 1][0].red;
+    FreeImage(&img);
+}
+
+static void RunInitRandom(struct Bench *b)
+{
+    struct Image img;
+    ImageData(&img, b->items, BENCH_LINESIZE, RANDOM);
+    if (img.lines)  // no lines for 0 items
+        sink += (unsigned long)img.pixels[img.lines - 1][0].red;
+    FreeImage(&img);
+}
+
+static void RunInitZero(struct Bench *b)
+{
+    struct Image img;
+    ImageData(&img, b->items, BENCH_LINESIZE, ZERO);
+    if (img.lines)  // no lines for 0 items
+        sink += (unsigned long)img.pixels[img.lines - 1][0].red;
+    FreeImage(&img);
+}
+
+// --- per-pixel kernels ---
+
+// The baselines' bleed: average up to 10 pixels to the left, re-summed every pixel
+static void RunBleed(struct Bench *b)
+{
+    struct Pixel *line = b->line;
+    for (unsigned long p=1; p<b->items; ++p)
+    {
+        int pixlen = 10;
+        unsigned long startpix = 0;
+        if (p > (unsigned long)pixlen) startpix = p - (unsigned long)pixlen;
+        else pixlen = (int)p;
+        int rav = 0, gav = 0, bav = 0;
+        for (unsigned long i=startpix; i<p; ++i)
+        {
+            rav += line[i].red;
+            gav += line[i].green;
+            bav += line[i].blue;
+        }
+        line[p].red += (rav / pixlen - line[p].red) / 3;
+        line[p].green += (gav / pixlen - line[p].green) / 3;
+        line[p].blue += (bav / pixlen - line[p].blue) / 3;
+    }
+    sink += (unsigned long)line[b->items - 1].red;
+}
+
+static void RunGreyXor(struct Bench *b)
+{
+    for (unsigned long p=0; p<b->items; ++p)
+    {
+        Greyscale(&(b->line[p]));
+        XOR(&(b->line[p]), XOR_VALUE);
+    }
+    sink += (unsigned long)b->line[b->items - 1].red;
+}
+
+static void RunTransform(struct Bench *b)
+{
+    TransformRange(b->line, 0, b->items, NULL, NULL);
+    sink += (unsigned long)b->line[b->items - 1].red;
+}
+
+// --- search backends (one lookup per pixel) ---
+
+static void RunSearchLinear(struct Bench *b)
+{
+    const struct Pixel *s = b->search->pixels[0];
+    for (unsigned long p=0; p<b->items; ++p)
+    {
+        const struct Pixel *px = &(b->line[p]);
+        for (unsigned long i=0; i<b->size; ++i)
+            if (px->red == s[i].red && px->green == s[i].green && px->blue == s[i].blue)
+                b->counters[i]++;
+    }
+    sink += b->counters[0];
+}
+
+static void RunSearchTiled(struct Bench *b)
+{
+    const struct Pixel *s = b->search->pixels[0];
+    unsigned long tiles = (b->size + TILE_I - 1) / TILE_I;
+    for (unsigned long p=0; p<b->items; ++p)
+    {
+        const struct Pixel *px = &(b->line[p]);
+        for (unsigned long tb=0; tb<tiles; ++tb)
+        {
+            unsigned long start = tb * (unsigned long)TILE_I;
+            unsigned long end = start + (unsigned long)TILE_I;
+            if (end > b->size) end = b->size;
+            for (unsigned long i=start; i<end; ++i)
+                if (px->red == s[i].red && px->green == s[i].green && px->blue == s[i].blue)
+                    b->counters[i]++;
+        }
+    }
+    sink += b->counters[0];
+}
+
+static void RunSearchIndex(struct Bench *b)
+{
+    for (unsigned long p=0; p<b->items; ++p)
+        SearchCount(b->index, &(b->line[p]), b->counters);
+    sink += b->counters[0];
+}
+
+// --- counter merging ---
+
+static void RunMergeAtomic(struct Bench *b)
+{
+    unsigned long size = b->size, reps = b->reps;
+    unsigned long *counters = b->counters, **local = b->local;
+    #pragma omp parallel default(none) shared(size, reps, counters, local)
+    {
+        const unsigned long *mine = local[omp_get_thread_num()];
+        for (unsigned long r=0; r<reps; ++r)
+            for (unsigned long i=0; i<size; ++i)
+            {
+                #pragma omp atomic
+                counters[i] += mine[i];
+            }
+    }
+    sink += counters[0];
+}
+
+static void RunMergeCritical(struct Bench *b)
+{
+    unsigned long size = b->size, reps = b->reps;
+    unsigned long *counters = b->counters, **local = b->local;
+    #pragma omp parallel default(none) shared(size, reps, counters, local)
+    {
+        const unsigned long *mine = local[omp_get_thread_num()];
+        for (unsigned long r=0; r<reps; ++r)
+        {
+            #pragma omp critical
+            {
+                for (unsigned long i=0; i<size; ++i)
+                    counters[i] += mine[i];
+            }
+        }
+    }
+    sink += counters[0];
+}
+
+// --- results output ---
+
+// PrintRGBValue, to the benchmark's stream
+static void BenchRGBValue(FILE *f, int value)
+{
+    if (value<100) fprintf(f, " ");
+    if (value<10) fprintf(f, " ");
+    fprintf(f, "%d", value);
+}
+
+static void RunResultsPrintf(struct Bench *b)
+{
+    const struct Image *search = b->search;
+    for (unsigned long r=0; r<b->reps; ++r)
+        for (unsigned long i=0; i<search->length; ++i)
+        {
+            fprintf(b->devnull, "** (");
+            BenchRGBValue(b->devnull, search->pixels[0][i].red);
+            fprintf(b->devnull, ",");
+            BenchRGBValue(b->devnull, search->pixels[0][i].green);
+            fprintf(b->devnull, ",");
+            BenchRGBValue(b->devnull, search->pixels[0][i].blue);
+            fprintf(b->devnull, ") = %lu\n", b->counters[i]);
+        }
+    fflush(b->devnull);
+}
+
+static void RunResultsWrite(struct Bench *b)
+{
+    for (unsigned long r=0; r<b->reps; ++r)
+        if (WriteSearchResults(fileno(b->devnull), b->search, b->counters) != 0)
+            FatalError("Cannot write to /dev/null");
+}
+
+// Parse the -s list
+static int ParseSizes(const char *s, unsigned long *sizes)
+{
+    int n = 0;
+    while (*s && n < BENCH_MAX_SIZES)
+    {
+        char *end;
+        unsigned long v = strtoul(s, &end, 10);
+        if (end == s || v == 0 || (*end != ',' && *end != '\0'))
+            FatalError("Search sizes must be a comma separated list of positive numbers");
+        sizes[n++] = v;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+int main(int ac, char **av)
+{
+    unsigned long sizes[BENCH_MAX_SIZES] = {1, 16, 61, 256, 1024};
+    int nsizes = 5;
+
+    int opt;
+    while ((opt = getopt(ac, av, "p:n:w:s:k:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'p': pixels = strtoul(optarg, NULL, 10); break;
+            case 'n': iterations = atoi(optarg); break;
+            case 'w': warmups = atoi(optarg); break;
+            case 's': nsizes = ParseSizes(optarg, sizes); break;
+            case 'k': kernels = optarg; break;
+            default:
+                FatalError("Usage: ab_bench [-p pixels] [-n iterations] [-w warmups] [-s sizes] [-k kernels]");
+        }
+    }
+    if (pixels < BENCH_LINESIZE || iterations < 1 || warmups < 0)
+        FatalError("Need at least 1000 pixels, 1 iteration and 0 warmups");
+
+    int threads = omp_get_max_threads();
+    printf("Benchmarking %lu pixels, %d iterations after %d warmups, %d threads for the merges\n",
+           pixels, iterations, warmups, threads);
+
+    struct Pixel *pristine = (struct Pixel*)malloc(pixels * sizeof(struct Pixel));
+    struct Pixel *line = (struct Pixel*)malloc(pixels * sizeof(struct Pixel));
+    if (pristine == NULL || line == NULL) FatalError("malloc failed for benchmark data");
+    FillPixels(pristine, pixels);
+
+    struct Bench b;
+
+    // LoadFile / WriteFile through a temporary file
+    if (Selected("write") || Selected("load"))
+    {
+        const char *dir = getenv("TMPDIR");
+        char filename[4096];
+        snprintf(filename, sizeof(filename), "%s/ab_bench_XXXXXX", (dir && *dir) ? dir : "/tmp");
+        int fd = mkstemp(filename);
+        if (fd < 0) FatalError("Cannot create temporary file");
+        close(fd);
+
+        struct Image img;
+        ImageData(&img, pixels, BENCH_LINESIZE, NONE);
+        for (unsigned long p=0; p<img.lines * img.linesize; ++p)
+            img.pixels[p / img.linesize][p % img.linesize] = pristine[p % pixels];
+
+        memset(&b, 0, sizeof(b));
+        b.items = img.lines * img.linesize;
+        b.itembytes = sizeof(struct Pixel);
+        b.image = &img;
+        b.filename = filename;
+        b.name = "write";
+        b.run = RunWrite;
+        if (Selected(b.name)) RunBench(&b);
+        else WriteFile(filename, &img);  // load needs the file
+        b.name = "load";
+        b.run = RunLoad;
+        if (Selected(b.name)) RunBench(&b);
+
+        FreeImage(&img);
+        unlink(filename);
+    }
+
+    // Image initialisation
+    memset(&b, 0, sizeof(b));
+    b.items = pixels;
+    b.itembytes = sizeof(struct Pixel);
+    b.name = "init_libc";
+    b.run = RunInitRand;
+    if (Selected(b.name)) RunBench(&b);
+    b.name = "init_random";
+    b.run = RunInitRandom;
+    if (Selected(b.name)) RunBench(&b);
+    b.name = "init_zero";
+    b.run = RunInitZero;
+    if (Selected(b.name)) RunBench(&b);
+
+    // Per-pixel transform kernels on one line
+    memset(&b, 0, sizeof(b));
+    b.items = pixels;
+    b.itembytes = sizeof(struct Pixel);
+    b.line = line;
+    b.pristine = pristine;
+    b.reset = ResetLine;
+    b.name = "bleed";
+    b.run = RunBleed;
+    if (Selected(b.name)) RunBench(&b);
+    b.name = "greyxor";
+    b.run = RunGreyXor;
+    if (Selected(b.name)) RunBench(&b);
+    b.name = "transform";
+    b.run = RunTransform;
+    if (Selected(b.name)) RunBench(&b);
+
+    // Search backends and merges per search size; searched pixels are pre-transformed
+    // so the grey half of the search set gets hits
+    memcpy(line, pristine, pixels * sizeof(struct Pixel));
+    TransformRange(line, 0, pixels / 2, NULL, NULL);
+    for (int k=0; k<nsizes; ++k)
+    {
+        unsigned long size = sizes[k];
+        struct Image search;
+        MakeSearch(&search, size);
+        struct SearchIndex index;
+        SearchIndexBuild(&index, &search);
+        unsigned long *counters = (unsigned long*)calloc(size, sizeof(unsigned long));
+        if (counters == NULL) FatalError("calloc failed for counters");
+
+        memset(&b, 0, sizeof(b));
+        b.size = size;
+        b.itembytes = sizeof(struct Pixel);
+        b.line = line;
+        b.search = &search;
+        b.index = &index;
+        b.counters = counters;
+        b.ncounters = size;
+        b.reset = ResetCounters;
+
+        // brute force: keep pixels x size (the work per iteration) at most pixels x 64
+        b.items = size > 64 ? pixels / (size / 64) : pixels;
+        b.name = "search_linear";
+        b.run = RunSearchLinear;
+        if (Selected(b.name)) RunBench(&b);
+        b.name = "search_tiled";
+        b.run = RunSearchTiled;
+        if (Selected(b.name)) RunBench(&b);
+        b.items = pixels;
+        b.name = "search_index";
+        b.counters = SearchIndexCounters(&index);  // per distinct colour
+        b.ncounters = index.slots;
+        b.run = RunSearchIndex;
+        if (Selected(b.name)) RunBench(&b);
+        free(b.counters);
+
+        // merges: every thread adds its own counters, repeated up to about -p entries
+        unsigned long **local = (unsigned long**)malloc((size_t)threads * sizeof(unsigned long*));
+        if (local == NULL) FatalError("malloc failed for local counters");
+        for (int t=0; t<threads; ++t)
+        {
+            local[t] = (unsigned long*)malloc(size * sizeof(unsigned long));
+            if (local[t] == NULL) FatalError("malloc failed for local counters");
+            for (unsigned long i=0; i<size; ++i) local[t][i] = Rand() & 7;
+        }
+        b.counters = counters;
+        b.ncounters = size;
+        b.local = local;
+        b.reps = pixels / (size * (unsigned long)threads);
+        if (b.reps == 0) b.reps = 1;
+        b.items = b.reps * size * (unsigned long)threads;
+        b.itembytes = sizeof(unsigned long);
+        b.name = "merge_atomic";
+        b.run = RunMergeAtomic;
+        if (Selected(b.name)) RunBench(&b);
+        b.name = "merge_critical";
+        b.run = RunMergeCritical;
+        if (Selected(b.name)) RunBench(&b);
+
+        // results block: counts of up to four digits, repeated up to about -p / 16 lines
+        for (unsigned long i=0; i<size; ++i) counters[i] = Rand() % 10000;
+        char text[RESULTS_LINE_MAX];
+        unsigned long textbytes = 0;
+        for (unsigned long i=0; i<size; ++i) textbytes += FormatSearchResult(text, &(search.pixels[0][i]), counters[i]);
+        b.devnull = fopen("/dev/null", "w");
+        if (b.devnull == NULL) FatalError("Cannot open /dev/null");
+        b.reset = NULL;
+        b.reps = pixels / 16 / size;
+        if (b.reps == 0) b.reps = 1;
+        b.items = b.reps * size;
+        b.itembytes = textbytes / size;
+        b.name = "results_printf";
+        b.run = RunResultsPrintf;
+        if (Selected(b.name)) RunBench(&b);
+        b.name = "results_write";
+        b.run = RunResultsWrite;
+        if (Selected(b.name)) RunBench(&b);
+        fclose(b.devnull);
+
+        for (int t=0; t<threads; ++t) free(local[t]);
+        free(local);
+        free(counters);
+        SearchIndexFree(&index);
+        FreeImage(&search);
+    }
+
+    free(line);
+    free(pristine);
+    return 0;
+}
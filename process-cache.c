@@ -0,0 +1,155 @@
+// process-cache.c
+// Cached Process A / Process B runs and content hashing (see resultcache.h).
+//
+// Usage: ab_cache run a|b in_filename out_filename search_filename
+//        ab_cache hash filename...
+//
+// "run" prints exactly what a_seq / b_seq print; on a hit the output and counts
+// come from the cache, on a miss they are computed (Method A rows in parallel)
+// and stored. Hit/miss and timings go to stderr.
+// "hash" prints the parallel content hash of each file, md5sum style.
+//
+// The cache directory is $RAWIMAGE_CACHE_DIR, or .rawcache if unset.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <omp.h>
+#include "rawimage.h"
+#include "searchindex.h"
+#include "transform.h"
+#include "resultcache.h"
+#include "searchresults.h"
+
+// Monotonic time in seconds
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int RunCached(const char *method, char *infilename, char *outfilename, char *searchfilename)
+{
+    unsigned long linesize;
+    if (strcmp(method, "a") == 0 || strcmp(method, "A") == 0) linesize = 1000;
+    else if (strcmp(method, "b") == 0 || strcmp(method, "B") == 0) linesize = 0;
+    else FatalError("Method must be a or b");
+
+    const char *dir = ResultCacheDir();
+    double t0 = Now();
+
+    unsigned long long inhash, searchhash;
+    if (HashFile(infilename, 1, &inhash, NULL) != 0) FatalError("Cannot open file for reading");
+    if (HashFile(searchfilename, 1, &searchhash, NULL) != 0) FatalError("Cannot open file for reading");
+    unsigned long long key = ResultCacheKey(inhash, searchhash, linesize);
+    double thash = Now() - t0;
+
+    // the search set is needed to print results either way
+    struct Image search;
+    LoadFile(searchfilename, &search, 0);
+    printf("Loading file %s\n", infilename);
+
+    struct ResultCacheEntry entry;
+    unsigned long *counter;
+    if (ResultCacheLookup(dir, key, search.length, &entry))
+    {
+        unsigned long length = (unsigned long)entry.header.length;
+        printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
+            length, linesize ? linesize : length, linesize ? length / linesize : 1);
+        printf("Loading file %s\n", searchfilename);
+        printf("Found %lu search term pixels\n", search.length);
+        printf("Processing Bleeding, Greyscale, XOR and Searching\n");
+        printf("Saving file %s\n", outfilename);
+        if (ResultCacheRestore(&entry, outfilename) != 0)
+            FatalError("Cannot open file for writing");
+        counter = entry.counter;
+        entry.counter = NULL;
+        ResultCacheClose(&entry);
+        fprintf(stderr, "[cache] hit %016llx in %s (hash %.3f ms, total %.3f ms)\n", key, dir, thash * 1e3, (Now() - t0) * 1e3);
+    }
+    else
+    {
+        struct Image img;
+        LoadFile(infilename, &img, linesize);
+        printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n",
+            img.length, img.linesize, img.lines);
+        printf("Loading file %s\n", searchfilename);
+        printf("Found %lu search term pixels\n", search.length);
+
+        struct SearchIndex index;
+        SearchIndexBuild(&index, &search);
+        unsigned long *hits = SearchIndexCounters(&index);
+
+        printf("Processing Bleeding, Greyscale, XOR and Searching\n");
+        #pragma omp parallel default(none) shared(img, index, hits)
+        {
+            unsigned long *local = SearchIndexCounters(&index);
+
+            #pragma omp for schedule(runtime)
+            for (unsigned long l=0; l<img.lines; ++l)
+                TransformRange(img.pixels[l], 0, img.linesize, &index, local);
+
+            for (unsigned long s=0; s<index.slots; ++s)
+            {
+                if (local[s])
+                {
+                    #pragma omp atomic
+                    hits[s] += local[s];
+                }
+            }
+            free(local);
+        }
+
+        counter = (unsigned long*)malloc((search.length ? search.length : 1) * sizeof(unsigned long));
+        if (counter == NULL) FatalError("malloc failed for counter");
+        SearchIndexExpand(&index, hits, counter);
+
+        printf("Saving file %s\n", outfilename);
+        WriteFile(outfilename, &img);
+
+        int stored = ResultCacheStore(dir, key, &img, counter, search.length);
+        fprintf(stderr, "[cache] miss %016llx in %s (hash %.3f ms, total %.3f ms)%s\n", key, dir, thash * 1e3,
+            (Now() - t0) * 1e3, stored == 0 ? "" : " - store failed");
+
+        free(hits);
+        SearchIndexFree(&index);
+        FreeImage(&img);
+    }
+
+    printf("Search Results:\n");
+    PrintSearchResults(&search, counter);
+
+    free(counter);
+    FreeImage(&search);
+    return 0;
+}
+
+int main(int ac, char **av)
+{
+    if (ac >= 3 && strcmp(av[1], "hash") == 0)
+    {
+        int rc = 0;
+        for (int f=2; f<ac; ++f)
+        {
+            unsigned long long h;
+            if (HashFile(av[f], 1, &h, NULL) != 0)
+            {
+                fprintf(stderr, "ab_cache: %s: %s\n", av[f], strerror(errno));
+                rc = 1;
+                continue;
+            }
+            printf("%016llx  %s\n", h, av[f]);
+        }
+        return rc;
+    }
+    if (ac >= 6 && strcmp(av[1], "run") == 0)
+        return RunCached(av[2], av[3], av[4], av[5]);
+
+    FatalError("Usage: ab_cache run a|b in_filename out_filename search_filename\n"
+               "       ab_cache hash filename...");
+    return 1;
+}
@@ -0,0 +1,549 @@
+// process-daemon.c
+// Service mode for Process A / Process B over a local Unix-domain socket.
+//  - Search files are loaded and indexed once and kept warm (keyed on path + mtime)
+//  - One OpenMP team is reused by every job (Method A rows in parallel)
+//  - Jobs name an input file, or pass an open descriptor with SCM_RIGHTS
+//  - Replies carry the counts in the existing "** (RRR,GGG,BBB) = n" format
+//  - If RAWIMAGE_CACHE_DIR is set, results are looked up in / stored to the
+//    content-addressed result cache (see resultcache.h)
+//
+// Usage: ab_daemon socket_path [max_cached_searches]
+//
+// Protocol (one request per line, any number per connection):
+//   request:  <a|b> <input_filename|-> <output_filename> <search_filename>\n
+//             ("-" means the input descriptor is attached to the request)
+//   reply:    OK <pixels> <microseconds>\nSearch Results:\n** (...) = n\n...END\n
+//         or  ERR <message>\nEND\n
+//
+// SIGINT / SIGTERM remove the socket and exit.
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <omp.h>
+#include "rawimage.h"
+#include "searchindex.h"
+#include "transform.h"
+#include "resultcache.h"
+#include "searchresults.h"
+
+#define MAX_CLIENTS 64
+#define REQUEST_MAX 16384
+
+// A warm search set
+struct CachedSearch {
+    char *filename;
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;
+    off_t size;
+    unsigned long lastuse;
+    struct Image search;
+    struct SearchIndex index;
+    unsigned long long hash; // content hash (only when caching)
+};
+
+// A connected client
+struct Client {
+    int fd;
+    int passedfd;      // descriptor received with the current request (-1 if none)
+    size_t used;
+    char buf[REQUEST_MAX];
+};
+
+// Growable reply buffer
+struct Reply {
+    char *data;
+    size_t used;
+    size_t cap;
+};
+
+static volatile sig_atomic_t stopping = 0;
+static struct CachedSearch *cache = NULL;
+static unsigned long cachesize = 0;
+static unsigned long cachemax = 4;
+static unsigned long usecounter = 0;
+static unsigned long jobsserved = 0;
+static const char *cachedir = NULL;
+
+static void OnSignal(int sig)
+{
+    (void)sig;
+    stopping = 1;
+}
+
+// Monotonic time in seconds
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void ReplyAppend(struct Reply *r, const char *s, size_t n)
+{
+    if (r->used + n + 1 > r->cap)
+    {
+        while (r->used + n + 1 > r->cap)
+            r->cap = r->cap ? r->cap * 2 : 4096;
+        r->data = (char*)realloc(r->data, r->cap);
+        if (r->data == NULL) FatalError("Cannot allocate memory for reply");
+    }
+    memcpy(r->data + r->used, s, n);
+    r->used += n;
+}
+
+static void ReplyPrintf(struct Reply *r, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void ReplyPrintf(struct Reply *r, const char *fmt, ...)
+{
+    char tmp[512];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+    va_end(ap);
+    if (n > 0)
+        ReplyAppend(r, tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+}
+
+// Read a whole descriptor into an Image without exiting on I/O errors
+// returns 0 on success, -1 on failure (errno set)
+static int LoadImageFd(int fd, struct Image *img, unsigned long linesize)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return -1;
+    unsigned long length = (unsigned long)st.st_size / sizeof(struct Pixel);
+    if (length == 0) { errno = EINVAL; return -1; }
+
+    ImageData(img, length, linesize, NONE);
+    unsigned long loaded = 0;
+    for (unsigned long l=0; l<img->lines; ++l)
+    {
+        unsigned long want = img->linesize;
+        if (loaded + want > length)
+            want = (loaded < length) ? length - loaded : 0;
+        size_t bytes = want * sizeof(struct Pixel);
+        size_t got = 0;
+        while (got < bytes)
+        {
+            ssize_t n = pread(fd, (char*)img->pixels[l] + got, bytes - got, (off_t)(loaded * sizeof(struct Pixel) + got));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) { FreeImage(img); if (n == 0) errno = EIO; return -1; }
+            got += (size_t)n;
+        }
+        // pad the final line with zero pixels (as LoadFile does)
+        if (want < img->linesize)
+            memset(img->pixels[l] + want, 0, (img->linesize - want) * sizeof(struct Pixel));
+        loaded += want;
+    }
+    return 0;
+}
+
+// Write an Image without exiting on I/O errors
+// returns 0 on success, -1 on failure (errno set)
+static int WriteImagePath(const char *filename, struct Image *img)
+{
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+    for (unsigned long l=0; l<img->lines; ++l)
+    {
+        const char *p = (const char*)img->pixels[l];
+        size_t left = img->linesize * sizeof(struct Pixel);
+        while (left > 0)
+        {
+            ssize_t n = write(fd, p, left);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) { int e = errno; close(fd); errno = e; return -1; }
+            p += n;
+            left -= (size_t)n;
+        }
+    }
+    return close(fd);
+}
+
+// Find (or load and index) a search set, evicting the least recently used
+// returns NULL on failure (errno set)
+static struct CachedSearch *GetSearch(const char *filename)
+{
+    struct stat st;
+    if (stat(filename, &st) != 0)
+        return NULL;
+
+    for (unsigned long c=0; c<cachesize; ++c)
+    {
+        struct CachedSearch *cs = &cache[c];
+        if (strcmp(cs->filename, filename) == 0)
+        {
+            if (cs->dev == st.st_dev && cs->ino == st.st_ino && cs->size == st.st_size &&
+                cs->mtime.tv_sec == st.st_mtim.tv_sec && cs->mtime.tv_nsec == st.st_mtim.tv_nsec)
+            {
+                cs->lastuse = ++usecounter;
+                return cs;
+            }
+            // stale: drop it and reload below
+            FreeImage(&cs->search);
+            SearchIndexFree(&cs->index);
+            free(cs->filename);
+            cache[c] = cache[--cachesize];
+            break;
+        }
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct Image search;
+    unsigned long long hash = 0;
+    int rc = LoadImageFd(fd, &search, 0);
+    if (rc == 0 && cachedir != NULL && HashFd(fd, 1, &hash, NULL) != 0)
+    {
+        FreeImage(&search);
+        rc = -1;
+    }
+    close(fd);
+    if (rc != 0)
+        return NULL;
+
+    if (cachesize == cachemax) // evict least recently used
+    {
+        unsigned long victim = 0;
+        for (unsigned long c=1; c<cachesize; ++c)
+            if (cache[c].lastuse < cache[victim].lastuse) victim = c;
+        FreeImage(&cache[victim].search);
+        SearchIndexFree(&cache[victim].index);
+        free(cache[victim].filename);
+        cache[victim] = cache[--cachesize];
+    }
+
+    struct CachedSearch *cs = &cache[cachesize++];
+    cs->filename = strdup(filename);
+    cs->dev = st.st_dev;
+    cs->ino = st.st_ino;
+    cs->size = st.st_size;
+    cs->mtime = st.st_mtim;
+    cs->lastuse = ++usecounter;
+    cs->search = search;
+    cs->hash = hash;
+    SearchIndexBuild(&cs->index, &cs->search);
+    fprintf(stderr, "[daemon] indexed %s: %lu entries, %lu distinct\n", filename, search.length, cs->index.slots);
+    return cs;
+}
+
+// Run one job on the warm team and fill in the reply
+static void RunJob(char *line, int passedfd, struct Reply *reply)
+{
+    char method[8], in[4096], out[4096], searchname[4096];
+    if (sscanf(line, "%7s %4095s %4095s %4095s", method, in, out, searchname) != 4)
+    {
+        ReplyPrintf(reply, "ERR request must be: a|b input|- output search\nEND\n");
+        return;
+    }
+
+    unsigned long linesize;
+    if (strcmp(method, "a") == 0 || strcmp(method, "A") == 0) linesize = 1000;
+    else if (strcmp(method, "b") == 0 || strcmp(method, "B") == 0) linesize = 0;
+    else { ReplyPrintf(reply, "ERR method must be a or b\nEND\n"); return; }
+
+    double t0 = Now();
+
+    struct CachedSearch *cs = GetSearch(searchname);
+    if (cs == NULL)
+    {
+        ReplyPrintf(reply, "ERR cannot load search %s: %s\nEND\n", searchname, strerror(errno));
+        return;
+    }
+
+    int infd;
+    if (strcmp(in, "-") == 0)
+    {
+        if (passedfd < 0) { ReplyPrintf(reply, "ERR input '-' but no descriptor passed\nEND\n"); return; }
+        infd = passedfd;
+    }
+    else if ((infd = open(in, O_RDONLY)) < 0)
+    {
+        ReplyPrintf(reply, "ERR cannot open %s: %s\nEND\n", in, strerror(errno));
+        return;
+    }
+
+    unsigned long *counter = (unsigned long*)malloc((cs->search.length ? cs->search.length : 1) * sizeof(unsigned long));
+    if (counter == NULL) FatalError("malloc failed for counter");
+
+    unsigned long length = 0;
+    unsigned long long key = 0;
+    struct ResultCacheEntry entry;
+    unsigned long long inhash;
+    int hit = 0;
+    int hashed = 0;  // key is valid: only then may the result be cached
+    if (cachedir != NULL && HashFd(infd, 1, &inhash, NULL) == 0)
+    {
+        hashed = 1;
+        key = ResultCacheKey(inhash, cs->hash, linesize);
+        if (ResultCacheLookup(cachedir, key, cs->search.length, &entry))
+        {
+            hit = (ResultCacheRestore(&entry, out) == 0);
+            if (hit)
+                memcpy(counter, entry.counter, cs->search.length * sizeof(unsigned long));
+            length = (unsigned long)entry.header.length;
+            ResultCacheClose(&entry);
+        }
+    }
+
+    if (!hit)
+    {
+        struct Image img;
+        int rc = LoadImageFd(infd, &img, linesize);
+        int loaderr = errno;
+        if (infd != passedfd) close(infd);
+        if (rc != 0)
+        {
+            ReplyPrintf(reply, "ERR cannot load input: %s\nEND\n", strerror(loaderr));
+            free(counter);
+            return;
+        }
+
+        struct SearchIndex *index = &cs->index;
+        unsigned long *hits = SearchIndexCounters(index);
+
+        #pragma omp parallel default(none) shared(img, index, hits)
+        {
+            unsigned long *local = SearchIndexCounters(index);
+
+            #pragma omp for schedule(runtime)
+            for (unsigned long l=0; l<img.lines; ++l)
+                TransformRange(img.pixels[l], 0, img.linesize, index, local);
+
+            for (unsigned long s=0; s<index->slots; ++s)
+            {
+                if (local[s])
+                {
+                    #pragma omp atomic
+                    hits[s] += local[s];
+                }
+            }
+            free(local);
+        }
+        SearchIndexExpand(index, hits, counter);
+        free(hits);
+
+        if (WriteImagePath(out, &img) != 0)
+        {
+            ReplyPrintf(reply, "ERR cannot write %s: %s\nEND\n", out, strerror(errno));
+            FreeImage(&img);
+            free(counter);
+            return;
+        }
+        if (hashed)
+            ResultCacheStore(cachedir, key, &img, counter, cs->search.length);
+        length = img.length;
+        FreeImage(&img);
+    }
+    else if (infd != passedfd)
+        close(infd);
+
+    ReplyPrintf(reply, "OK %lu %.0f\nSearch Results:\n", length, (Now() - t0) * 1e6);
+    char text[RESULTS_LINE_MAX];
+    for (unsigned long i=0; i<cs->search.length; ++i)
+        ReplyAppend(reply, text, FormatSearchResult(text, &(cs->search.pixels[0][i]), counter[i]));
+    ReplyAppend(reply, "END\n", 4);
+
+    free(counter);
+}
+
+// Send a whole buffer; returns -1 if the client went away
+static int SendAll(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// Receive from a client, collecting any passed descriptor
+// returns -1 when the client should be dropped
+static int ReadClient(struct Client *c)
+{
+    char ctrl[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { c->buf + c->used, sizeof(c->buf) - c->used - 1 };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    if (iov.iov_len == 0)
+        return -1; // request line too long
+    ssize_t n = recvmsg(c->fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n <= 0)
+        return -1;
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm))
+    {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_RIGHTS)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cm), sizeof(int));
+            if (c->passedfd >= 0) close(c->passedfd);
+            c->passedfd = fd;
+        }
+    }
+    c->used += (size_t)n;
+    return 0;
+}
+
+// Serve every complete request line buffered for a client
+static int ServeClient(struct Client *c, struct Reply *reply)
+{
+    char *nl;
+    while ((nl = memchr(c->buf, '\n', c->used)) != NULL)
+    {
+        *nl = '\0';
+        reply->used = 0;
+        RunJob(c->buf, c->passedfd, reply);
+        ++jobsserved;
+        if (c->passedfd >= 0) { close(c->passedfd); c->passedfd = -1; }
+
+        size_t consumed = (size_t)(nl - c->buf) + 1;
+        memmove(c->buf, nl + 1, c->used - consumed);
+        c->used -= consumed;
+
+        if (SendAll(c->fd, reply->data, reply->used) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+static void DropClient(struct Client *c)
+{
+    close(c->fd);
+    if (c->passedfd >= 0) close(c->passedfd);
+    c->fd = -1;
+    c->passedfd = -1;
+    c->used = 0;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 2)
+    {
+        FatalError("Usage: ab_daemon socket_path [max_cached_searches]");
+    }
+    const char *sockpath = av[1];
+    if (ac > 2) cachemax = strtoul(av[2], NULL, 10);
+    if (cachemax == 0) cachemax = 1;
+
+    cachedir = getenv("RAWIMAGE_CACHE_DIR");
+    if (cachedir != NULL && *cachedir == '\0') cachedir = NULL;
+
+    cache = (struct CachedSearch*)calloc(cachemax, sizeof(struct CachedSearch));
+    if (cache == NULL) FatalError("Cannot allocate memory for search cache");
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sockpath) >= sizeof(addr.sun_path))
+        FatalError("Socket path too long");
+    strcpy(addr.sun_path, sockpath);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0) FatalError("Cannot create socket");
+    unlink(sockpath);
+    if (bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) != 0) FatalError("Cannot bind socket");
+    if (listen(lfd, MAX_CLIENTS) != 0) FatalError("Cannot listen on socket");
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = OnSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    // Start the team now so the first job does not pay for thread creation
+    #pragma omp parallel
+    {
+        (void)0;
+    }
+    fprintf(stderr, "[daemon] listening on %s with %d threads%s%s\n", sockpath, omp_get_max_threads(),
+        cachedir ? ", result cache " : "", cachedir ? cachedir : "");
+
+    static struct Client clients[MAX_CLIENTS];
+    for (int c=0; c<MAX_CLIENTS; ++c) { clients[c].fd = -1; clients[c].passedfd = -1; clients[c].used = 0; }
+    struct Reply reply = { NULL, 0, 0 };
+
+    while (!stopping)
+    {
+        struct pollfd pfds[MAX_CLIENTS + 1];
+        int map[MAX_CLIENTS + 1];
+        int n = 0;
+        pfds[n].fd = lfd; pfds[n].events = POLLIN; map[n++] = -1;
+        for (int c=0; c<MAX_CLIENTS; ++c)
+        {
+            if (clients[c].fd >= 0)
+            {
+                pfds[n].fd = clients[c].fd; pfds[n].events = POLLIN; map[n++] = c;
+            }
+        }
+
+        if (poll(pfds, (nfds_t)n, -1) < 0)
+        {
+            if (errno == EINTR) continue;
+            FatalError("poll failed");
+        }
+
+        if (pfds[0].revents & POLLIN)
+        {
+            int cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+            if (cfd >= 0)
+            {
+                int slot = -1;
+                for (int c=0; c<MAX_CLIENTS && slot < 0; ++c)
+                    if (clients[c].fd < 0) slot = c;
+                if (slot < 0) close(cfd);
+                else clients[slot].fd = cfd;
+            }
+        }
+
+        // one pass over ready clients: each gets its buffered requests served in turn
+        for (int i=1; i<n; ++i)
+        {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+            struct Client *c = &clients[map[i]];
+            if (ReadClient(c) != 0 || ServeClient(c, &reply) != 0)
+                DropClient(c);
+        }
+    }
+
+    fprintf(stderr, "[daemon] shutting down after %lu jobs\n", jobsserved);
+    for (int c=0; c<MAX_CLIENTS; ++c)
+        if (clients[c].fd >= 0) DropClient(&clients[c]);
+    close(lfd);
+    unlink(sockpath);
+    for (unsigned long c=0; c<cachesize; ++c)
+    {
+        FreeImage(&cache[c].search);
+        SearchIndexFree(&cache[c].index);
+        free(cache[c].filename);
+    }
+    free(cache);
+    free(reply.data);
+    return 0;
+}
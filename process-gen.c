@@ -0,0 +1,415 @@
+// process-gen.c
+// Synthetic input / search file generator for scaling runs. Writes an input .raw of
+// any size and a matching search .raw with chosen hit rates, deterministically from a
+// seed (the same arguments give byte-identical files for any thread count).
+//
+// Colour distributions (-d):
+//  - uniform    every channel uniform 0..255
+//  - clustered  GEN_CLUSTERS random centres, channels jittered by up to GEN_SPREAD
+//  - runs       runs of one colour, 1..2L-1 pixels long (mean L, -r)
+//  - grey       near-grey pixels: one level, channels jittered by up to GEN_GREY_JITTER
+// Background pixels are never exact greys (r = g = b) and never one of the search
+// colours, so every hit is a planted one:
+//  - pre-transform hits: a -h fraction of the pixels (of the runs, for -d runs) is
+//    replaced by one of the -s search colours; that count is exact
+//  - post-transform hits: transformed pixels are greys, so grey search entries are
+//    chosen from the histogram of transformed values until they cover a -H fraction
+//    of the pixels. The histogram is of Method A (lines of 1000, padding included),
+//    so the rate is exact for a_seq and within a few pixels per line start for b_seq.
+//
+// Generation runs in blocks of GEN_BLOCK_LINES Method A lines, each with its own
+// random stream; every thread generates, transforms (for the histogram) and pwrites
+// its blocks, so a multi-GB input costs one parallel pass.
+//
+// Usage: ab_gen [-n pixels] [-d dist] [-s colours] [-h pre_rate] [-H post_rate]
+//               [-r run_length] [-S seed] input.raw search.raw
+//   -n  pixels, k/M/G suffixes allowed (default 1M); the file is 12 bytes per pixel
+//   -d  uniform, clustered, runs or grey (default uniform)
+//   -s  search colours for pre-transform hits (default 48; greys are added to these)
+//   -h  fraction of pixels matching a search colour before the transform (default 0.01)
+//   -H  fraction of pixels matching a search entry after the transform (default 0.01)
+//   -r  mean run length for -d runs (default 64)
+//   -S  seed (default 1)
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+#include "rawimage.h"
+#include "rawio.h"
+#include "searchindex.h"
+#include "transform.h"
+
+#define GEN_LINESIZE 1000       // Method A line length
+#define GEN_BLOCK_LINES 64      // lines per generation block (one random stream each)
+#define GEN_CLUSTERS 16
+#define GEN_SPREAD 12
+#define GEN_GREY_JITTER 4
+#define GEN_LEVELS 256
+
+enum Distribution { DIST_UNIFORM, DIST_CLUSTERED, DIST_RUNS, DIST_GREY };
+static const char *const DistributionNames[] = { "uniform", "clustered", "runs", "grey" };
+
+// Generation settings shared by every block
+struct Gen {
+    unsigned long pixels;
+    enum Distribution dist;
+    unsigned long runlength;
+    unsigned long long seed;
+    unsigned long prethreshold;         // planted pixel if Rand() < this (31-bit scale)
+    struct Pixel *colours;              // the -s search colours
+    unsigned long ncolours;
+    struct SearchIndex colourindex;     // background pixels must miss these
+    struct Pixel centres[GEN_CLUSTERS];
+};
+
+// Deterministic pseudo-random stream (the output must not depend on rand())
+struct Rng {
+    unsigned long long state;
+};
+
+static unsigned int Rand(struct Rng *r)
+{
+    r->state = r->state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return (unsigned int)(r->state >> 33);
+}
+
+// Independent stream n of a seed (splitmix64 finaliser)
+static void RngSeed(struct Rng *r, unsigned long long seed, unsigned long long n)
+{
+    unsigned long long z = seed + (n + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    r->state = z ^ (z >> 31);
+}
+
+static int Clamp(int v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+// Uniform offset in [-spread, spread]
+static int Jitter(struct Rng *r, int spread)
+{
+    return (int)(Rand(r) % (unsigned int)(2 * spread + 1)) - spread;
+}
+
+// Draw one background pixel of the distribution (runs draw uniform run colours)
+static void Background(const struct Gen *g, struct Rng *r, struct Pixel *px)
+{
+    do
+    {
+        switch (g->dist)
+        {
+            case DIST_CLUSTERED:
+            {
+                const struct Pixel *c = &(g->centres[Rand(r) % GEN_CLUSTERS]);
+                px->red = Clamp(c->red + Jitter(r, GEN_SPREAD));
+                px->green = Clamp(c->green + Jitter(r, GEN_SPREAD));
+                px->blue = Clamp(c->blue + Jitter(r, GEN_SPREAD));
+                break;
+            }
+            case DIST_GREY:
+            {
+                int v = (int)(Rand(r) & 255);
+                px->red = Clamp(v + Jitter(r, GEN_GREY_JITTER));
+                px->green = Clamp(v + Jitter(r, GEN_GREY_JITTER));
+                px->blue = Clamp(v + Jitter(r, GEN_GREY_JITTER));
+                break;
+            }
+            default:
+                px->red = (int)(Rand(r) & 255);
+                px->green = (int)(Rand(r) & 255);
+                px->blue = (int)(Rand(r) & 255);
+        }
+    } while ((px->red == px->green && px->green == px->blue) ||
+             SearchIndexFind(&(g->colourindex), px->red, px->green, px->blue) >= 0);
+}
+
+// A background pixel, or (with probability -h) one of the search colours
+// returns 1 for a planted search colour
+static int Draw(const struct Gen *g, struct Rng *r, struct Pixel *px)
+{
+    if (g->ncolours > 0 && Rand(r) < g->prethreshold)
+    {
+        *px = g->colours[Rand(r) % g->ncolours];
+        return 1;
+    }
+    Background(g, r, px);
+    return 0;
+}
+
+// Generate pixels [first, first + n) of the input (block number block)
+// returns the number of planted search colours
+static unsigned long GenBlock(const struct Gen *g, unsigned long block, struct Pixel *px, unsigned long n)
+{
+    struct Rng r;
+    RngSeed(&r, g->seed, block);
+    unsigned long planted = 0;
+
+    if (g->dist != DIST_RUNS)
+    {
+        for (unsigned long p=0; p<n; ++p)
+            planted += (unsigned long)Draw(g, &r, &(px[p]));
+        return planted;
+    }
+
+    // runs restart at each block, so blocks stay independent
+    unsigned long p = 0;
+    while (p < n)
+    {
+        unsigned long len = 1 + Rand(&r) % (2 * g->runlength - 1);
+        if (len > n - p) len = n - p;
+        struct Pixel c;
+        if (Draw(g, &r, &c)) planted += len;
+        for (unsigned long k=0; k<len; ++k) px[p + k] = c;
+        p += len;
+    }
+    return planted;
+}
+
+// A uniform colour that is not an exact grey
+static void RandomColour(struct Rng *r, struct Pixel *c)
+{
+    do
+    {
+        c->red = (int)(Rand(r) & 255);
+        c->green = (int)(Rand(r) & 255);
+        c->blue = (int)(Rand(r) & 255);
+    } while (c->red == c->green && c->green == c->blue);
+}
+
+// Pick distinct, non-grey search colours
+static void MakeColours(struct Gen *g, struct Rng *r)
+{
+    g->colours = (struct Pixel*)malloc((g->ncolours + 1) * sizeof(struct Pixel));
+    if (g->colours == NULL) FatalError("malloc failed for search colours");
+    struct Pixel *lines[1] = { g->colours };
+    struct Image img = { g->ncolours, 1, g->ncolours, lines };
+
+    for (unsigned long i=0; i<g->ncolours; ++i)
+        RandomColour(r, &(g->colours[i]));
+
+    // redraw any duplicates until every colour has its own slot
+    for (;;)
+    {
+        SearchIndexBuild(&(g->colourindex), &img);
+        if (g->colourindex.slots == g->ncolours) break;
+        unsigned long next = 0;
+        for (unsigned long i=0; i<g->ncolours; ++i)
+        {
+            if (g->colourindex.slot_of[i] == next) { ++next; continue; }
+            RandomColour(r, &(g->colours[i])); // a repeat of an earlier colour
+        }
+        SearchIndexFree(&(g->colourindex));
+    }
+}
+
+// Choose grey levels whose transformed-pixel counts add up to about target
+// (largest first while they fit, then the single level that gets closest)
+// hist - Method A transformed pixels per grey level
+// skip - a level that must not be chosen (-1 for none)
+// chosen - output, 1 per chosen level
+// returns the pixels covered
+static unsigned long ChooseGreys(const unsigned long *hist, unsigned long target, int skip, int *chosen)
+{
+    int order[GEN_LEVELS];
+    for (int v=0; v<GEN_LEVELS; ++v) order[v] = v;
+    for (int i=1; i<GEN_LEVELS; ++i) // insertion sort, count descending then level
+    {
+        int v = order[i], j = i - 1;
+        while (j >= 0 && hist[order[j]] < hist[v]) { order[j + 1] = order[j]; --j; }
+        order[j + 1] = v;
+    }
+
+    unsigned long sum = 0;
+    memset(chosen, 0, GEN_LEVELS * sizeof(int));
+    for (int i=0; i<GEN_LEVELS; ++i)
+    {
+        int v = order[i];
+        if (v == skip || hist[v] == 0) continue;
+        if (sum + hist[v] <= target) { chosen[v] = 1; sum += hist[v]; }
+    }
+
+    // every level left over is larger than target - sum, so sum + hist[v] > target
+    int best = -1;
+    unsigned long bestgap = target - sum;
+    for (int v=0; v<GEN_LEVELS; ++v)
+    {
+        if (chosen[v] || v == skip || hist[v] == 0) continue;
+        unsigned long gap = sum + hist[v] - target;
+        if (gap < bestgap) { best = v; bestgap = gap; }
+    }
+    if (best >= 0) { chosen[best] = 1; sum += hist[best]; }
+    return sum;
+}
+
+// Parse a pixel count with an optional k/M/G (decimal) suffix
+static unsigned long ParseCount(const char *s)
+{
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    if (end == s) FatalError("Pixel count must be a number (k/M/G suffix allowed)");
+    if (*end == 'k' || *end == 'K') { v *= 1000UL; ++end; }
+    else if (*end == 'M') { v *= 1000000UL; ++end; }
+    else if (*end == 'G') { v *= 1000000000UL; ++end; }
+    if (*end != '\0') FatalError("Pixel count must be a number (k/M/G suffix allowed)");
+    return v;
+}
+
+static double ParseRate(const char *s)
+{
+    char *end;
+    double v = strtod(s, &end);
+    if (end == s || *end != '\0' || v < 0.0 || v > 1.0)
+        FatalError("Hit rates must be between 0 and 1");
+    return v;
+}
+
+int main(int ac, char **av)
+{
+    struct Gen g;
+    memset(&g, 0, sizeof(g));
+    g.pixels = 1000000;
+    g.dist = DIST_UNIFORM;
+    g.runlength = 64;
+    g.seed = 1;
+    g.ncolours = 48;
+    double prerate = 0.01, postrate = 0.01;
+
+    int opt;
+    while ((opt = getopt(ac, av, "n:d:s:h:H:r:S:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': g.pixels = ParseCount(optarg); break;
+            case 'd':
+            {
+                int d = 0;
+                while (d <= DIST_GREY && strcmp(optarg, DistributionNames[d]) != 0) ++d;
+                if (d > DIST_GREY) FatalError("Distribution must be uniform, clustered, runs or grey");
+                g.dist = (enum Distribution)d;
+                break;
+            }
+            case 's': g.ncolours = strtoul(optarg, NULL, 10); break;
+            case 'h': prerate = ParseRate(optarg); break;
+            case 'H': postrate = ParseRate(optarg); break;
+            case 'r': g.runlength = strtoul(optarg, NULL, 10); break;
+            case 'S': g.seed = strtoull(optarg, NULL, 10); break;
+            default:
+                FatalError("Usage: ab_gen [-n pixels] [-d dist] [-s colours] [-h pre_rate] [-H post_rate] [-r run_length] [-S seed] input.raw search.raw");
+        }
+    }
+    if (ac - optind < 2)
+        FatalError("Usage: ab_gen [-n pixels] [-d dist] [-s colours] [-h pre_rate] [-H post_rate] [-r run_length] [-S seed] input.raw search.raw");
+    const char *infilename = av[optind];
+    const char *searchfilename = av[optind + 1];
+    if (g.pixels == 0 || g.runlength == 0) FatalError("Need at least 1 pixel and a run length of at least 1");
+    if (prerate > 0.0 && g.ncolours == 0) FatalError("A pre-transform hit rate needs search colours (-s)");
+    g.prethreshold = (unsigned long)(prerate * 2147483648.0);
+
+    double t0 = omp_get_wtime();
+    struct Rng r;
+    RngSeed(&r, g.seed, ~0ULL); // stream for the search colours and cluster centres
+    MakeColours(&g, &r);
+    for (int c=0; c<GEN_CLUSTERS; ++c)
+    {
+        g.centres[c].red = (int)(Rand(&r) & 255);
+        g.centres[c].green = (int)(Rand(&r) & 255);
+        g.centres[c].blue = (int)(Rand(&r) & 255);
+    }
+
+    int fd = open(infilename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) FatalError("Cannot open file for writing");
+    if (ftruncate(fd, (off_t)(g.pixels * sizeof(struct Pixel))) != 0) FatalError("Cannot size the input file");
+
+    const unsigned long blockpixels = (unsigned long)GEN_BLOCK_LINES * GEN_LINESIZE;
+    const unsigned long blocks = (g.pixels + blockpixels - 1) / blockpixels;
+    unsigned long hist[GEN_LEVELS] = {0};
+    unsigned long planted = 0;
+    int failed = 0;
+
+    printf("Generating %lu pixels (%s, seed %llu) with %d threads\n",
+           g.pixels, DistributionNames[g.dist], g.seed, omp_get_max_threads());
+
+    #pragma omp parallel default(none) shared(g, fd, blocks, failed) firstprivate(blockpixels) reduction(+:hist[:GEN_LEVELS], planted)
+    {
+        struct Pixel *px = (struct Pixel*)malloc(blockpixels * sizeof(struct Pixel));
+        struct Pixel *line = (struct Pixel*)malloc(GEN_LINESIZE * sizeof(struct Pixel));
+        if (px == NULL || line == NULL)
+        {
+            #pragma omp atomic write
+            failed = 1;
+        }
+
+        #pragma omp for schedule(dynamic, 1)
+        for (unsigned long b=0; b<blocks; ++b)
+        {
+            if (px == NULL || line == NULL) continue;
+            unsigned long first = b * blockpixels;
+            unsigned long n = (first + blockpixels <= g.pixels) ? blockpixels : g.pixels - first;
+            planted += GenBlock(&g, b, px, n);
+            if (PwriteAll(fd, px, n * sizeof(struct Pixel), (off_t)(first * sizeof(struct Pixel))) != 0)
+            {
+                #pragma omp atomic write
+                failed = 1;
+            }
+
+            // transform each Method A line (the last one zero padded as LoadFile does)
+            for (unsigned long l=0; l<n; l+=GEN_LINESIZE)
+            {
+                unsigned long len = (n - l < GEN_LINESIZE) ? n - l : GEN_LINESIZE;
+                memcpy(line, &(px[l]), len * sizeof(struct Pixel));
+                memset(&(line[len]), 0, (GEN_LINESIZE - len) * sizeof(struct Pixel));
+                TransformRange(line, 0, GEN_LINESIZE, NULL, NULL);
+                for (unsigned long p=0; p<GEN_LINESIZE; ++p)
+                    hist[line[p].red]++;
+            }
+        }
+        free(px);
+        free(line);
+    }
+    if (failed) FatalError("Cannot generate or write the input file");
+    if (close(fd) != 0) FatalError("Cannot write the input file");
+    double t1 = omp_get_wtime();
+
+    // padding pixels are (0,0,0) originals: a grey 0 entry would also match them
+    // before the transform, so it is left out when there is padding
+    int chosen[GEN_LEVELS];
+    unsigned long target = (unsigned long)(postrate * (double)g.pixels + 0.5);
+    unsigned long post = ChooseGreys(hist, target, (g.pixels % GEN_LINESIZE) ? 0 : -1, chosen);
+
+    unsigned long ngreys = 0;
+    for (int v=0; v<GEN_LEVELS; ++v) ngreys += (unsigned long)chosen[v];
+
+    unsigned long nsearch = g.ncolours + ngreys;
+    struct Pixel *entries = (struct Pixel*)malloc((nsearch + 1) * sizeof(struct Pixel));
+    if (entries == NULL) FatalError("malloc failed for search entries");
+    memcpy(entries, g.colours, g.ncolours * sizeof(struct Pixel));
+    unsigned long s = g.ncolours;
+    for (int v=0; v<GEN_LEVELS; ++v)
+        if (chosen[v])
+        {
+            entries[s].red = entries[s].green = entries[s].blue = v;
+            ++s;
+        }
+    struct Pixel *lines[1] = { entries };
+    struct Image search = { nsearch, 1, nsearch, lines };
+    WriteFile(searchfilename, &search);
+
+    printf("Wrote %s (%lu bytes) and %s (%lu colours + %lu greys)\n",
+           infilename, g.pixels * (unsigned long)sizeof(struct Pixel), searchfilename, g.ncolours, ngreys);
+    printf("GEN pixels=%lu dist=%s seed=%llu search=%lu pre_hits=%lu pre_rate=%.4f post_hits_a=%lu post_rate_a=%.4f gen_ms=%.1f mb_per_s=%.1f\n",
+           g.pixels, DistributionNames[g.dist], g.seed, nsearch,
+           planted, (double)planted / (double)g.pixels, post, (double)post / (double)g.pixels,
+           (t1 - t0) * 1e3, (double)g.pixels * sizeof(struct Pixel) / ((t1 - t0) * 1e6));
+
+    free(entries);
+    SearchIndexFree(&(g.colourindex));
+    free(g.colours);
+    return 0;
+}
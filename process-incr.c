@@ -0,0 +1,503 @@
+// process-incr.c
+// Resumable / incremental Process A and Process B.
+//
+// Process B is one bleed chain, so the whole continuation state after pixel N is
+// the last 10 transformed pixels plus the counters. Process A lines are independent,
+// so its state is a content hash and the search hits of every line.
+//
+// Both keep that state in a state file, written to a temporary name and renamed
+// after the output data it describes has been flushed, so a run killed at any point
+// can be resumed from its last checkpoint:
+//  - Method B streams the input in chunks (never loading it whole) and checkpoints
+//    (offset, window, counters) every N pixels. Resume/append continue from the
+//    saved offset; a hash of the 4096 input pixels just before that offset must
+//    still match (a cheap guard - earlier edits need a fresh run).
+//  - Method A hashes each input line and only transforms lines that are new or whose
+//    content changed since the state was written (rows in parallel); the counts of
+//    a changed line are replaced, not added. Resume and append are the same pass.
+//
+// Usage: ab_incr [-r|-p] [-e every] [-l limit] a|b in_filename out_filename search_filename state_filename
+//   -r  resume an interrupted run from state_filename
+//   -p  append: the state is from a completed run and the input has grown
+//   -e  checkpoint every N pixels (B, default 16777216) or N lines (A, default 16384)
+//   -l  stop after processing N pixels (B) or N lines (A) in this run (time slicing)
+// Without -r / -p the run starts from pixel 0 and the output is recreated.
+// Once the whole input has been processed the output file and the "** (r,g,b) = n"
+// lines of the Search Results block match a_seq / b_seq; the rest of standard output
+// is ab_incr's own progress ("Processed N of M pixels", "Incomplete: resume with -r").
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "rawimage.h"
+#include "searchindex.h"
+#include "transform.h"
+#include "resultcache.h"
+#include "rawio.h"
+#include "searchresults.h"
+
+#define STATE_MAGIC "RAWSTATE"
+#define STATE_VERSION 1
+#define CHUNK_PIXELS (1UL << 20)
+#define TAIL_PIXELS 4096
+#define A_LINESIZE 1000
+
+// State file header (Method B: followed by window[BLEED_WINDOW] and counts[searchlength];
+// Method A: followed by one StateLine per line, each followed by its hit pairs)
+struct StateHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int method;            // 'A' or 'B'
+    unsigned long long searchhash;
+    unsigned long long searchlength;
+    unsigned long long offset;      // B: pixels processed; A: number of lines recorded
+    unsigned long long tailhash;    // B: hash of the input pixels just before offset
+    unsigned int complete;          // input fully processed when written
+    unsigned int pad;
+};
+
+// Method A per-line record
+struct StateLine {
+    unsigned long long hash;        // hash of the input line (0 with valid == 0)
+    unsigned int valid;             // output line written and hits recorded
+    unsigned int nhits;             // number of (slot, count) pairs
+};
+
+// Per-line hits for Method A (sparse: lines hit few distinct colours)
+struct LineHits {
+    struct StateLine rec;
+    unsigned int *pairs;            // nhits * (slot, count)
+};
+
+// Hash of up to TAIL_PIXELS input pixels ending at offset (guards resume/append
+// against the already-processed part of the input having changed)
+static unsigned long long TailHash(int infd, unsigned long offset)
+{
+    unsigned long start = offset > TAIL_PIXELS ? offset - TAIL_PIXELS : 0;
+    size_t bytes = (offset - start) * sizeof(struct Pixel);
+    unsigned char *buf = (unsigned char*)malloc(bytes ? bytes : 1);
+    if (buf == NULL) FatalError("Cannot allocate memory for tail hash");
+    if (bytes && PreadAll(infd, buf, bytes, (off_t)(start * sizeof(struct Pixel))) != 0)
+        FatalError("Cannot read input for tail hash");
+    unsigned long long h = HashBlock(buf, bytes, offset);
+    free(buf);
+    return h;
+}
+
+// Open the temporary state file; commit with CommitState
+static int BeginState(const char *statename, char *tmp, size_t size)
+{
+    snprintf(tmp, size, "%s.tmp", statename);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) FatalError("Cannot open state file for writing");
+    return fd;
+}
+
+static void CommitState(int fd, const char *tmp, const char *statename)
+{
+    if (fsync(fd) != 0 || close(fd) != 0 || rename(tmp, statename) != 0)
+        FatalError("Cannot write state file");
+}
+
+// Method B checkpoint: the output up to offset must already be flushed
+static void SaveStateB(const char *statename, struct StateHeader *h, const struct Pixel *window,
+                       const unsigned long *counter)
+{
+    char tmp[4200];
+    int fd = BeginState(statename, tmp, sizeof(tmp));
+    int rc = WriteAllFd(fd, h, sizeof(*h));
+    if (rc == 0) rc = WriteAllFd(fd, window, BLEED_WINDOW * sizeof(struct Pixel));
+    for (unsigned long i=0; i<h->searchlength && rc == 0; ++i)
+    {
+        unsigned long long c = counter[i];
+        rc = WriteAllFd(fd, &c, sizeof(c));
+    }
+    if (rc != 0) FatalError("Cannot write state file");
+    CommitState(fd, tmp, statename);
+}
+
+// Method A checkpoint: lines marked valid must already be flushed to the output
+static void SaveStateA(const char *statename, struct StateHeader *h, const struct LineHits *lines)
+{
+    char tmp[4200];
+    int fd = BeginState(statename, tmp, sizeof(tmp));
+    int rc = WriteAllFd(fd, h, sizeof(*h));
+    for (unsigned long l=0; l<h->offset && rc == 0; ++l)
+    {
+        rc = WriteAllFd(fd, &lines[l].rec, sizeof(struct StateLine));
+        if (rc == 0 && lines[l].rec.nhits)
+            rc = WriteAllFd(fd, lines[l].pairs, lines[l].rec.nhits * 2 * sizeof(unsigned int));
+    }
+    if (rc != 0) FatalError("Cannot write state file");
+    CommitState(fd, tmp, statename);
+}
+
+// Read a state file header, checking it belongs to this method and search set
+static int OpenState(const char *statename, struct StateHeader *h, unsigned int method,
+                     unsigned long long searchhash, unsigned long searchlength)
+{
+    int fd = open(statename, O_RDONLY);
+    if (fd < 0) FatalError("Cannot open state file for reading");
+    if (ReadAllFd(fd, h, sizeof(*h)) != 0 || memcmp(h->magic, STATE_MAGIC, 8) != 0 || h->version != STATE_VERSION)
+        FatalError("State file is not a valid ab_incr state");
+    if (h->method != method)
+        FatalError("State file was written for the other method");
+    if (h->searchhash != searchhash || h->searchlength != searchlength)
+        FatalError("State file was written for a different search file");
+    return fd;
+}
+
+// Print the standard results block
+static void PrintResults(struct Image *search, const unsigned long *counter)
+{
+    printf("Search Results:\n");
+    PrintSearchResults(search, counter);
+}
+
+static int RunB(int mode, unsigned long every, unsigned long limit, const char *infilename,
+                const char *outfilename, struct Image *search, struct SearchIndex *index,
+                unsigned long long searchhash, const char *statename)
+{
+    int infd = open(infilename, O_RDONLY);
+    if (infd < 0) FatalError("Cannot open file for reading");
+    struct stat st;
+    fstat(infd, &st);
+    unsigned long length = (unsigned long)st.st_size / sizeof(struct Pixel);
+
+    struct StateHeader h;
+    struct Pixel window[BLEED_WINDOW];
+    unsigned long *counter = (unsigned long*)calloc(search->length ? search->length : 1, sizeof(unsigned long));
+    unsigned long *hits = SearchIndexCounters(index);
+    if (counter == NULL) FatalError("malloc failed for counter");
+    memset(window, 0, sizeof(window));
+
+    if (mode != 0)
+    {
+        int sfd = OpenState(statename, &h, 'B', searchhash, search->length);
+        if (ReadAllFd(sfd, window, sizeof(window)) != 0) FatalError("State file is truncated");
+        for (unsigned long i=0; i<search->length; ++i)
+        {
+            unsigned long long c;
+            if (ReadAllFd(sfd, &c, sizeof(c)) != 0) FatalError("State file is truncated");
+            counter[i] = (unsigned long)c;
+            hits[index->slot_of[i]] = (unsigned long)c; // duplicates share a slot and a count
+        }
+        close(sfd);
+        if (mode == 'p' && !h.complete)
+            FatalError("State file is from an interrupted run; use -r to resume it");
+        if (h.offset > length)
+            FatalError("Input is shorter than the state file's offset");
+        if (TailHash(infd, (unsigned long)h.offset) != h.tailhash)
+            FatalError("Input content before the state file's offset has changed");
+    }
+    else
+    {
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, STATE_MAGIC, 8);
+        h.version = STATE_VERSION;
+        h.method = 'B';
+        h.searchhash = searchhash;
+        h.searchlength = search->length;
+    }
+
+    int outfd = open(outfilename, O_WRONLY | O_CREAT | (mode == 0 ? O_TRUNC : 0), 0644);
+    if (outfd < 0) FatalError("Cannot open file for writing");
+
+    unsigned long offset = (unsigned long)h.offset;
+    unsigned long stop = length;
+    if (limit && offset + limit < stop) stop = offset + limit;
+    fprintf(stderr, "[incr] B: %lu of %lu pixels done, processing to %lu\n", offset, length, stop);
+
+    struct Pixel *buf = (struct Pixel*)malloc((CHUNK_PIXELS + BLEED_WINDOW) * sizeof(struct Pixel));
+    if (buf == NULL) FatalError("Cannot allocate memory for input chunk");
+
+    unsigned long lastsave = offset;
+    while (offset < stop)
+    {
+        unsigned long n = (stop - offset < CHUNK_PIXELS) ? stop - offset : CHUNK_PIXELS;
+        unsigned long w = (offset < BLEED_WINDOW) ? offset : BLEED_WINDOW;
+        memcpy(buf, window + (BLEED_WINDOW - w), w * sizeof(struct Pixel));
+        if (PreadAll(infd, buf + w, n * sizeof(struct Pixel), (off_t)(offset * sizeof(struct Pixel))) != 0)
+            FatalError("Cannot read input");
+
+        // buffer position == input position while offset < 10, and >= 10 after, so the
+        // bleed divisor is unchanged
+        TransformRange(buf, w, w + n, index, hits);
+
+        if (PwriteAll(outfd, buf + w, n * sizeof(struct Pixel), (off_t)(offset * sizeof(struct Pixel))) != 0)
+            FatalError("Cannot write output");
+        offset += n;
+
+        unsigned long keep = (w + n < BLEED_WINDOW) ? w + n : BLEED_WINDOW;
+        memset(window, 0, sizeof(window));
+        memcpy(window + (BLEED_WINDOW - keep), buf + w + n - keep, keep * sizeof(struct Pixel));
+
+        if (offset - lastsave >= every || offset == stop)
+        {
+            if (fdatasync(outfd) != 0) FatalError("Cannot flush output");
+            SearchIndexExpand(index, hits, counter);
+            h.offset = offset;
+            h.tailhash = TailHash(infd, offset);
+            h.complete = (offset == length);
+            SaveStateB(statename, &h, window, counter);
+            lastsave = offset;
+            fprintf(stderr, "[incr] B: checkpoint at %lu pixels\n", offset);
+        }
+    }
+    SearchIndexExpand(index, hits, counter);
+    if (ftruncate(outfd, (off_t)(offset * sizeof(struct Pixel))) != 0) FatalError("Cannot write output");
+    close(outfd);
+    close(infd);
+    free(buf);
+
+    printf("Processed %lu of %lu pixels\n", offset, length);
+    if (offset == length)
+    {
+        printf("Saving file %s\n", outfilename);
+        PrintResults(search, counter);
+    }
+    else
+        printf("Incomplete: resume with -r\n");
+
+    free(hits);
+    free(counter);
+    return 0;
+}
+
+static int RunA(int mode, unsigned long every, unsigned long limit, const char *infilename,
+                const char *outfilename, struct Image *search, struct SearchIndex *index,
+                unsigned long long searchhash, const char *statename)
+{
+    int infd = open(infilename, O_RDONLY);
+    if (infd < 0) FatalError("Cannot open file for reading");
+    struct stat st;
+    fstat(infd, &st);
+    unsigned long length = (unsigned long)st.st_size / sizeof(struct Pixel);
+    unsigned long nlines = (length + A_LINESIZE - 1) / A_LINESIZE;
+
+    struct StateHeader h;
+    struct LineHits *lines = (struct LineHits*)calloc(nlines ? nlines : 1, sizeof(struct LineHits));
+    if (lines == NULL) FatalError("Cannot allocate memory for line state");
+
+    if (mode != 0)
+    {
+        int sfd = OpenState(statename, &h, 'A', searchhash, search->length);
+        if (mode == 'p' && !h.complete)
+            FatalError("State file is from an interrupted run; use -r to resume it");
+        for (unsigned long l=0; l<h.offset; ++l)
+        {
+            struct LineHits tmp;
+            if (ReadAllFd(sfd, &tmp.rec, sizeof(tmp.rec)) != 0) FatalError("State file is truncated");
+            tmp.pairs = NULL;
+            if (tmp.rec.nhits)
+            {
+                tmp.pairs = (unsigned int*)malloc(tmp.rec.nhits * 2 * sizeof(unsigned int));
+                if (tmp.pairs == NULL) FatalError("Cannot allocate memory for line state");
+                if (ReadAllFd(sfd, tmp.pairs, tmp.rec.nhits * 2 * sizeof(unsigned int)) != 0)
+                    FatalError("State file is truncated");
+            }
+            if (l < nlines) lines[l] = tmp;  // lines beyond a shrunk input are dropped
+            else free(tmp.pairs);
+        }
+        close(sfd);
+    }
+    else
+    {
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, STATE_MAGIC, 8);
+        h.version = STATE_VERSION;
+        h.method = 'A';
+        h.searchhash = searchhash;
+        h.searchlength = search->length;
+    }
+    h.offset = nlines;
+
+    int outfd = open(outfilename, O_WRONLY | O_CREAT | (mode == 0 ? O_TRUNC : 0), 0644);
+    if (outfd < 0) FatalError("Cannot open file for writing");
+    size_t linebytes = A_LINESIZE * sizeof(struct Pixel);
+    if (ftruncate(outfd, (off_t)(nlines * linebytes)) != 0) FatalError("Cannot write output");
+
+    // Pass 1: hash every line (in parallel) to find the new / changed ones
+    unsigned long long *linehash = (unsigned long long*)malloc((nlines ? nlines : 1) * sizeof(unsigned long long));
+    unsigned long *todo = (unsigned long*)malloc((nlines ? nlines : 1) * sizeof(unsigned long));
+    if (linehash == NULL || todo == NULL) FatalError("Cannot allocate memory for line hashes");
+
+    #pragma omp parallel default(none) shared(infd, linehash, nlines, length, linebytes)
+    {
+        struct Pixel *line = (struct Pixel*)malloc(linebytes);
+        if (line == NULL) FatalError("Cannot allocate memory for a line");
+        #pragma omp for schedule(static)
+        for (unsigned long l=0; l<nlines; ++l)
+        {
+            if (ReadLineAt(infd, length, A_LINESIZE, l, line) != 0)
+                FatalError("Cannot read input");
+            linehash[l] = HashBlock((const unsigned char*)line, linebytes, 0x4C494E45ULL) | 1; // never 0
+        }
+        free(line);
+    }
+
+    unsigned long ntodo = 0;
+    for (unsigned long l=0; l<nlines; ++l)
+        if (!lines[l].rec.valid || lines[l].rec.hash != linehash[l])
+            todo[ntodo++] = l;
+    fprintf(stderr, "[incr] A: %lu lines, %lu new or changed\n", nlines, ntodo);
+    if (limit && ntodo > limit) ntodo = limit;
+
+    // Pass 2: transform those lines in checkpointed batches
+    for (unsigned long b=0; b<ntodo; b+=every)
+    {
+        unsigned long e = (b + every < ntodo) ? b + every : ntodo;
+
+        #pragma omp parallel default(none) shared(b, e, todo, lines, linehash, infd, outfd, index, length, linebytes)
+        {
+            unsigned long *dense = SearchIndexCounters(index);
+            struct Pixel *line = (struct Pixel*)malloc(linebytes);
+            long *touched = (long*)malloc(2 * A_LINESIZE * sizeof(long));
+            unsigned int *pairs = (unsigned int*)malloc(2 * 2 * A_LINESIZE * sizeof(unsigned int));
+            if (line == NULL || touched == NULL || pairs == NULL) FatalError("Cannot allocate memory for a line");
+
+            #pragma omp for schedule(dynamic,16)
+            for (unsigned long t=b; t<e; ++t)
+            {
+                unsigned long l = todo[t];
+                if (ReadLineAt(infd, length, A_LINESIZE, l, line) != 0)
+                    FatalError("Cannot read input");
+
+                // remember the slots this line can hit (original and transformed values)
+                for (unsigned long p=0; p<A_LINESIZE; ++p)
+                    touched[p] = SearchIndexFind(index, line[p].red, line[p].green, line[p].blue);
+                TransformRange(line, 0, A_LINESIZE, index, dense);
+                for (unsigned long p=0; p<A_LINESIZE; ++p)
+                    touched[A_LINESIZE + p] = SearchIndexFind(index, line[p].red, line[p].green, line[p].blue);
+
+                if (PwriteAll(outfd, line, linebytes, (off_t)(l * linebytes)) != 0)
+                    FatalError("Cannot write output");
+
+                // move this line's hits from the dense counters into a sparse list
+                unsigned int k = 0;
+                for (unsigned long t2=0; t2<2 * A_LINESIZE; ++t2)
+                {
+                    long s = touched[t2];
+                    if (s < 0 || dense[s] == 0) continue;
+                    pairs[2*k] = (unsigned int)s;
+                    pairs[2*k+1] = (unsigned int)dense[s];
+                    dense[s] = 0;
+                    ++k;
+                }
+                free(lines[l].pairs);
+                lines[l].pairs = NULL;
+                if (k)
+                {
+                    lines[l].pairs = (unsigned int*)malloc(k * 2 * sizeof(unsigned int));
+                    if (lines[l].pairs == NULL) FatalError("Cannot allocate memory for line state");
+                    memcpy(lines[l].pairs, pairs, k * 2 * sizeof(unsigned int));
+                }
+                lines[l].rec.nhits = k;
+                lines[l].rec.hash = linehash[l];
+                lines[l].rec.valid = 1;
+            }
+            free(pairs);
+            free(touched);
+            free(line);
+            free(dense);
+        }
+
+        if (fdatasync(outfd) != 0) FatalError("Cannot flush output");
+        h.complete = 0;
+        SaveStateA(statename, &h, lines);
+        fprintf(stderr, "[incr] A: checkpoint after %lu of %lu lines\n", e, ntodo);
+    }
+
+    // Lines still invalid (limit reached) mean the run is incomplete
+    unsigned long pending = 0;
+    for (unsigned long l=0; l<nlines; ++l)
+        if (!lines[l].rec.valid || lines[l].rec.hash != linehash[l]) ++pending;
+    h.complete = (pending == 0);
+    SaveStateA(statename, &h, lines);
+    close(outfd);
+    close(infd);
+
+    printf("Processed %lu lines, %lu still pending\n", ntodo, pending);
+    if (pending == 0)
+    {
+        unsigned long *hits = SearchIndexCounters(index);
+        unsigned long *counter = (unsigned long*)malloc((search->length ? search->length : 1) * sizeof(unsigned long));
+        if (counter == NULL) FatalError("malloc failed for counter");
+        for (unsigned long l=0; l<nlines; ++l)
+            for (unsigned int k=0; k<lines[l].rec.nhits; ++k)
+                hits[lines[l].pairs[2*k]] += lines[l].pairs[2*k+1];
+        SearchIndexExpand(index, hits, counter);
+        printf("Saving file %s\n", outfilename);
+        PrintResults(search, counter);
+        free(counter);
+        free(hits);
+    }
+    else
+        printf("Incomplete: resume with -r\n");
+
+    for (unsigned long l=0; l<nlines; ++l)
+        free(lines[l].pairs);
+    free(lines);
+    free(linehash);
+    free(todo);
+    return 0;
+}
+
+int main(int ac, char **av)
+{
+    const char *usage = "Usage: ab_incr [-r|-p] [-e every] [-l limit] a|b in_filename out_filename search_filename state_filename";
+    int mode = 0;
+    unsigned long every = 0, limit = 0;
+    int opt;
+    while ((opt = getopt(ac, av, "rpe:l:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r': mode = 'r'; break;
+            case 'p': mode = 'p'; break;
+            case 'e': every = strtoul(optarg, NULL, 10); break;
+            case 'l': limit = strtoul(optarg, NULL, 10); break;
+            default: FatalError(usage);
+        }
+    }
+    if (ac - optind < 5)
+        FatalError(usage);
+
+    const char *method = av[optind];
+    const char *infilename = av[optind + 1];
+    const char *outfilename = av[optind + 2];
+    const char *searchfilename = av[optind + 3];
+    const char *statename = av[optind + 4];
+
+    int isa;
+    if (strcmp(method, "a") == 0 || strcmp(method, "A") == 0) isa = 1;
+    else if (strcmp(method, "b") == 0 || strcmp(method, "B") == 0) isa = 0;
+    else FatalError("Method must be a or b");
+    if (every == 0) every = isa ? 16384 : 16777216;
+
+    struct Image search;
+    printf("Loading file %s\n", searchfilename);
+    LoadFile(searchfilename, &search, 0);
+    printf("Found %lu search term pixels\n", search.length);
+
+    unsigned long long searchhash;
+    if (HashFile(searchfilename, 1, &searchhash, NULL) != 0) FatalError("Cannot open file for reading");
+    struct SearchIndex index;
+    SearchIndexBuild(&index, &search);
+
+    printf("Processing %s incrementally%s\n", infilename,
+        mode == 'r' ? " (resume)" : mode == 'p' ? " (append)" : "");
+    int rc = isa ? RunA(mode, every, limit, infilename, outfilename, &search, &index, searchhash, statename)
+                 : RunB(mode, every, limit, infilename, outfilename, &search, &index, searchhash, statename);
+
+    SearchIndexFree(&index);
+    FreeImage(&search);
+    return rc;
+}
@@ -0,0 +1,233 @@
+// process-loadgen.c
+// Local load generator for ab_daemon (process-daemon.c).
+//  - Each client thread holds one connection and sends requests back to back
+//  - Optionally passes the input as an open descriptor instead of a filename
+//  - Reports throughput, and latency percentiles over the completed requests
+//
+// Usage: ab_loadgen [-c clients] [-n requests_per_client] [-f] [-q]
+//                   socket_path a|b input_filename output_filename search_filename
+//   -f  pass the input descriptor with each request (SCM_RIGHTS)
+//   -q  do not print the first reply's Search Results block
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "rawimage.h"
+
+struct LoadClient {
+    pthread_t thread;
+    int id;
+    unsigned long requests;
+    double *latency;     // seconds per completed request
+    unsigned long completed; // requests answered OK (entries in latency)
+    unsigned long pixels; // pixels processed per request (from OK line)
+    unsigned long errors;
+};
+
+static const char *sockpath;
+static const char *method;
+static const char *infilename;
+static const char *outfilename;
+static const char *searchfilename;
+static int passfd = 0;
+static int quiet = 0;
+
+// Monotonic time in seconds
+static double Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int Connect(void)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sockpath, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) { close(fd); return -1; }
+    return fd;
+}
+
+// Send one request line, attaching infd if >= 0
+static int SendRequest(int fd, const char *line, size_t len, int infd)
+{
+    struct iovec iov = { (void*)line, len };
+    struct msghdr msg;
+    char ctrl[CMSG_SPACE(sizeof(int))];
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (infd >= 0)
+    {
+        memset(ctrl, 0, sizeof(ctrl));
+        msg.msg_control = ctrl;
+        msg.msg_controllen = sizeof(ctrl);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type = SCM_RIGHTS;
+        cm->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cm), &infd, sizeof(int));
+    }
+    ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (n != (ssize_t)len) return -1; // request lines are small; a short send is an error
+    return 0;
+}
+
+// Read one reply (up to and including the END line) into a growing buffer
+// returns the reply length or -1
+static long ReadReply(int fd, char **buf, size_t *cap)
+{
+    size_t used = 0;
+    for (;;)
+    {
+        if (used + 4096 > *cap)
+        {
+            *cap = *cap ? *cap * 2 : 65536;
+            *buf = (char*)realloc(*buf, *cap);
+            if (*buf == NULL) FatalError("Cannot allocate memory for reply");
+        }
+        ssize_t n = recv(fd, *buf + used, *cap - used - 1, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        used += (size_t)n;
+        (*buf)[used] = '\0';
+        if (used >= 4 && memcmp(*buf + used - 4, "END\n", 4) == 0 &&
+            (used == 4 || (*buf)[used - 5] == '\n'))
+            return (long)used;
+    }
+}
+
+static void *ClientMain(void *arg)
+{
+    struct LoadClient *c = (struct LoadClient*)arg;
+    char line[16384];
+    int len = snprintf(line, sizeof(line), "%s %s %s %s\n", method, passfd ? "-" : infilename, outfilename, searchfilename);
+    if (len <= 0 || (size_t)len >= sizeof(line)) FatalError("Request line too long");
+
+    int fd = Connect();
+    if (fd < 0)
+    {
+        c->errors = c->requests;
+        return NULL;
+    }
+
+    char *buf = NULL;
+    size_t cap = 0;
+    for (unsigned long r=0; r<c->requests; ++r)
+    {
+        int infd = -1;
+        if (passfd && (infd = open(infilename, O_RDONLY | O_CLOEXEC)) < 0)
+            FatalError("Cannot open file for reading");
+
+        double t0 = Now();
+        int rc = SendRequest(fd, line, (size_t)len, infd);
+        long n = (rc == 0) ? ReadReply(fd, &buf, &cap) : -1;
+        double elapsed = Now() - t0;
+        if (infd >= 0) close(infd);
+
+        if (n < 0) { c->errors += c->requests - r; break; }
+        if (strncmp(buf, "OK ", 3) != 0)
+        {
+            if (c->errors++ == 0) fprintf(stderr, "[loadgen] client %d: %.*s", c->id, (int)(strchr(buf, '\n') - buf + 1), buf);
+            continue;
+        }
+        c->latency[c->completed++] = elapsed;
+        c->pixels = strtoul(buf + 3, NULL, 10);
+        if (c->id == 0 && r == 0 && !quiet)
+            fputs(strchr(buf, '\n') + 1, stdout);
+    }
+    free(buf);
+    close(fd);
+    return NULL;
+}
+
+static int CompareDouble(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int main(int ac, char **av)
+{
+    unsigned long clients = 1, requests = 10;
+    int opt;
+    while ((opt = getopt(ac, av, "c:n:fq")) != -1)
+    {
+        switch (opt)
+        {
+            case 'c': clients = strtoul(optarg, NULL, 10); break;
+            case 'n': requests = strtoul(optarg, NULL, 10); break;
+            case 'f': passfd = 1; break;
+            case 'q': quiet = 1; break;
+            default: FatalError("Usage: ab_loadgen [-c clients] [-n requests] [-f] [-q] socket a|b input output search");
+        }
+    }
+    if (ac - optind < 5 || clients == 0 || requests == 0)
+        FatalError("Usage: ab_loadgen [-c clients] [-n requests] [-f] [-q] socket a|b input output search");
+
+    sockpath = av[optind];
+    method = av[optind + 1];
+    infilename = av[optind + 2];
+    outfilename = av[optind + 3];
+    searchfilename = av[optind + 4];
+
+    struct LoadClient *cl = (struct LoadClient*)calloc(clients, sizeof(struct LoadClient));
+    double *latency = (double*)calloc(clients * requests, sizeof(double));
+    if (cl == NULL || latency == NULL) FatalError("Cannot allocate memory for clients");
+
+    double t0 = Now();
+    for (unsigned long c=0; c<clients; ++c)
+    {
+        cl[c].id = (int)c;
+        cl[c].requests = requests;
+        cl[c].latency = latency + c * requests;
+        if (pthread_create(&cl[c].thread, NULL, ClientMain, &cl[c]) != 0)
+            FatalError("Cannot start client thread");
+    }
+    // Pack each client's completed latencies together; failed and unsent requests have none
+    unsigned long errors = 0, pixels = 0, done = 0;
+    for (unsigned long c=0; c<clients; ++c)
+    {
+        pthread_join(cl[c].thread, NULL);
+        errors += cl[c].errors;
+        if (cl[c].pixels) pixels = cl[c].pixels;
+        memmove(latency + done, cl[c].latency, cl[c].completed * sizeof(double));
+        done += cl[c].completed;
+    }
+    double secs = Now() - t0;
+
+    qsort(latency, done, sizeof(double), CompareDouble);
+    double sum = 0;
+    for (unsigned long i=0; i<done; ++i) sum += latency[i];
+
+    printf("Load: %lu clients x %lu requests (%s, input %s)\n", clients, requests, method, passfd ? "passed fd" : "by path");
+    printf("Completed %lu requests, %lu errors in %.3f s: %.1f req/s, %.2f Mpixel/s\n",
+        done, errors, secs, (double)done / secs,
+        (double)pixels * (double)done / secs / 1e6);
+    if (done > 0)
+        printf("Latency ms: mean %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+            sum / (double)done * 1e3,
+            latency[(done - 1) * 50 / 100] * 1e3,
+            latency[(done - 1) * 90 / 100] * 1e3,
+            latency[(done - 1) * 99 / 100] * 1e3,
+            latency[done - 1] * 1e3);
+    else
+        printf("Latency ms: no completed requests\n");
+
+    free(latency);
+    free(cl);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,215 @@
+// process-roi.c
+// Region-of-interest Process A: transform and search only selected lines.
+//
+// Process A lines are independent, so the requested lines are read in place with
+// pread (the rest of the input is never read) and processed rows in parallel.
+// Cost is proportional to the ROI, not to the file.
+//
+// Usage: ab_roi [-s] in_filename out_filename search_filename ranges
+//
+// ranges is a comma separated list of 0-based line numbers or inclusive ranges,
+// e.g. "0-99,500,2000-" (an open end runs to the last line). Overlaps are merged.
+// Output holds only the requested lines, in line order; with -s it is instead a
+// sparse file the size of a full a_seq output, with the requested lines in place
+// (unrequested lines read back as zero). Search counts cover the requested lines.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "rawimage.h"
+#include "searchindex.h"
+#include "transform.h"
+#include "rawio.h"
+#include "searchresults.h"
+
+#define A_LINESIZE 1000
+
+// One inclusive range of lines
+struct LineRange {
+    unsigned long first;
+    unsigned long last;
+};
+
+static int CompareRange(const void *a, const void *b)
+{
+    const struct LineRange *ra = (const struct LineRange*)a;
+    const struct LineRange *rb = (const struct LineRange*)b;
+    return (ra->first > rb->first) - (ra->first < rb->first);
+}
+
+// Parse a range list into a sorted list of distinct line numbers
+// spec - the ranges argument
+// nlines - lines in the input (ranges are clipped to it)
+// count - output, number of lines selected
+// nranges - output, number of ranges after merging
+static unsigned long *ParseRanges(const char *spec, unsigned long nlines, unsigned long *count, unsigned long *nranges)
+{
+    unsigned long cap = 16, n = 0;
+    struct LineRange *ranges = (struct LineRange*)malloc(cap * sizeof(struct LineRange));
+    if (ranges == NULL) FatalError("Cannot allocate memory for ranges");
+
+    const char *s = spec;
+    while (*s)
+    {
+        char *end;
+        struct LineRange r;
+        if (*s < '0' || *s > '9') FatalError("Ranges must look like 0-99,500,2000-");
+        r.first = strtoul(s, &end, 10);
+        r.last = r.first;
+        if (*end == '-')
+        {
+            s = end + 1;
+            if (*s == ',' || *s == '\0') { r.last = nlines ? nlines - 1 : ~0UL; end = (char*)s; }
+            else
+            {
+                if (*s < '0' || *s > '9') FatalError("Ranges must look like 0-99,500,2000-");
+                r.last = strtoul(s, &end, 10);
+            }
+        }
+        if (*end != ',' && *end != '\0') FatalError("Ranges must look like 0-99,500,2000-");
+        if (r.last < r.first) FatalError("Range end is before its start");
+        s = (*end == ',') ? end + 1 : end;
+
+        if (r.first >= nlines) continue;
+        if (r.last >= nlines) r.last = nlines - 1;
+        if (n == cap)
+        {
+            cap *= 2;
+            ranges = (struct LineRange*)realloc(ranges, cap * sizeof(struct LineRange));
+            if (ranges == NULL) FatalError("Cannot allocate memory for ranges");
+        }
+        ranges[n++] = r;
+    }
+
+    // merge overlapping / adjacent ranges
+    qsort(ranges, n, sizeof(struct LineRange), CompareRange);
+    unsigned long m = 0;
+    for (unsigned long i=0; i<n; ++i)
+    {
+        if (m > 0 && ranges[i].first <= ranges[m-1].last + 1)
+        {
+            if (ranges[i].last > ranges[m-1].last) ranges[m-1].last = ranges[i].last;
+        }
+        else
+            ranges[m++] = ranges[i];
+    }
+
+    unsigned long total = 0;
+    for (unsigned long i=0; i<m; ++i)
+        total += ranges[i].last - ranges[i].first + 1;
+
+    unsigned long *lines = (unsigned long*)malloc((total ? total : 1) * sizeof(unsigned long));
+    if (lines == NULL) FatalError("Cannot allocate memory for ranges");
+    unsigned long k = 0;
+    for (unsigned long i=0; i<m; ++i)
+        for (unsigned long l=ranges[i].first; l<=ranges[i].last; ++l)
+            lines[k++] = l;
+
+    free(ranges);
+    *count = total;
+    *nranges = m;
+    return lines;
+}
+
+int main(int ac, char **av)
+{
+    const char *usage = "Usage: ab_roi [-s] in_filename out_filename search_filename ranges";
+    int sparse = 0;
+    int opt;
+    while ((opt = getopt(ac, av, "s")) != -1)
+    {
+        if (opt == 's') sparse = 1;
+        else FatalError(usage);
+    }
+    if (ac - optind < 4)
+        FatalError(usage);
+
+    char *infilename = av[optind];
+    char *outfilename = av[optind + 1];
+    char *searchfilename = av[optind + 2];
+    char *rangespec = av[optind + 3];
+
+    printf("Loading file %s\n", infilename);
+    int infd = open(infilename, O_RDONLY);
+    if (infd < 0) FatalError("Cannot open file for reading");
+    struct stat st;
+    fstat(infd, &st);
+    unsigned long length = (unsigned long)st.st_size / sizeof(struct Pixel);
+    unsigned long nlines = (length + A_LINESIZE - 1) / A_LINESIZE;
+    printf("Found %lu pixels, a line length of %d and a line count of %lu.\n", length, A_LINESIZE, nlines);
+
+    unsigned long count, nranges;
+    unsigned long *roi = ParseRanges(rangespec, nlines, &count, &nranges);
+    printf("Selected %lu of %lu lines in %lu ranges\n", count, nlines, nranges);
+
+    struct Image search;
+    printf("Loading file %s\n", searchfilename);
+    LoadFile(searchfilename, &search, 0);
+    printf("Found %lu search term pixels\n", search.length);
+
+    struct SearchIndex index;
+    SearchIndexBuild(&index, &search);
+    unsigned long *hits = SearchIndexCounters(&index);
+
+    int outfd = open(outfilename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (outfd < 0) FatalError("Cannot open file for writing");
+    size_t linebytes = A_LINESIZE * sizeof(struct Pixel);
+    // sparse output: full size, holes where lines were not requested
+    if (sparse && ftruncate(outfd, (off_t)(nlines * linebytes)) != 0)
+        FatalError("Cannot write output");
+
+    printf("Processing Bleeding, Greyscale, XOR and Searching\n");
+    #pragma omp parallel default(none) shared(roi, count, infd, outfd, length, linebytes, sparse, index, hits)
+    {
+        unsigned long *local = SearchIndexCounters(&index);
+        struct Pixel *line = (struct Pixel*)malloc(linebytes);
+        if (line == NULL) FatalError("Cannot allocate memory for a line");
+
+        #pragma omp for schedule(runtime)
+        for (unsigned long i=0; i<count; ++i)
+        {
+            unsigned long l = roi[i];
+            if (ReadLineAt(infd, length, A_LINESIZE, l, line) != 0)
+                FatalError("Cannot read input");
+            TransformRange(line, 0, A_LINESIZE, &index, local);
+            off_t at = (off_t)((sparse ? l : i) * linebytes);
+            if (PwriteAll(outfd, line, linebytes, at) != 0)
+                FatalError("Cannot write output");
+        }
+
+        for (unsigned long s=0; s<index.slots; ++s)
+        {
+            if (local[s])
+            {
+                #pragma omp atomic
+                hits[s] += local[s];
+            }
+        }
+        free(line);
+        free(local);
+    }
+
+    printf("Saving file %s%s\n", outfilename, sparse ? " (sparse)" : "");
+    if (close(outfd) != 0) FatalError("Cannot write output");
+    close(infd);
+
+    unsigned long *counter = (unsigned long*)malloc((search.length ? search.length : 1) * sizeof(unsigned long));
+    if (counter == NULL) FatalError("malloc failed for counter");
+    SearchIndexExpand(&index, hits, counter);
+
+    printf("Search Results:\n");
+    PrintSearchResults(&search, counter);
+
+    free(counter);
+    free(hits);
+    free(roi);
+    SearchIndexFree(&index);
+    FreeImage(&search);
+    return 0;
+}
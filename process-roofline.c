@@ -0,0 +1,299 @@
+// process-roofline.c
+// Roofline calibration: what this node sustains, measured on the CPUs the job was
+// given rather than taken from a datasheet
+//  - triad   STREAM-style a[i] = b[i] + s * c[i] on doubles, once per NUMA node (every
+//            allowed CPU of the node, arrays first-touched by the threads that use
+//            them), once on a single CPU and once on all allowed CPUs together.
+//            Bytes are counted the STREAM way, 24 per element (write-allocate traffic
+//            is not counted), and the best of the timed repeats is reported.
+//  - intops  independent integer xor / rotate / add chains, on one thread and on all
+//            threads. IntChains is built without vectorisation and each operation is
+//            one instruction, so gops is an instruction rate (Ginstr/s, loop control
+//            not counted): the ceiling analyse.sh sets retired instructions per pixel
+//            against, not a vector-op peak.
+//
+// One line per measurement on stdout, then a summary that analyse.sh -r reads:
+//
+//   ROOF kernel=triad domain=node0 cpus=0-15 threads=16 array_mib=64 best_ms=... gb_per_s=...
+//   ROOF kernel=intops threads=16 best_ms=... gops=...
+//   ROOF summary domains=2 cpus=32 cpus_per_domain=16 bw1_gb_s=... bw_domain_gb_s=...
+//        bw_all_gb_s=... int1_gops=... int_all_gops=...
+//
+// bw_domain_gb_s is the slowest node. Without /sys/devices/system/node (or with a
+// single node) the allowed CPUs form one domain.
+//
+// Usage: ab_roofline [-m array_mib] [-n repeats] [-t ms]
+//   -m  MiB per triad array (default 64; three arrays, so keep it well above the LLC)
+//   -n  timed repeats per measurement (default 10, after one untimed)
+//   -t  target milliseconds per intops repeat (default 100)
+
+#define _GNU_SOURCE // sched_setaffinity / CPU_SET
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <omp.h>
+#include "rawimage.h"
+
+#define ROOF_MAX_DOMAINS 64
+#define ROOF_CHAINS 8   // independent integer chains per thread
+#define ROOF_OPS 3      // integer instructions per chain step (xor, rotate, add)
+
+static unsigned long arraymib = 64;
+static int repeats = 10;
+static double targetms = 100.0;
+static volatile unsigned long sink;  // keeps results live
+
+// The CPUs of one domain that this process may run on
+struct Domain {
+    char name[16];
+    int ncpus;
+    int *cpus;
+};
+
+// Parse a cpulist ("0-3,8,10-11") into the CPUs that are also in allowed
+static int ParseCpuList(const char *s, const cpu_set_t *allowed, int *cpus, int max)
+{
+    int n = 0;
+    while (*s && *s != '\n')
+    {
+        char *end;
+        long lo = strtol(s, &end, 10), hi = lo;
+        if (end == s) break;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c=lo; c<=hi && n<max; ++c)
+            if (c >= 0 && c < CPU_SETSIZE && CPU_ISSET((int)c, allowed)) cpus[n++] = (int)c;
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return n;
+}
+
+// Print cpus in cpulist syntax
+static void FormatCpuList(const int *cpus, int n, char *buf, size_t size)
+{
+    size_t used = 0;
+    buf[0] = '\0';
+    for (int i=0; i<n && used < size; )
+    {
+        int j = i;
+        while (j + 1 < n && cpus[j + 1] == cpus[j] + 1) ++j;
+        int w = (j > i) ? snprintf(buf + used, size - used, "%s%d-%d", used ? "," : "", cpus[i], cpus[j])
+                        : snprintf(buf + used, size - used, "%s%d", used ? "," : "", cpus[i]);
+        if (w < 0) break;
+        used += (size_t)w;
+        i = j + 1;
+    }
+}
+
+static void DomainInit(struct Domain *d, const char *name, const int *cpus, int n)
+{
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    d->cpus = (int*)malloc((size_t)n * sizeof(int));
+    if (d->cpus == NULL) FatalError("malloc failed for domain cpus");
+    memcpy(d->cpus, cpus, (size_t)n * sizeof(int));
+    d->ncpus = n;
+}
+
+// The NUMA nodes with at least one allowed CPU; returns how many
+static int FindDomains(const cpu_set_t *allowed, struct Domain *dom, int *all, int *nall)
+{
+    *nall = 0;
+    for (int c=0; c<CPU_SETSIZE; ++c)
+        if (CPU_ISSET(c, allowed)) all[(*nall)++] = c;
+
+    int ndom = 0;
+    int *cpus = (int*)malloc(CPU_SETSIZE * sizeof(int));
+    if (cpus == NULL) FatalError("malloc failed for cpu list");
+    for (int node=0; node<1024 && ndom<ROOF_MAX_DOMAINS; ++node)
+    {
+        char path[64], line[4096], name[16];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *f = fopen(path, "r");
+        if (f == NULL) continue;  // node numbers may have gaps
+        int got = fgets(line, sizeof(line), f) != NULL;
+        fclose(f);
+        if (!got) continue;
+        int n = ParseCpuList(line, allowed, cpus, CPU_SETSIZE);
+        if (n == 0) continue;
+        snprintf(name, sizeof(name), "node%d", node);
+        DomainInit(&dom[ndom++], name, cpus, n);
+    }
+    free(cpus);
+    if (ndom == 0) DomainInit(&dom[ndom++], "all", all, *nall);
+    return ndom;
+}
+
+// Pin the calling thread to one CPU
+static void PinTo(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);  // best effort: an unpinned run still measures
+}
+
+// STREAM triad with one thread pinned to each of cpus; returns the best GB/s
+static double Triad(const char *domain, const int *cpus, int n, const cpu_set_t *allowed)
+{
+    unsigned long len = arraymib * 1024 * 1024 / sizeof(double);
+    double *a = (double*)malloc(len * sizeof(double));
+    double *b = (double*)malloc(len * sizeof(double));
+    double *c = (double*)malloc(len * sizeof(double));
+    if (a == NULL || b == NULL || c == NULL) FatalError("malloc failed for triad arrays (lower -m)");
+
+    double best = 0.0;
+    const double s = 3.0;
+    #pragma omp parallel num_threads(n) default(none) shared(a, b, c, len, cpus, n, best, allowed, repeats) firstprivate(s)
+    {
+        int me = omp_get_thread_num();
+        PinTo(cpus[me]);
+        // same static split for the first touch and the triad, so each thread's pages
+        // sit on its own node
+        #pragma omp for schedule(static)
+        for (unsigned long i=0; i<len; ++i)
+        {
+            a[i] = 0.0;
+            b[i] = 1.0;
+            c[i] = 2.0;
+        }
+        for (int r=-1; r<repeats; ++r)
+        {
+            double t0 = 0.0;
+            #pragma omp barrier
+            #pragma omp master
+            t0 = omp_get_wtime();
+            #pragma omp for schedule(static)
+            for (unsigned long i=0; i<len; ++i)
+                a[i] = b[i] + s * c[i];
+            #pragma omp master
+            {
+                double secs = omp_get_wtime() - t0;
+                if (r >= 0 && secs > 0 && (best == 0.0 || secs < best)) best = secs;
+            }
+        }
+        sched_setaffinity(0, sizeof(*allowed), allowed);
+    }
+    sink += (unsigned long)a[len / 2];
+
+    double gbs = best > 0 ? 3.0 * (double)len * sizeof(double) / best * 1e-9 : 0.0;
+    char list[256];
+    FormatCpuList(cpus, n, list, sizeof(list));
+    printf("ROOF kernel=triad domain=%s cpus=%s threads=%d array_mib=%lu best_ms=%.3f gb_per_s=%.3f\n",
+           domain, list, n, arraymib, best * 1e3, gbs);
+    fflush(stdout);
+    free(a);
+    free(b);
+    free(c);
+    return gbs;
+}
+
+// n steps of ROOF_CHAINS independent integer chains (ROOF_OPS instructions each)
+// Kept scalar: vectorised, one instruction would do several chains' operations and
+// the rate would no longer compare with instructions retired per pixel. Every step
+// is xor, rotate and add with immediates, so no register copies creep in either.
+__attribute__((optimize("no-tree-vectorize")))
+static unsigned long IntChains(unsigned long n, unsigned int seed)
+{
+    unsigned int x[ROOF_CHAINS];
+    for (int k=0; k<ROOF_CHAINS; ++k) x[k] = seed + 0x9E3779B9u * (unsigned int)(k + 1);
+    for (unsigned long i=0; i<n; ++i)
+        for (int k=0; k<ROOF_CHAINS; ++k)
+        {
+            unsigned int y = x[k] ^ 0x5BD1E995u;
+            x[k] = ((y << 5) | (y >> 27)) + 0x6D2B79F5u;
+        }
+    unsigned long r = 0;
+    for (int k=0; k<ROOF_CHAINS; ++k) r += x[k];
+    return r;
+}
+
+// Integer instruction throughput on n threads; returns the best Ginstr/s
+static double IntOps(int n)
+{
+    // size the step count on one thread so a repeat takes about -t ms
+    unsigned long steps = 1UL << 16;
+    for (;;)
+    {
+        double t0 = omp_get_wtime();
+        sink += IntChains(steps, (unsigned int)steps);
+        double ms = (omp_get_wtime() - t0) * 1e3;
+        if (ms >= targetms / 4 || steps >= (1UL << 40)) { steps = (unsigned long)((double)steps * targetms / (ms > 0 ? ms : 1)); break; }
+        steps *= 4;
+    }
+    if (steps == 0) steps = 1;
+
+    double best = 0.0;
+    for (int r=-1; r<repeats; ++r)
+    {
+        unsigned long total = 0;
+        double t0 = omp_get_wtime();
+        #pragma omp parallel num_threads(n) default(none) shared(steps) reduction(+:total)
+        total += IntChains(steps, (unsigned int)omp_get_thread_num());
+        double secs = omp_get_wtime() - t0;
+        sink += total;
+        if (r >= 0 && secs > 0 && (best == 0.0 || secs < best)) best = secs;
+    }
+
+    double gops = best > 0 ? (double)n * (double)steps * ROOF_CHAINS * ROOF_OPS / best * 1e-9 : 0.0;
+    printf("ROOF kernel=intops threads=%d best_ms=%.3f gops=%.3f\n", n, best * 1e3, gops);
+    fflush(stdout);
+    return gops;
+}
+
+int main(int ac, char **av)
+{
+    int opt;
+    while ((opt = getopt(ac, av, "m:n:t:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm': arraymib = strtoul(optarg, NULL, 10); break;
+            case 'n': repeats = atoi(optarg); break;
+            case 't': targetms = atof(optarg); break;
+            default:
+                FatalError("Usage: ab_roofline [-m array_mib] [-n repeats] [-t ms]");
+        }
+    }
+    if (arraymib < 1 || repeats < 1 || targetms <= 0)
+        FatalError("Need at least 1 MiB per array, 1 repeat and a positive -t");
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) FatalError("Cannot read the CPU affinity");
+    int *all = (int*)malloc(CPU_SETSIZE * sizeof(int));
+    if (all == NULL) FatalError("malloc failed for cpu list");
+    int nall;
+    struct Domain dom[ROOF_MAX_DOMAINS];
+    int ndom = FindDomains(&allowed, dom, all, &nall);
+    printf("Calibrating on %d CPUs in %d domain(s), %lu MiB per triad array, %d repeats\n",
+           nall, ndom, arraymib, repeats);
+
+    double bw1 = Triad("single", all, 1, &allowed);
+    // a single domain holding every allowed CPU is the same measurement as "all"
+    int separate = ndom > 1 || dom[0].ncpus != nall;
+    double bwdomain = 0.0;
+    int perdomain = 0;
+    for (int d=0; d<ndom; ++d)
+    {
+        if (separate)
+        {
+            double gbs = Triad(dom[d].name, dom[d].cpus, dom[d].ncpus, &allowed);
+            if (bwdomain == 0.0 || gbs < bwdomain) bwdomain = gbs;
+        }
+        if (dom[d].ncpus > perdomain) perdomain = dom[d].ncpus;
+    }
+    double bwall = Triad("all", all, nall, &allowed);
+    if (!separate) bwdomain = bwall;
+
+    double int1 = IntOps(1);
+    double intall = nall > 1 ? IntOps(nall) : int1;
+
+    printf("ROOF summary domains=%d cpus=%d cpus_per_domain=%d bw1_gb_s=%.3f bw_domain_gb_s=%.3f bw_all_gb_s=%.3f "
+           "int1_gops=%.3f int_all_gops=%.3f\n",
+           ndom, nall, perdomain, bw1, bwdomain, bwall, int1, intall);
+
+    for (int d=0; d<ndom; ++d) free(dom[d].cpus);
+    free(all);
+    return 0;
+}
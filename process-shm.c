@@ -0,0 +1,176 @@
+// process-shm.c
+// Process A / Process B over mapped memory: zero-copy handoff with producer and
+// consumer processes.
+//
+// Input and output may each be a path, an inherited descriptor ("fd:N", e.g. a
+// memfd passed by the parent) or a named POSIX shared-memory segment ("shm:/name").
+// The input is mapped read-only and read in place (the .raw format is the
+// in-memory struct Pixel layout); the output is mapped shared and the result is
+// built directly in it, so producer -> transform -> consumer never touches the
+// filesystem. A shm output is created if needed and, like any output, is sized to
+// exactly what a_seq / b_seq would write (Method A pads the last line).
+//
+// Usage: ab_shm a|b input output search_filename
+//   e.g. ab_shm a fd:3 shm:/frame-out search.raw
+//
+// Standard output and output bytes are identical to a_seq / b_seq.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "rawimage.h"
+#include "searchindex.h"
+#include "transform.h"
+#include "rawio.h"
+#include "searchresults.h"
+
+// Open an input or output named by path, "fd:N" or "shm:/name"
+// spec - the name
+// output - open for writing (a path is truncated, a shm segment created)
+// returns the descriptor (fatal error if it can't be opened)
+static int OpenRawSpec(const char *spec, int output)
+{
+    int fd;
+    if (strncmp(spec, "fd:", 3) == 0)
+    {
+        char *end;
+        long n = strtol(spec + 3, &end, 10);
+        if (*end != '\0' || n < 0) FatalError("Descriptors must be given as fd:N");
+        fd = (int)n;
+        if (fcntl(fd, F_GETFD) < 0) FatalError("Descriptor is not open");
+    }
+    else if (strncmp(spec, "shm:", 4) == 0)
+        fd = shm_open(spec + 4, output ? O_RDWR | O_CREAT : O_RDONLY, 0600);
+    else
+        fd = open(spec, output ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+
+    if (fd < 0) FatalError(output ? "Cannot open file for writing" : "Cannot open file for reading");
+    return fd;
+}
+
+int main(int ac, char **av)
+{
+    if (ac < 5)
+    {
+        FatalError("Usage: ab_shm a|b input output search_filename   (input/output: path, fd:N or shm:/name)");
+    }
+
+    unsigned long linesize;
+    if (strcmp(av[1], "a") == 0 || strcmp(av[1], "A") == 0) linesize = 1000;
+    else if (strcmp(av[1], "b") == 0 || strcmp(av[1], "B") == 0) linesize = 0;
+    else FatalError("Method must be a or b");
+
+    char *infilename = av[2];
+    char *outfilename = av[3];
+    char *searchfilename = av[4];
+
+    // Map the input in place
+    printf("Loading file %s\n", infilename);
+    int infd = OpenRawSpec(infilename, 0);
+    struct stat st;
+    if (fstat(infd, &st) != 0) FatalError("Cannot open file for reading");
+    unsigned long length = (unsigned long)st.st_size / sizeof(struct Pixel);
+    const struct Pixel *in = NULL;
+    if (length > 0)
+    {
+        void *m = mmap(NULL, length * sizeof(struct Pixel), PROT_READ, MAP_SHARED, infd, 0);
+        if (m == MAP_FAILED) FatalError("Cannot map input");
+        in = (const struct Pixel*)m;
+    }
+
+    // Same geometry as ImageData: Method A pads the final line
+    unsigned long lines = 1, ls = length;
+    if (linesize != 0)
+    {
+        ls = linesize;
+        lines = (length + linesize - 1) / linesize;
+    }
+    unsigned long outlength = lines * ls;
+    printf("Loaded file with %lu pixels, a line length of %lu and a line count of %lu.\n", outlength, ls, lines);
+
+    struct Image search;
+    printf("Loading file %s\n", searchfilename);
+    LoadFile(searchfilename, &search, 0);
+    printf("Found %lu search term pixels\n", search.length);
+
+    struct SearchIndex index;
+    SearchIndexBuild(&index, &search);
+    unsigned long *hits = SearchIndexCounters(&index);
+
+    // Map the output; where the target can't be sized/mapped (a pipe, /dev/null)
+    // build the result in heap memory and write it out at the end
+    int outfd = OpenRawSpec(outfilename, 1);
+    size_t outbytes = outlength * sizeof(struct Pixel);
+    struct Pixel *out = NULL;
+    int mapped = 0;
+    if (fstat(outfd, &st) == 0 && S_ISREG(st.st_mode) && ftruncate(outfd, (off_t)outbytes) == 0)
+        mapped = 1;
+    if (outbytes > 0 && mapped)
+    {
+        void *m = mmap(NULL, outbytes, PROT_READ | PROT_WRITE, MAP_SHARED, outfd, 0);
+        if (m == MAP_FAILED) FatalError("Cannot map output");
+        out = (struct Pixel*)m;
+    }
+    else if (outbytes > 0)
+    {
+        out = (struct Pixel*)malloc(outbytes);
+        if (out == NULL) FatalError("Cannot allocate memory for output");
+    }
+
+    printf("Processing Bleeding, Greyscale, XOR and Searching\n");
+    #pragma omp parallel default(none) shared(in, out, lines, ls, length, index, hits)
+    {
+        unsigned long *local = SearchIndexCounters(&index);
+
+        // Method A rows are independent; Method B is one row and runs on one thread
+        #pragma omp for schedule(runtime)
+        for (unsigned long l=0; l<lines; ++l)
+        {
+            struct Pixel *line = out + l * ls;
+            unsigned long first = l * ls;
+            unsigned long n = (first >= length) ? 0 : (length - first < ls ? length - first : ls);
+            if (n) memcpy(line, in + first, n * sizeof(struct Pixel));
+            memset(line + n, 0, (ls - n) * sizeof(struct Pixel));
+            TransformRange(line, 0, ls, &index, local);
+        }
+
+        for (unsigned long s=0; s<index.slots; ++s)
+        {
+            if (local[s])
+            {
+                #pragma omp atomic
+                hits[s] += local[s];
+            }
+        }
+        free(local);
+    }
+
+    printf("Saving file %s\n", outfilename);
+    if (!mapped && outbytes > 0 && WriteAllFd(outfd, out, outbytes) != 0)
+        FatalError("Cannot write output");
+    if (mapped && out != NULL) munmap(out, outbytes);
+    else free(out);
+    if (in != NULL) munmap((void*)in, length * sizeof(struct Pixel));
+    close(outfd);
+    close(infd);
+
+    unsigned long *counter = (unsigned long*)malloc((search.length ? search.length : 1) * sizeof(unsigned long));
+    if (counter == NULL) FatalError("malloc failed for counter");
+    SearchIndexExpand(&index, hits, counter);
+
+    printf("Search Results:\n");
+    PrintSearchResults(&search, counter);
+
+    free(counter);
+    free(hits);
+    SearchIndexFree(&index);
+    FreeImage(&search);
+    return 0;
+}
@@ -6,10 +6,18 @@
 //
 // BUT for assessment execution an original copy of this library will be used!
 //
+// Linking: by default every function below is defined in this header, so a program
+// is a single translation unit as before. With RAWIMAGE_LIB defined (librawimage.h
+// defines it) only the declarations remain and the definitions come from
+// librawimage.a / librawimage.so, so several translation units can share them.
+
+#ifndef RAWIMAGE_H
+#define RAWIMAGE_H
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 
 // Struct to hold individual pixels
 struct Pixel {
@@ -26,6 +34,51 @@ struct Image {
     struct Pixel **pixels;
 };
 
+// For creating memory for an Image how do we initialise the pixels
+enum InitialisationType {
+    NONE,
+    ZERO,
+    RANDOM
+};
+
+#define IMAGE_FILL_BLOCK 65536UL  // pixels per ImageFill call when ImageData fills in parallel
+
+// splitmix64 finaliser
+static inline unsigned long long RandomMix64(unsigned long long z)
+{
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Counter-based random pixel: channels 0..254 (as rand() % 255 gave) from a hash of
+// (seed, index) alone, so any thread can generate any pixel in any order
+static inline void RandomPixel(struct Pixel *p, unsigned long long seed, unsigned long long index)
+{
+    unsigned long long z = RandomMix64(RandomMix64(seed) + (index + 1) * 0x9E3779B97F4A7C15ULL);
+    p->red = (int)(((z & 0x1FFFFF) * 255) >> 21);
+    p->green = (int)((((z >> 21) & 0x1FFFFF) * 255) >> 21);
+    p->blue = (int)((((z >> 42) & 0x1FFFFF) * 255) >> 21);
+}
+
+#ifdef RAWIMAGE_LIB
+
+// Defined in librawimage (see the definitions below for what each does)
+extern unsigned long long ImageRandomSeed;
+
+void FatalError(const char * err);
+void ImageData(struct Image *imagedata, unsigned long length, unsigned long linesize, enum InitialisationType initialisation);
+void ImageFill(struct Image *imagedata, unsigned long start, unsigned long end, enum InitialisationType initialisation);
+void FreeImage(struct Image *imagedata);
+void PrintRGBValue(int value);
+void PrintImage(struct Image *imagedata);
+void WriteFile(const char *filename, struct Image *imagedata);
+void LoadFile(const char *filename, struct Image *imagedata, unsigned long linesize);
+void Greyscale(struct Pixel *p);
+void XOR(struct Pixel *p, int val);
+
+#else
+
 // Send an error string to stderr and exit
 void FatalError(const char * err)
 {
@@ -33,18 +86,43 @@ void FatalError(const char * err)
     exit(1);
 }
 
-// For creating memory for an Image how do we initialise the pixels
-enum InitialisationType {
-    NONE,
-    ZERO,
-    RANDOM
-};
+// The seed RANDOM initialisation uses (RandomPixel); pixel values depend only on it and
+// the pixel's position, not on the thread count or the order they are filled in
+unsigned long long ImageRandomSeed = 1;
+
+// Initialise pixels [start, end) of an Image, counted along the lines (padding included)
+// imagedata - Image struct from ImageData
+// start, end - pixel range; disjoint ranges may be filled from different threads at once
+// initialisation - ZERO (memset per line), RANDOM (RandomPixel with ImageRandomSeed) or NONE
+void ImageFill(struct Image *imagedata, unsigned long start, unsigned long end, enum InitialisationType initialisation)
+{
+    if (initialisation == NONE || imagedata->linesize == 0) return;
+    unsigned long linesize = imagedata->linesize;
+    unsigned long long seed = ImageRandomSeed;
+    while (start < end)
+    {
+        unsigned long l = start / linesize;
+        unsigned long p = start % linesize;
+        unsigned long n = (end - start < linesize - p) ? end - start : linesize - p;
+        struct Pixel *px = imagedata->pixels[l] + p;
+        if (initialisation == RANDOM)
+        {
+            for (unsigned long i=0; i<n; ++i)
+                RandomPixel(&px[i], seed, start + i);
+        }
+        else // assume ZERO as a fallback
+            memset(px, 0, n * sizeof(struct Pixel));
+        start += n;
+    }
+}
 
 // Generate an area of memory for an Image of given data dimensions
 // imagedata - Image struct to load into
 // length - total length of the data
 // linesize - split into lines of this size (filling final line if needed to length always a multiple of linesize), 0 means all one line
-// initialisation - InitialisationType to specify if initialisation and if so what type (note random does not seed)
+// initialisation - InitialisationType to specify if initialisation and if so what type
+//   (ZERO lines come from calloc; RANDOM is seeded by ImageRandomSeed and filled in
+//   blocks of IMAGE_FILL_BLOCK across the OpenMP team, same pixels for any thread count)
 void ImageData(struct Image *imagedata, unsigned long length, unsigned long linesize, enum InitialisationType initialisation)
 {
     if (linesize == 0) { // load everything into one line of pixels
@@ -77,36 +155,46 @@ void ImageData(struct Image *imagedata, unsigned long length, unsigned long line
         FatalError("Cannot allocate memory for line data");
     }
 
-    // Allocate memory for lines
+    // Allocate memory for lines (zeroed by calloc for ZERO, so no initialisation pass)
     for (unsigned long l=0; l<imagedata->lines; ++l)
     {
-        imagedata->pixels[l] = (struct Pixel*)malloc(imagedata->linesize * sizeof(struct Pixel));
+        if (initialisation == ZERO)
+            imagedata->pixels[l] = (struct Pixel*)calloc(imagedata->linesize, sizeof(struct Pixel));
+        else
+            imagedata->pixels[l] = (struct Pixel*)malloc(imagedata->linesize * sizeof(struct Pixel));
         if (imagedata->pixels[l] == NULL)
             FatalError("Cannot allocate Pixel memory for a line");
-        // act on initialisation if required (if NONE ignore)
-        if (initialisation != NONE)
+    }
+
+    // act on initialisation if required (NONE and ZERO are done)
+    if (initialisation == RANDOM)
+    {
+        unsigned long total = imagedata->lines * imagedata->linesize;
+        unsigned long blocks = (total + IMAGE_FILL_BLOCK - 1) / IMAGE_FILL_BLOCK;
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static) if(blocks > 1)
+#endif
+        for (unsigned long b=0; b<blocks; ++b)
         {
-            for (unsigned long p=0; p<imagedata->linesize; ++p)
-            {
-                if (initialisation == RANDOM)
-                {
-                    imagedata->pixels[l][p].red=rand() % 255;
-                    imagedata->pixels[l][p].green=rand() % 255;
-                    imagedata->pixels[l][p].blue=rand() % 255;
-                }
-                else // assume ZERO as a fallback
-                {
-                    imagedata->pixels[l][p].red=0;
-                    imagedata->pixels[l][p].green=0;
-                    imagedata->pixels[l][p].blue=0;
-                }
-            }
+            unsigned long end = (b + 1) * IMAGE_FILL_BLOCK;
+            ImageFill(imagedata, b * IMAGE_FILL_BLOCK, end < total ? end : total, RANDOM);
         }
     }
 
     // Image items allocated
 }
 
+// Free the memory allocated for an Image by ImageData (or LoadFile)
+// imagedata - the Image struct to release
+void FreeImage(struct Image *imagedata)
+{
+    for (unsigned long l=0; l<imagedata->lines; ++l)
+        free(imagedata->pixels[l]);
+    free(imagedata->pixels);
+    imagedata->pixels = NULL;
+    imagedata->lines = imagedata->length = imagedata->linesize = 0;
+}
+
 // Print a nicely space-padded 3 place integer
 void PrintRGBValue(int value)
 {
@@ -214,3 +302,6 @@ void XOR(struct Pixel *p, int val)
     p->blue = p->blue ^ val;
 }
 
+#endif // RAWIMAGE_LIB
+
+#endif
@@ -0,0 +1,92 @@
+// Positioned I/O helpers for the line-oriented tools
+//
+// Method A lines are independent, so tools that touch only some lines (incremental
+// and region-of-interest runs) read and write them in place with pread/pwrite
+// instead of loading the whole file. Short reads/writes and EINTR are retried.
+//
+// Include after rawimage.h. Needs _POSIX_C_SOURCE >= 200809L.
+
+#ifndef RAWIO_H
+#define RAWIO_H
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+// Read exactly n bytes at off (returns 0, or -1 with errno set; EIO at end of file)
+int PreadAll(int fd, void *buf, size_t n, off_t off)
+{
+    char *p = (char*)buf;
+    while (n > 0)
+    {
+        ssize_t r = pread(fd, p, n, off);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { if (r == 0) errno = EIO; return -1; }
+        p += r; off += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+// Write exactly n bytes at off (returns 0, or -1 with errno set)
+int PwriteAll(int fd, const void *buf, size_t n, off_t off)
+{
+    const char *p = (const char*)buf;
+    while (n > 0)
+    {
+        ssize_t w = pwrite(fd, p, n, off);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) return -1;
+        p += w; off += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// Read exactly n bytes from the current position
+int ReadAllFd(int fd, void *buf, size_t n)
+{
+    char *p = (char*)buf;
+    while (n > 0)
+    {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { if (r == 0) errno = EIO; return -1; }
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+// Write exactly n bytes at the current position
+int WriteAllFd(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char*)buf;
+    while (n > 0)
+    {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// Read line l of a raw file into line, zero padding past the end of the file
+// (the same padding LoadFile gives the last line)
+// fd - the open raw file
+// length - file length in pixels
+// linesize - pixels per line
+// l - line number
+// line - output, linesize pixels
+int ReadLineAt(int fd, unsigned long length, unsigned long linesize, unsigned long l, struct Pixel *line)
+{
+    unsigned long first = l * linesize;
+    unsigned long n = (first >= length) ? 0 : (length - first < linesize ? length - first : linesize);
+    memset(line + n, 0, (linesize - n) * sizeof(struct Pixel));
+    if (n == 0) return 0;
+    return PreadAll(fd, line, n * sizeof(struct Pixel), (off_t)(first * sizeof(struct Pixel)));
+}
+
+#endif
@@ -0,0 +1,382 @@
+// Content-addressed result cache
+//
+// A result is keyed on a hash of the input file content, a hash of the search file
+// content and the transform parameters (method line size, bleed window, XOR value).
+// Each entry holds the output image and the per-search-entry counts, so a repeat of
+// a byte-identical (input, search, method) triple is answered with I/O only.
+//
+// Transformed pixels are always grey (r == g == b), so outputs whose values fit a
+// byte are stored compactly as one byte per pixel and expanded when restored.
+//
+// Hashing maps the file and hashes 1 MiB blocks in parallel (OpenMP), then folds
+// the block hashes in order, so the hash is the same for any thread count.
+//
+// Entries live as <dir>/<key>.rc and are written to a temporary name and renamed,
+// so concurrent writers and readers never see a partial entry.
+//
+// Include after rawimage.h and transform.h. Needs _POSIX_C_SOURCE >= 200809L.
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RESULTCACHE_MAGIC "RAWCACHE"
+#define RESULTCACHE_VERSION 1
+#define RESULTCACHE_BLOCK (1UL << 20)
+#define RESULTCACHE_FULL 0
+#define RESULTCACHE_GREY 1
+
+// On-disk entry header (followed by counts[searchlength] then the pixel payload)
+struct ResultCacheHeader {
+    char magic[8];
+    unsigned int version;
+    unsigned int format;           // RESULTCACHE_FULL or RESULTCACHE_GREY
+    unsigned long long key;
+    unsigned long long length;     // output pixels
+    unsigned long long searchlength;
+};
+
+// A cache entry read back from disk
+struct ResultCacheEntry {
+    struct ResultCacheHeader header;
+    unsigned long *counter;        // searchlength counts
+    int fd;                        // open entry, positioned at the payload
+};
+
+static inline unsigned long long HashMix(unsigned long long h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static inline unsigned long long HashRotl(unsigned long long x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// Hash a block of bytes (four independent lanes of 8-byte words)
+// p - the data
+// n - length in bytes
+// seed - seed (the block number when hashing files)
+unsigned long long HashBlock(const unsigned char *p, size_t n, unsigned long long seed)
+{
+    const unsigned long long m = 0x9E3779B97F4A7C15ULL;
+    unsigned long long a = seed ^ 0x243F6A8885A308D3ULL;
+    unsigned long long b = seed ^ 0x13198A2E03707344ULL;
+    unsigned long long c = seed ^ 0xA4093822299F31D0ULL;
+    unsigned long long d = seed ^ 0x082EFA98EC4E6C89ULL;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+    {
+        unsigned long long w[4];
+        memcpy(w, p + i, sizeof(w));
+        a = HashRotl(a ^ w[0], 29) * m;
+        b = HashRotl(b ^ w[1], 29) * m;
+        c = HashRotl(c ^ w[2], 29) * m;
+        d = HashRotl(d ^ w[3], 29) * m;
+    }
+    for (; i + 8 <= n; i += 8)
+    {
+        unsigned long long w;
+        memcpy(&w, p + i, sizeof(w));
+        a = HashRotl(a ^ w, 29) * m;
+    }
+    if (i < n)
+    {
+        unsigned long long w = 0;
+        memcpy(&w, p + i, n - i);
+        b = HashRotl(b ^ w, 29) * m;
+    }
+    return HashMix(a ^ HashRotl(b, 17) ^ HashRotl(c, 31) ^ HashRotl(d, 47) ^ (unsigned long long)n);
+}
+
+// Hash the whole content of an open file
+// fd - the descriptor (read from offset 0, position unchanged)
+// parallel - non-zero to hash blocks with an OpenMP parallel loop
+// hash - output, the content hash
+// bytes - output (may be NULL), the file size
+// returns 0 on success, -1 on failure (errno set)
+int HashFd(int fd, int parallel, unsigned long long *hash, unsigned long *bytes)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return -1;
+    size_t size = (size_t)st.st_size;
+    if (bytes) *bytes = (unsigned long)size;
+    if (size == 0)
+    {
+        *hash = HashMix(0);
+        return 0;
+    }
+
+    const unsigned char *data = (const unsigned char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        return -1;
+    posix_madvise((void*)data, size, POSIX_MADV_SEQUENTIAL);
+
+    unsigned long blocks = (unsigned long)((size + RESULTCACHE_BLOCK - 1) / RESULTCACHE_BLOCK);
+    unsigned long long *bh = (unsigned long long*)malloc(blocks * sizeof(unsigned long long));
+    if (bh == NULL) FatalError("Cannot allocate memory for block hashes");
+
+    #pragma omp parallel for schedule(static) if(parallel && blocks > 1)
+    for (unsigned long b=0; b<blocks; ++b)
+    {
+        size_t off = (size_t)b * RESULTCACHE_BLOCK;
+        size_t len = (size - off < RESULTCACHE_BLOCK) ? size - off : RESULTCACHE_BLOCK;
+        bh[b] = HashBlock(data + off, len, b);
+    }
+
+    unsigned long long h = HashMix((unsigned long long)size);
+    for (unsigned long b=0; b<blocks; ++b)
+        h = HashMix(h ^ bh[b]) + b;
+
+    free(bh);
+    munmap((void*)data, size);
+    *hash = h;
+    return 0;
+}
+
+// Hash the whole content of a file (see HashFd)
+int HashFile(const char *filename, int parallel, unsigned long long *hash, unsigned long *bytes)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return -1;
+    int rc = HashFd(fd, parallel, hash, bytes);
+    int e = errno;
+    close(fd);
+    errno = e;
+    return rc;
+}
+
+// Build the cache key for an (input, search, method) triple
+// inhash, searchhash - content hashes
+// linesize - the method's line size (1000 for A, 0 for B)
+unsigned long long ResultCacheKey(unsigned long long inhash, unsigned long long searchhash, unsigned long linesize)
+{
+    unsigned long long k = HashMix(inhash ^ 0x52415743414348ULL);
+    k = HashMix(k ^ HashRotl(searchhash, 21));
+    k = HashMix(k ^ ((unsigned long long)linesize << 16) ^ ((unsigned long long)BLEED_WINDOW << 8) ^ (unsigned long long)XOR_VALUE);
+    return HashMix(k ^ RESULTCACHE_VERSION);
+}
+
+// Directory for cache entries: $RAWIMAGE_CACHE_DIR, or .rawcache if unset
+const char *ResultCacheDir(void)
+{
+    const char *dir = getenv("RAWIMAGE_CACHE_DIR");
+    return (dir && *dir) ? dir : ".rawcache";
+}
+
+// Path of an entry: <dir>/<16 hex digits>.rc
+static void ResultCachePath(char *path, size_t size, const char *dir, unsigned long long key)
+{
+    snprintf(path, size, "%s/%016llx.rc", dir, key);
+}
+
+static int ResultCacheWriteAll(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char*)buf;
+    while (n > 0)
+    {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+static int ResultCacheReadAll(int fd, void *buf, size_t n)
+{
+    char *p = (char*)buf;
+    while (n > 0)
+    {
+        ssize_t r = read(fd, p, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) { if (r == 0) errno = EIO; return -1; }
+        p += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+// Store a result
+// dir - cache directory (created if missing)
+// key - from ResultCacheKey
+// img - the transformed Image (all lines are written, as WriteFile does)
+// counter - per-search-entry counts
+// searchlength - number of search entries
+// returns 0 on success, -1 on failure (a failed store is not fatal to the caller)
+int ResultCacheStore(const char *dir, unsigned long long key, struct Image *img,
+                     const unsigned long *counter, unsigned long searchlength)
+{
+    mkdir(dir, 0755);
+
+    struct ResultCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, RESULTCACHE_MAGIC, 8);
+    h.version = RESULTCACHE_VERSION;
+    h.key = key;
+    h.length = (unsigned long long)img->lines * img->linesize;
+    h.searchlength = searchlength;
+
+    h.format = RESULTCACHE_GREY;
+    for (unsigned long l=0; l<img->lines && h.format == RESULTCACHE_GREY; ++l)
+        for (unsigned long p=0; p<img->linesize; ++p)
+        {
+            const struct Pixel *px = &(img->pixels[l][p]);
+            if (px->red != px->green || px->red != px->blue || px->red < 0 || px->red > 255)
+            {
+                h.format = RESULTCACHE_FULL;
+                break;
+            }
+        }
+
+    char path[4096], tmp[4200];
+    ResultCachePath(path, sizeof(path), dir, key);
+    static unsigned long storeseq = 0; // unique temporary names for concurrent stores in one process
+    unsigned long seq;
+    #pragma omp atomic capture
+    seq = ++storeseq;
+    snprintf(tmp, sizeof(tmp), "%s.%ld.%lu.tmp", path, (long)getpid(), seq);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return -1;
+
+    int rc = ResultCacheWriteAll(fd, &h, sizeof(h));
+    for (unsigned long i=0; i<searchlength && rc == 0; ++i)
+    {
+        unsigned long long c = counter[i];
+        rc = ResultCacheWriteAll(fd, &c, sizeof(c));
+    }
+
+    unsigned char *grey = NULL;
+    if (h.format == RESULTCACHE_GREY)
+    {
+        grey = (unsigned char*)malloc(img->linesize ? img->linesize : 1);
+        if (grey == NULL) FatalError("Cannot allocate memory for cache entry");
+    }
+    for (unsigned long l=0; l<img->lines && rc == 0; ++l)
+    {
+        if (grey)
+        {
+            for (unsigned long p=0; p<img->linesize; ++p)
+                grey[p] = (unsigned char)img->pixels[l][p].red;
+            rc = ResultCacheWriteAll(fd, grey, img->linesize);
+        }
+        else
+            rc = ResultCacheWriteAll(fd, img->pixels[l], img->linesize * sizeof(struct Pixel));
+    }
+    free(grey);
+
+    if (close(fd) != 0) rc = -1;
+    if (rc == 0 && rename(tmp, path) == 0)
+        return 0;
+    unlink(tmp);
+    return -1;
+}
+
+// Look up a result
+// dir - cache directory
+// key - from ResultCacheKey
+// searchlength - expected number of search entries
+// entry - output, filled in on a hit (release with ResultCacheClose)
+// returns 1 on hit, 0 on miss
+int ResultCacheLookup(const char *dir, unsigned long long key, unsigned long searchlength,
+                      struct ResultCacheEntry *entry)
+{
+    char path[4096];
+    ResultCachePath(path, sizeof(path), dir, key);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return 0;
+
+    struct ResultCacheHeader *h = &entry->header;
+    if (ResultCacheReadAll(fd, h, sizeof(*h)) != 0 || memcmp(h->magic, RESULTCACHE_MAGIC, 8) != 0 ||
+        h->version != RESULTCACHE_VERSION || h->key != key || h->searchlength != searchlength)
+    {
+        close(fd);
+        return 0;
+    }
+
+    entry->counter = (unsigned long*)malloc((searchlength ? searchlength : 1) * sizeof(unsigned long));
+    if (entry->counter == NULL) FatalError("Cannot allocate memory for cache entry");
+    for (unsigned long i=0; i<searchlength; ++i)
+    {
+        unsigned long long c;
+        if (ResultCacheReadAll(fd, &c, sizeof(c)) != 0)
+        {
+            free(entry->counter);
+            close(fd);
+            return 0;
+        }
+        entry->counter[i] = (unsigned long)c;
+    }
+    entry->fd = fd;
+    return 1;
+}
+
+// Write a cached output image to a file
+// entry - from a successful ResultCacheLookup
+// filename - the output file (will overwrite or create)
+// returns 0 on success, -1 on failure (errno set)
+int ResultCacheRestore(struct ResultCacheEntry *entry, const char *filename)
+{
+    int out = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0)
+        return -1;
+
+    const unsigned long chunk = 65536;
+    int grey = (entry->header.format == RESULTCACHE_GREY);
+    unsigned char *in = (unsigned char*)malloc(chunk * sizeof(struct Pixel));
+    struct Pixel *px = (struct Pixel*)malloc(chunk * sizeof(struct Pixel));
+    if (in == NULL || px == NULL) FatalError("Cannot allocate memory for cache restore");
+
+    int rc = 0;
+    for (unsigned long long done=0; done<entry->header.length && rc == 0; )
+    {
+        unsigned long n = (entry->header.length - done < chunk) ? (unsigned long)(entry->header.length - done) : chunk;
+        if (grey)
+        {
+            rc = ResultCacheReadAll(entry->fd, in, n);
+            for (unsigned long p=0; p<n; ++p)
+                px[p].red = px[p].green = px[p].blue = in[p];
+        }
+        else
+            rc = ResultCacheReadAll(entry->fd, px, n * sizeof(struct Pixel));
+        if (rc == 0)
+            rc = ResultCacheWriteAll(out, px, n * sizeof(struct Pixel));
+        done += n;
+    }
+    free(in);
+    free(px);
+
+    int e = errno;
+    if (close(out) != 0 && rc == 0) { rc = -1; e = errno; }
+    errno = e;
+    return rc;
+}
+
+// Release a looked-up entry
+void ResultCacheClose(struct ResultCacheEntry *entry)
+{
+    free(entry->counter);
+    entry->counter = NULL;
+    if (entry->fd >= 0) close(entry->fd);
+    entry->fd = -1;
+}
+
+#endif
@@ -18,22 +18,114 @@ set -euo pipefail
 export OMP_SCHEDULE
 
 # ---------- CLI helpers ----------
-DRYRUN=0; LISTONLY=0; RESUME=1
+DRYRUN=0; LISTONLY=0; RESUME=1; FORCE_LOCAL=0; FORCE_HALVING=0
 for a in "$@"; do
   [[ "$a" == "--dry-run"   ]] && DRYRUN=1
   [[ "$a" == "--list"      ]] && LISTONLY=1
   [[ "$a" == "--no-resume" ]] && RESUME=0
+  [[ "$a" == "--local"     ]] && FORCE_LOCAL=1
+  [[ "$a" == "--halving"   ]] && FORCE_HALVING=1
 done
-do_srun() { ((DRYRUN)) && { echo "[DRY] srun $*"; return 0; }; srun "$@"; }
+do_srun() {
+  ((DRYRUN)) && { echo "[DRY] $( [[ "$BACKEND" == "local" ]] && echo local || echo srun) $*"; return 0; }
+  if [[ "$BACKEND" == "local" ]]; then local_run "$@"; else srun "$@"; fi
+}
 
 # ---------- Load config & inputs ----------
 source ./conf.sh
 load_config
+if (( FORCE_HALVING )); then SWEEP_MODE="halving"; fi
 if declare -F validate_config >/dev/null 2>&1; then validate_config; fi
 resolve_inputs
 
 CONFIG="${CONFIG:-config.json}"
 
+# ---------- Execution backend ----------
+# slurm: every run goes through srun inside the sbatch allocation.
+# local: the same runs without Slurm (workstation, container). local_run stands in for
+# `srun --ntasks=1 --cpus-per-task=N [--cpu-bind=cores]`: the run gets the first N CPUs of
+# LOCAL_POOL through taskset, and OMP_PROC_BIND/OMP_PLACES pin its threads inside that set
+# exactly as they do under srun. The pool lists one CPU per physical core (packages and
+# cores in order, so NUMA nodes fill one at a time) before any SMT sibling, which is what
+# --cpu-bind=cores hands out. execution.cgroup additionally runs everything in a cpuset
+# cgroup over the pool ("confine"), optionally exclusive to it ("exclusive").
+# auto picks slurm inside an allocation with srun available, local otherwise.
+BACKEND="$EXEC_BACKEND"
+if (( FORCE_LOCAL )); then BACKEND="local"; fi
+if [[ "$BACKEND" == "auto" ]]; then
+  if [[ -n "${SLURM_JOB_ID:-}" ]] && command -v srun >/dev/null 2>&1; then BACKEND="slurm"; else BACKEND="local"; fi
+fi
+LOCAL_POOL=(); CG_DIR=""; CG_NOTE="off"
+
+# cpulist_expand <cpulist> -> one CPU number per line
+cpulist_expand() { awk -F',' '{for (i=1; i<=NF; ++i) {n=split($i, r, "-"); for (c=r[1]; c<=r[n]; ++c) print c}}' <<<"$1"; }
+
+# local_cpu_pool -> the usable CPUs (execution.cpus, else this process's affinity), one per
+# physical core first, then the second hardware thread of each core, and so on
+local_cpu_pool() {
+  local list="$EXEC_CPUS" c t
+  [[ -n "$list" ]] || list=$(awk '/^Cpus_allowed_list/ {print $2}' /proc/self/status)
+  cpulist_expand "$list" | while read -r c; do
+    t="/sys/devices/system/cpu/cpu$c/topology"
+    echo "$c $(cat "$t/physical_package_id" 2>/dev/null || echo 0) $(cat "$t/core_id" 2>/dev/null || echo "$c")"
+  done | awk '{print seen[$2 " " $3]++, $2, $3, $1}' | sort -n -k1,1 -k2,2 -k3,3 -k4,4 | awk '{print $4}'
+}
+
+# cgroup_setup -> CG_DIR, a cpuset cgroup over LOCAL_POOL (cgroup v2, else the v1 cpuset
+# hierarchy); needs root or a delegated cgroup tree, returns 1 (CG_NOTE says why) if not
+cgroup_setup() {
+  local base v2=0 cpus; cpus=$(IFS=,; echo "${LOCAL_POOL[*]}")
+  if [[ -f /sys/fs/cgroup/cgroup.controllers ]]; then
+    base=/sys/fs/cgroup; v2=1
+    if ! grep -qw cpuset "$base/cgroup.subtree_control" 2>/dev/null; then
+      echo "+cpuset" 2>/dev/null > "$base/cgroup.subtree_control" || { CG_NOTE="cannot enable the cpuset controller"; return 1; }
+    fi
+  elif [[ -d /sys/fs/cgroup/cpuset ]]; then
+    base=/sys/fs/cgroup/cpuset
+  else
+    CG_NOTE="no cpuset cgroup hierarchy"; return 1
+  fi
+  CG_DIR="$base/ab_bench_$$"
+  mkdir "$CG_DIR" 2>/dev/null || { CG_NOTE="cannot create $CG_DIR"; CG_DIR=""; return 1; }
+  if (( !v2 )); then cat "$base/cpuset.mems" 2>/dev/null > "$CG_DIR/cpuset.mems" || true; fi
+  if ! echo "$cpus" 2>/dev/null > "$CG_DIR/cpuset.cpus"; then
+    CG_NOTE="cannot assign CPUs $cpus"; rmdir "$CG_DIR" 2>/dev/null || true; CG_DIR=""; return 1
+  fi
+  CG_NOTE="confine $CG_DIR"
+  if [[ "$EXEC_CGROUP" == "exclusive" ]]; then
+    if (( v2 )); then
+      echo root 2>/dev/null > "$CG_DIR/cpuset.cpus.partition" && CG_NOTE="exclusive $CG_DIR" || CG_NOTE+=" (exclusive refused: CPUs in use by other cgroups)"
+    else
+      echo 1 2>/dev/null > "$CG_DIR/cpuset.cpu_exclusive" && CG_NOTE="exclusive $CG_DIR" || CG_NOTE+=" (exclusive refused: CPUs shared with sibling cpusets)"
+    fi
+  fi
+}
+
+# local_run [srun options] cmd args... -> cmd pinned to the first --cpus-per-task CPUs of the
+# pool (--ntasks is always 1 here; --cpu-bind=cores is what the pool order gives)
+local_run() {
+  local n=1
+  while [[ $# -gt 0 && "$1" == --* ]]; do
+    case "$1" in --cpus-per-task=*) n="${1#*=}" ;; esac
+    shift
+  done
+  (( n <= ${#LOCAL_POOL[@]} )) || n=${#LOCAL_POOL[@]}
+  local cpus; cpus=$(IFS=,; echo "${LOCAL_POOL[*]:0:n}")
+  if [[ -n "$CG_DIR" ]]; then
+    sh -c 'echo $$ > "$0/cgroup.procs" && exec "$@"' "$CG_DIR" taskset -c "$cpus" "$@"
+  else
+    taskset -c "$cpus" "$@"
+  fi
+}
+
+if [[ "$BACKEND" == "local" ]]; then
+  mapfile -t LOCAL_POOL < <(local_cpu_pool)
+  (( ${#LOCAL_POOL[@]} )) || { echo "No usable CPUs for the local backend (execution.cpus='$EXEC_CPUS')"; exit 1; }
+  if [[ "$EXEC_CGROUP" != "off" ]] && (( !DRYRUN && !LISTONLY )); then
+    cgroup_setup || echo "[local] cgroup isolation unavailable ($CG_NOTE); pinning with taskset only"
+  fi
+fi
+
 # Reproducible thread placement
 export OMP_PROC_BIND=close
 export OMP_PLACES=cores
@@ -72,6 +164,7 @@ _send_mail() {
 
 # Cap THREADS by Slurm allocation (de-dup if capped)
 MAX_CPUS=${SLURM_CPUS_PER_TASK:-${SLURM_CPUS_ON_NODE:-0}}
+if [[ "$BACKEND" == "local" ]]; then MAX_CPUS=${#LOCAL_POOL[@]}; fi
 if [[ "${MAX_CPUS:-0}" -gt 0 ]]; then
   tmp=()
   for t in "${THREADS[@]}"; do
@@ -84,6 +177,7 @@ fi
 JOB_STATUS="SUCCESS"
 trap 'JOB_STATUS="FAIL"' ERR
 trap '
+  if [[ -n "${CG_DIR:-}" ]]; then rmdir "$CG_DIR" 2>/dev/null || true; fi
   if _can_mail; then
     jid="${SLURM_JOB_ID:-N/A}"; node="$(hostname)"; when="$(date)"
     body="Job: ${SLURM_JOB_NAME:-csc4010-batch} (ID: $jid)
@@ -113,7 +207,8 @@ fi
 STOP_ON_TESTCASE_FAIL=${STOP_ON_TESTCASE_FAIL:-1}
 
 require() { command -v "$1" >/dev/null 2>&1 || { echo "Missing $1"; exit 1; }; }
-require md5sum; require srun; require awk; require grep
+require md5sum; require awk; require grep
+if [[ "$BACKEND" == "slurm" ]]; then require srun; else require taskset; fi
 
 mkdir -p "$OUTDIR"
 : > "$LOG"
@@ -125,12 +220,17 @@ echo "[cfg] infile=$INFILE"    | tee -a "$LOG"
 echo "[cfg] search=$SEARCH"    | tee -a "$LOG"
 echo "=== CSC4010 Batch Start: $(date) ===" | tee -a "$LOG"
 echo "Node: $(hostname)  JobID: ${SLURM_JOB_ID:-N/A}" | tee -a "$LOG"
+if [[ "$BACKEND" == "local" ]]; then
+  echo "Backend: local  cpus(core order)=$(IFS=,; echo "${LOCAL_POOL[*]}")  cgroup=$CG_NOTE" | tee -a "$LOG"
+else
+  echo "Backend: slurm" | tee -a "$LOG"
+fi
 echo "OpenMP: OMP_PROC_BIND=${OMP_PROC_BIND:-} OMP_PLACES=${OMP_PLACES:-} OMP_SCHEDULE=${OMP_SCHEDULE:-unset}" | tee -a "$LOG"
 echo | tee -a "$LOG"
 
 {
   echo "=== ENV SNAPSHOT ==="
-  echo "SLURM: ntasks=${SLURM_NTASKS:-?} cpus-per-task=${SLURM_CPUS_PER_TASK:-?} jobid=${SLURM_JOB_ID:-?}"
+  echo "SLURM: ntasks=${SLURM_NTASKS:-?} cpus-per-task=${SLURM_CPUS_PER_TASK:-?} jobid=${SLURM_JOB_ID:-?} backend=$BACKEND"
   command -v lscpu  >/dev/null && lscpu  | sed 's/^/lscpu: /'
   command -v numactl>/dev/null && numactl --hardware 2>/dev/null | sed 's/^/numactl: /'
   echo "===================="
@@ -144,10 +244,85 @@ echo "[cfg] threads (capped to ${MAX_CPUS:-?}): ${THREADS[*]}" | tee -a "$LOG"
 [[ "$CASE_SEL" == "a" || -x b_seq ]] || { echo "Baseline b_seq missing"; exit 1; }
 
 RESULTS_CSV="$OUTDIR/results.csv"
+# Per-phase columns come from the PHASES line each variant prints on stderr (phasetimer.h)
+PHASE_KEYS=(load_ms index_ms transform_ms search_ms merge_ms write_ms print_ms total_ms)
+# ... and derived hardware metrics from the "PERF phase=transform" line (empty if perf is unavailable)
+PERF_KEYS=(ipc llc_misses_per_px branch_misses_per_px)
+# ... and per-thread time accounting from the "SYNC" line (means over threads)
+SYNC_KEYS=(busy_ms wait_ms sync_ms idle_ms imbalance sync_points)
+# ... and the input set the row was measured on (input pixels, search entries, strong/weak)
+SET_KEYS=(pixels search_len scaling)
+# ... and, appended after those, transform counters for roofline placement (analyse.sh -r)
+ROOF_KEYS=(instructions_per_px)
+# ... and whether the "** (r,g,b) = n" search counts matched the gold's (empty: no gold counts)
+CHECK_KEYS=(counts_ok)
+# ... and energy: RAPL package / DRAM joules and mean watts around the whole run, joules per
+# gigapixel, and the transform's joules from the "ENERGY phase=transform" line (all empty
+# where RAPL is unavailable)
+ENERGY_KEYS=(energy_pkg_j energy_dram_j power_w energy_j_per_gpx transform_energy_j)
+# ... and memory from the "MEMORY" line: peak RSS, page faults, bytes allocated per subsystem
+MEM_KEYS=(maxrss_kb minflt majflt transform_minflt image_bytes search_bytes counters_bytes scratch_bytes allocs)
+CSV_HEADER="exe,tag,threads,schedule,chunk,md5_ok,time_ms,load_ms,index_ms,transform_ms,search_ms,merge_ms,write_ms,print_ms,inproc_ms,transform_ipc,transform_llc_miss_per_px,transform_branch_miss_per_px,busy_ms,wait_ms,sync_ms,idle_ms,imbalance,sync_points,pixels,search_len,scaling,transform_instr_per_px,counts_ok,energy_pkg_j,energy_dram_j,power_w,energy_j_per_gpx,transform_energy_j,maxrss_kb,minflt,majflt,transform_minflt,image_bytes,search_bytes,counters_bytes,scratch_bytes,allocs"
 if (( !LISTONLY && !DRYRUN )); then
-  [[ -f "$RESULTS_CSV" ]] || echo "exe,tag,threads,schedule,chunk,md5_ok,time_ms" >"$RESULTS_CSV"
+  if [[ ! -f "$RESULTS_CSV" ]]; then
+    echo "$CSV_HEADER" >"$RESULTS_CSV"
+  elif [[ "$(head -n1 "$RESULTS_CSV")" != "$CSV_HEADER" ]]; then
+    # older results.csv: widen it, leaving the phase columns of earlier rows empty
+    awk -F',' -v OFS=',' -v hdr="$CSV_HEADER" -v n="$(( 7 + ${#PHASE_KEYS[@]} + ${#PERF_KEYS[@]} + ${#SYNC_KEYS[@]} + ${#SET_KEYS[@]} + ${#ROOF_KEYS[@]} + ${#CHECK_KEYS[@]} + ${#ENERGY_KEYS[@]} + ${#MEM_KEYS[@]} ))" \
+      'NR==1 {print hdr; next} {for (i=NF+1; i<=n; ++i) $i=""; print}' "$RESULTS_CSV" > "$RESULTS_CSV.tmp"
+    mv "$RESULTS_CSV.tmp" "$RESULTS_CSV"
+    echo "[csv] Added per-phase / perf / sync / input set / roofline / counts / energy / memory columns to existing $RESULTS_CSV" | tee -a "$LOG"
+  fi
 fi
 
+# phase_fields <stderr file> -> comma separated phase + perf + sync values (empty if not reported)
+phase_fields() {
+  local line; line=$(grep -m1 '^PHASES ' "$1" 2>/dev/null || true)
+  local out="" k v
+  for k in "${PHASE_KEYS[@]}"; do
+    v=$(sed -n "s/.* ${k}=\([^ ]*\).*/\1/p" <<<"$line")
+    [[ "$v" == "-" ]] && v=""
+    out+=",${v}"
+  done
+  line=$(grep -m1 '^PERF phase=transform ' "$1" 2>/dev/null || true)
+  for k in "${PERF_KEYS[@]}"; do
+    v=$(sed -n "s/.* ${k}=\([^ ]*\).*/\1/p" <<<"$line")
+    [[ "$v" == "-" ]] && v=""
+    out+=",${v}"
+  done
+  line=$(grep -m1 '^SYNC exe=' "$1" 2>/dev/null || true)
+  for k in "${SYNC_KEYS[@]}"; do
+    v=$(sed -n "s/.* ${k}=\([^ ]*\).*/\1/p" <<<"$line")
+    [[ "$v" == "-" ]] && v=""
+    out+=",${v}"
+  done
+  echo "${out#,}"
+}
+
+# roof_fields <stderr file> -> comma separated transform counters for ROOF_KEYS
+roof_fields() {
+  local line; line=$(grep -m1 '^PERF phase=transform ' "$1" 2>/dev/null || true)
+  local out="" k v
+  for k in "${ROOF_KEYS[@]}"; do
+    v=$(sed -n "s/.* ${k}=\([^ ]*\).*/\1/p" <<<"$line")
+    [[ "$v" == "-" ]] && v=""
+    out+=",${v}"
+  done
+  echo "${out#,}"
+}
+
+# mem_fields <stderr file> -> comma separated MEM_KEYS values from the MEMORY line
+mem_fields() {
+  local line; line=$(grep -m1 '^MEMORY exe=' "$1" 2>/dev/null || true)
+  local out="" k v
+  for k in "${MEM_KEYS[@]}"; do
+    v=$(sed -n "s/.* ${k}=\([^ ]*\).*/\1/p" <<<"$line")
+    [[ "$v" == "-" ]] && v=""
+    out+=",${v}"
+  done
+  echo "${out#,}"
+}
+
 # already_done <tag>  -> exit 0 if tag present in results.csv
 already_done() {
   local tag="$1"
@@ -155,47 +330,129 @@ already_done() {
   awk -F',' -v t="$tag" 'NR>1 && $2==t {found=1; exit} END{exit !found}' "$RESULTS_CSV"
 }
 
-# --- Run one config; return 0 on MD5 match, 1 on mismatch ---
+# sched_cols -> "schedule,chunk" for the current OMP_SCHEDULE ("baked" where it does not apply)
+sched_cols() {
+  local schedule chunk
+  if [[ -n "${OMP_SCHEDULE-}" ]]; then
+    schedule="${OMP_SCHEDULE%%,*}"
+    if [[ "${OMP_SCHEDULE-}" == *","* ]]; then
+      chunk="${OMP_SCHEDULE##*,}"
+    else
+      chunk="baked"
+    fi
+  else
+    schedule="baked"
+    chunk="baked"
+  fi
+  echo "$schedule,$chunk"
+}
+
+# ---------- Energy (RAPL powercap) ----------
+# Package and DRAM energy counters of every socket, read just before and after each run
+# (baselines included, which have no in-process ENERGY lines). They count the whole
+# socket, so anything else running there is included. On most kernels energy_uj is
+# readable by root only; the energy columns then stay empty and the log says why.
+POWERCAP_ROOT=${POWERCAP_ROOT:-/sys/class/powercap}
+RAPL_FILES=(); RAPL_KINDS=(); RAPL_RANGES=(); RAPL_WHY=""
+for z in "$POWERCAP_ROOT"/intel-rapl:*; do
+  [[ -f "$z/name" && -f "$z/energy_uj" ]] || continue
+  case "$(<"$z/name")" in package-*) k=pkg ;; dram) k=dram ;; *) continue ;; esac
+  if ! cat "$z/energy_uj" >/dev/null 2>&1; then RAPL_WHY="energy_uj not readable (root only on this kernel)"; continue; fi
+  RAPL_FILES+=("$z/energy_uj"); RAPL_KINDS+=("$k")
+  RAPL_RANGES+=("$(cat "$z/max_energy_range_uj" 2>/dev/null || echo 0)")
+done
+if (( ${#RAPL_FILES[@]} )); then
+  RAPL_NOTE="RAPL ${#RAPL_FILES[@]} zones (${RAPL_KINDS[*]})"
+else
+  RAPL_NOTE="unavailable: ${RAPL_WHY:-no RAPL package/dram zones under $POWERCAP_ROOT}"
+fi
+echo "Energy   : $RAPL_NOTE" | tee -a "$LOG"
+
+# rapl_read -> the zones' energy_uj readings, space separated (empty if unavailable)
+rapl_read() {
+  (( ${#RAPL_FILES[@]} )) || return 0
+  cat "${RAPL_FILES[@]}" 2>/dev/null | tr '\n' ' ' || true
+}
+
+# energy_fields <before> <after> <ms> <stderr file> -> comma separated ENERGY_KEYS values
+energy_fields() {
+  local px; px=$(( $(stat -c %s "$INFILE") / 12 ))
+  local tj; tj=$(awk '/^ENERGY phase=transform / {
+      for (i = 3; i <= NF; ++i) { split($i, kv, "="); if (kv[1] ~ /_j$/ && kv[2] != "-") { s += kv[2]; ok = 1 } }
+      if (ok) printf "%.3f", s; exit }' "$4" 2>/dev/null || true)
+  if [[ -z "$1" || -z "$2" ]]; then echo ",,,,$tj"; return 0; fi
+  awk -v b="$1" -v a="$2" -v kinds="${RAPL_KINDS[*]}" -v ranges="${RAPL_RANGES[*]}" -v ms="$3" -v px="$px" -v tj="$tj" 'BEGIN {
+    n = split(b, x, " "); split(a, y, " "); split(kinds, k, " "); split(ranges, r, " ")
+    for (i = 1; i <= n; ++i) { d = y[i] - x[i]; if (d < 0) d += r[i]; j[k[i]] += d / 1e6; have[k[i]] = 1 }
+    tot = j["pkg"] + j["dram"]
+    printf "%s,%s,%s,%s,%s\n", (have["pkg"] ? sprintf("%.3f", j["pkg"]) : ""), (have["dram"] ? sprintf("%.3f", j["dram"]) : ""),
+      (ms > 0 ? sprintf("%.2f", tot * 1e3 / ms) : ""), (px > 0 ? sprintf("%.3f", tot * 1e9 / px) : ""), tj
+  }'
+}
+
+# --- Run one config; return 0 when the MD5 and the search counts match, 1 otherwise ---
 run_case_md5 () {
   local exe="$1" method="$2" tag="$3" gold="$4"
   local out="$OUTDIR/${tag}.bin"
   local sout="$OUTDIR/${tag}.stdout"
-  rm -f "$out" "$sout" 2>/dev/null || true
+  local serr="$OUTDIR/${tag}.stderr"
+  rm -f "$out" "$sout" "$serr" 2>/dev/null || true
 
-  local t0 t1 ms
-  t0=$(date +%s%N)
+  # The per-thread sync accounting, perf groups and RAPL readings (phasetimer.h) cost a
+  # few percent of the kernel, so they run here only with analysis.instrument; without
+  # it time_ms and the phases are the kernels alone and those columns stay empty.
+  local -x PHASE_SYNC=0 PHASE_PERF=0 PHASE_ENERGY=0
+  if [[ "$INSTRUMENT" == "true" ]]; then PHASE_SYNC=1; PHASE_PERF=1; PHASE_ENERGY=1; fi
+
+  local t0 t1 ms e0 e1
+  e0=$(rapl_read); t0=$(date +%s%N)
   do_srun --cpu-bind=cores --ntasks=1 --cpus-per-task="${OMP_NUM_THREADS:-1}" \
-          "./$exe" "$INFILE" "$out" "$SEARCH" >"$sout" 2>>"$LOG"
-  t1=$(date +%s%N); ms=$(( (t1 - t0)/1000000 ))
+          "./$exe" "$INFILE" "$out" "$SEARCH" >"$sout" 2>"$serr"
+  t1=$(date +%s%N); e1=$(rapl_read); ms=$(( (t1 - t0)/1000000 ))
+  cat "$serr" >> "$LOG" 2>/dev/null || true
+  local phases; phases=$(phase_fields "$serr")
+  local roof; roof=$(roof_fields "$serr")
+  local energy; energy=$(energy_fields "$e0" "$e1" "$ms" "$serr")
+  local mem; mem=$(mem_fields "$serr")
 
   local md5; md5=$(md5sum "$out" | awk '{print $1}')
 
+  # the search counts must match the gold's line for line, so a broken counter merge
+  # fails even when the image is right
+  local gcounts counts_ok=""
+  if [[ "$method" == "A" ]]; then gcounts="${GOLD_COUNTS_A:-}"; else gcounts="${GOLD_COUNTS_B:-}"; fi
+  if [[ -n "$gcounts" && -f "$gcounts" ]]; then
+    if { grep -E '^\*\* ' "$sout" || true; } | cmp -s - "$gcounts"; then counts_ok=1; else counts_ok=0; fi
+  fi
+
   {
     echo "=== TESTCASE $exe | tag=$tag | OMP_NUM_THREADS=${OMP_NUM_THREADS} OMP_SCHEDULE=${OMP_SCHEDULE:-unset} ==="
     echo "MD5: $md5  (gold: $gold)"
+    case "$counts_ok" in
+      1) echo "Counts: ok ($(wc -l < "$gcounts") entries)" ;;
+      0) echo "Counts: MISMATCH against $gcounts"
+         { grep -E '^\*\* ' "$sout" || true; } | diff "$gcounts" - | head -n 20 || true ;;
+      *) echo "Counts: unchecked (no gold counts)" ;;
+    esac
     echo "Time_ms: $ms"
+    echo "Phases_ms (${PHASE_KEYS[*]}) / transform (${PERF_KEYS[*]}) / sync (${SYNC_KEYS[*]}): ${phases//,/ }"
+    if [[ -n "$e0" ]]; then
+      echo "Energy (${ENERGY_KEYS[*]}): ${energy//,/ }"
+    else
+      echo "Energy: $RAPL_NOTE"
+    fi
+    grep -E '^(PERF|ENERGY|MEMORY|SYNC)' "$serr" 2>/dev/null || true
     grep -E '^\*\* ' "$sout" || echo "(no '**' lines found)"
     echo
   } >> "$LOG"
+  rm -f "$serr"
 
   # CSV line (safe even if OMP_SCHEDULE is unset due to set -u)
   if (( !DRYRUN && !LISTONLY )); then
-    local schedule chunk
-    if [[ -n "${OMP_SCHEDULE-}" ]]; then
-      schedule="${OMP_SCHEDULE%%,*}"
-      if [[ "${OMP_SCHEDULE-}" == *","* ]]; then
-        chunk="${OMP_SCHEDULE##*,}"
-      else
-        chunk="baked"
-      fi
-    else
-      schedule="baked"
-      chunk="baked"
-    fi
-    echo "$exe,$tag,${OMP_NUM_THREADS},$schedule,$chunk,$([[ "$md5" == "$gold" ]] && echo 1 || echo 0),$ms" >> "$RESULTS_CSV"
+    echo "$exe,$tag,${OMP_NUM_THREADS},$(sched_cols),$([[ "$md5" == "$gold" ]] && echo 1 || echo 0),$ms,$phases,$SET_FIELDS,$roof,$counts_ok,$energy,$mem" >> "$RESULTS_CSV"
   fi
 
-  if [[ "$md5" == "$gold" ]]; then
+  if [[ "$md5" == "$gold" && "$counts_ok" != "0" ]]; then
     rm -f "$out" "$sout"
     return 0
   else
@@ -205,13 +462,280 @@ run_case_md5 () {
   fi
 }
 
+# ---------- Repetitions (behaviour.repetitions > 1) ----------
+# Every configuration that passed its verified run above goes into PLAN; afterwards
+# all of them are re-run together: WARMUPS discarded rounds, then REPETITIONS timed
+# rounds, each round in a fresh random order so drift over the job (thermals, clock
+# changes, noisy neighbours) lands on every configuration alike instead of on
+# whichever ran last. Each run goes to repetitions.csv; stats.csv holds the
+# per-tag median, MAD and a bootstrap 95% CI of the median.
+REPS_CSV="$OUTDIR/repetitions.csv"
+REPS_HEADER="exe,tag,threads,schedule,chunk,round,warmup,ok,time_ms,inproc_ms,mhz_mean,mhz_min,mhz_max"
+STATS_CSV="$OUTDIR/stats.csv"
+STATS_HEADER="exe,tag,threads,schedule,chunk,n,median_ms,mad_ms,rel_mad,ci_lo_ms,ci_hi_ms,mhz_median,mhz_spread,unstable"
+MHZ_INTERVAL=${MHZ_INTERVAL:-0.5}   # seconds between clock samples during a run
+PLAN=()
+
+# plan_add <exe> <tag> <threads> <OMP_SCHEDULE or empty>  (on the current input set)
+plan_add() { (( REPETITIONS > 1 )) && PLAN+=("$1|$2|$3|$4|$INFILE|$SEARCH|$1$TAG_SUFFIX") || true; }
+
+# stats_done <tag>  -> exit 0 if tag present in stats.csv
+stats_done() {
+  [[ -f "$STATS_CSV" ]] || return 1
+  awk -F',' -v t="$1" 'NR>1 && $2==t {found=1; exit} END{exit !found}' "$STATS_CSV"
+}
+
+# cpufreq files of the CPUs this job may run on (none in most VMs)
+mapfile -t MHZ_FILES < <(awk -F'[:,[:space:]]+' '/^Cpus_allowed_list/ {
+    for (i=2; i<=NF; ++i) if ($i != "") { n=split($i, r, "-"); for (c=r[1]; c<=r[n]; ++c) print "/sys/devices/system/cpu/cpu" c "/cpufreq/scaling_cur_freq" } }' \
+  /proc/self/status 2>/dev/null | while read -r f; do if [[ -r "$f" ]]; then echo "$f"; fi; done)
+
+# cpu_mhz -> mean current clock (MHz) of those CPUs, else of all CPUs in /proc/cpuinfo
+cpu_mhz() {
+  if (( ${#MHZ_FILES[@]} )); then
+    cat "${MHZ_FILES[@]}" 2>/dev/null | awk '{s+=$1; n++} END {if (n) printf "%.0f\n", s/n/1000}' || true
+  else
+    awk -F': *' '/^cpu MHz/ {s+=$2; n++} END {if (n) printf "%.0f\n", s/n}' /proc/cpuinfo 2>/dev/null || true
+  fi
+}
+
+# --- One repetition: time it, sample the clock while it runs, append to repetitions.csv ---
+run_rep () {
+  local exe="$1" tag="$2" th="$3" sched="$4" infile="$5" search="$6" round="$7" warmup="$8"
+  local out="$OUTDIR/rep.bin" serr="$OUTDIR/rep.stderr" mhz="$OUTDIR/rep.mhz"
+  local -x PHASE_SYNC=0 PHASE_PERF=0 PHASE_ENERGY=0   # timed rounds run uninstrumented
+  export OMP_NUM_THREADS="$th"
+  if [[ -n "$sched" ]]; then export OMP_SCHEDULE="$sched"; else unset OMP_SCHEDULE; fi
+
+  cpu_mhz > "$mhz"
+  ( while sleep "$MHZ_INTERVAL"; do cpu_mhz >> "$mhz"; done ) &
+  local sampler=$! rc=0 t0 t1 ms
+  t0=$(date +%s%N)
+  do_srun --cpu-bind=cores --ntasks=1 --cpus-per-task="$th" \
+          "./$exe" "$infile" "$out" "$search" >/dev/null 2>"$serr" || rc=$?
+  t1=$(date +%s%N); ms=$(( (t1 - t0)/1000000 ))
+  kill "$sampler" 2>/dev/null || true
+  wait "$sampler" 2>/dev/null || true
+  cpu_mhz >> "$mhz"
+
+  local inproc freq
+  inproc=$(sed -n 's/^PHASES .* total_ms=\([^ ]*\).*/\1/p' "$serr" | head -n1)
+  freq=$(awk 'NF {s+=$1; n++; if (min=="" || $1<min) min=$1; if ($1>max) max=$1}
+              END {if (n) printf "%.0f,%.0f,%.0f", s/n, min, max; else printf ",,"}' "$mhz")
+  echo "$exe,$tag,$th,$(sched_cols),$round,$warmup,$(( rc == 0 )),$ms,$inproc,$freq" >> "$REPS_CSV"
+  echo "[REP $round/$(( WARMUPS + REPETITIONS ))$( ((warmup)) && echo ' warmup')] $tag time_ms=$ms mhz=${freq%%,*}$( ((rc)) && echo " FAILED rc=$rc")" >> "$LOG"
+  rm -f "$out" "$serr" "$mhz"
+}
+
+# rep_stats <seed> -> stats.csv content from the timed, successful rows of repetitions.csv.
+# MAD is the raw median absolute deviation; the CI is the 2.5/97.5 percentiles of the
+# median over 2000 bootstrap resamples. A tag is unstable when MAD/median exceeds
+# UNSTABLE_REL_MAD ("mad"), the clock moved by more than that fraction across its
+# runs ("freq"), or it has fewer than 3 timed runs ("few").
+rep_stats() {
+  awk -F',' -v OFS=',' -v seed="$1" -v thr="$UNSTABLE_REL_MAD" -v hdr="$STATS_HEADER" '
+    function sift(a, i, n,   c, t) {
+      while ((c = 2*i) <= n) {
+        if (c < n && a[c+1] > a[c]) c++
+        if (a[i] >= a[c]) return
+        t = a[i]; a[i] = a[c]; a[c] = t; i = c
+      }
+    }
+    function hsort(a, n,   i, t) {
+      for (i = int(n/2); i >= 1; --i) sift(a, i, n)
+      for (i = n; i > 1; --i) { t = a[1]; a[1] = a[i]; a[i] = t; sift(a, 1, i-1) }
+    }
+    function median(a, n) { hsort(a, n); return n % 2 ? a[(n+1)/2] : (a[n/2] + a[n/2+1]) / 2 }
+    NR == 1 { next }
+    $7 == 0 && $8 == 1 {
+      if (!($2 in n)) { order[++ntags] = $2; key[$2] = $1 OFS $2 OFS $3 OFS $4 OFS $5 }
+      t[$2, ++n[$2]] = $9 + 0
+      if ($11 != "") {
+        f[$2, ++nf[$2]] = $11 + 0
+        if (!($2 in fmin) || $12 + 0 < fmin[$2]) fmin[$2] = $12 + 0
+        if (!($2 in fmax) || $13 + 0 > fmax[$2]) fmax[$2] = $13 + 0
+      }
+    }
+    END {
+      srand(seed); B = 2000
+      print hdr
+      for (o = 1; o <= ntags; ++o) {
+        tag = order[o]; c = n[tag]
+        for (i = 1; i <= c; ++i) x[i] = t[tag, i]
+        med = median(x, c)
+        for (i = 1; i <= c; ++i) d[i] = x[i] > med ? x[i] - med : med - x[i]
+        mad = median(d, c)
+        for (b = 1; b <= B; ++b) {
+          for (i = 1; i <= c; ++i) r[i] = x[int(rand() * c) + 1]
+          bm[b] = median(r, c)
+        }
+        hsort(bm, B)
+        rel = med > 0 ? mad / med : 0
+        mhz = ""; spread = ""
+        if (nf[tag]) {
+          for (i = 1; i <= nf[tag]; ++i) y[i] = f[tag, i]
+          mhz = median(y, nf[tag])
+          if (mhz > 0) spread = sprintf("%.3f", (fmax[tag] - fmin[tag]) / mhz)
+        }
+        why = ""
+        if (c < 3) why = why "+few"
+        if (rel > thr) why = why "+mad"
+        if (spread != "" && spread + 0 > thr) why = why "+freq"
+        print key[tag], c, sprintf("%.1f", med), sprintf("%.1f", mad), sprintf("%.4f", rel),
+              sprintf("%.1f", bm[int(0.025*B) + 1]), sprintf("%.1f", bm[int(0.975*B)]),
+              mhz == "" ? "" : sprintf("%.0f", mhz), spread, substr(why, 2)
+      }
+    }' "$REPS_CSV"
+}
+
+run_repetitions () {
+  local plan=() e exe tag th sched infile search label round entry order=()
+  for e in "${PLAN[@]}"; do
+    IFS='|' read -r exe tag th sched infile search label <<<"$e"
+    [[ " ${FAILED_A[*]} ${FAILED_B[*]} " == *" $label "* ]] && continue
+    if (( RESUME )) && stats_done "$tag"; then
+      echo "[SKIP] already in stats.csv: $tag" | tee -a "$LOG"
+      continue
+    fi
+    plan+=("$e")
+  done
+  (( ${#plan[@]} )) || return 0
+
+  # planned tags are measured from scratch: drop their rows from an earlier (killed) job
+  if [[ -f "$REPS_CSV" && "$(head -n1 "$REPS_CSV")" == "$REPS_HEADER" ]]; then
+    printf '%s\n' "${plan[@]}" | cut -d'|' -f2 \
+      | awk -F',' 'NR==FNR {drop[$0]=1; next} FNR==1 || !($2 in drop)' - "$REPS_CSV" > "$REPS_CSV.tmp"
+    mv "$REPS_CSV.tmp" "$REPS_CSV"
+  else
+    echo "$REPS_HEADER" > "$REPS_CSV"
+  fi
+
+  local seed="$SHUFFLE_SEED"
+  (( seed )) || seed=$(date +%s)
+  echo "== Repetitions: ${#plan[@]} configs x ($WARMUPS warmup + $REPETITIONS timed) rounds, shuffle_seed=$seed ==" | tee -a "$LOG"
+  for (( round=1; round <= WARMUPS + REPETITIONS; ++round )); do
+    mapfile -t order < <(printf '%s\n' "${plan[@]}" \
+      | awk -v s="$(( seed + round ))" 'BEGIN {srand(s)} {printf "%.15f\t%s\n", rand(), $0}' \
+      | sort -t$'\t' -k1,1 | cut -f2-)
+    for entry in "${order[@]}"; do
+      IFS='|' read -r exe tag th sched infile search label <<<"$entry"
+      run_rep "$exe" "$tag" "$th" "$sched" "$infile" "$search" "$round" $(( round <= WARMUPS ))
+    done
+    echo "[REP] round $round/$(( WARMUPS + REPETITIONS )) done" | tee -a "$LOG"
+  done
+
+  rep_stats "$seed" > "$STATS_CSV.tmp"
+  mv "$STATS_CSV.tmp" "$STATS_CSV"
+  awk -F',' 'NR>1 && $14 != "" {print "[unstable] " $2 ": median_ms=" $7 " mad_ms=" $8 " ci_ms=[" $10 "," $11 "] mhz_spread=" $13 " (" $14 ")"; u++}
+             END {print "[stats] " NR-1 " tags, " u+0 " unstable"}' "$STATS_CSV" | tee -a "$LOG"
+}
+
 # ---------- Baselines or Provided Golds ----------
-GOLD_A="<unknown>"; GOLD_B="<unknown>"
-USE_GOLD_A=0; USE_GOLD_B=0
+# record_baseline <exe> <tag> <ms> <energy fields> -> results.csv row for a sequential
+# baseline run, the reference that analyse.sh computes speedups against (it is its own
+# gold, so md5_ok=1 and counts_ok=1)
+record_baseline () {
+  if (( RESUME )) && already_done "$2"; then return 0; fi
+  echo "$1,$2,1,$(sched_cols),1,$3,$(phase_fields /dev/null),$SET_FIELDS,$(roof_fields /dev/null),1,$4,$(mem_fields /dev/null)" >> "$RESULTS_CSV"
+  plan_add "$1" "$2" 1 ""
+}
 
-if (( !LISTONLY && !DRYRUN )); then
-  if [[ "${USE_GOLDS}" == "true" ]]; then
-    data_dir="$(dirname "$INFILE")"
+# ---------- Gold cache ----------
+# Golds of a_seq / b_seq (output MD5 + the "** (r,g,b) = n" lines) are kept in
+# GOLD_CACHE_DIR, keyed by the content of the input and search files and the baseline's
+# sources, so later jobs on the same data skip the sequential run. An entry is
+# <key>.md5, <key>.counts and <key>.info (what it was made from); delete the directory,
+# or set inputs.gold_cache=false, to re-run the baselines.
+GOLD_SRC_MD5_A=$( { cat process-a.c rawimage.h 2>/dev/null || true; } | md5sum | awk '{print $1}')
+GOLD_SRC_MD5_B=$( { cat process-b.c rawimage.h 2>/dev/null || true; } | md5sum | awk '{print $1}')
+
+# gold_key <a|b> -> cache key from GOLD_IN_MD5 / GOLD_SEARCH_MD5 (set by compute_golds)
+gold_key () {
+  local src; if [[ "$1" == "a" ]]; then src="$GOLD_SRC_MD5_A"; else src="$GOLD_SRC_MD5_B"; fi
+  echo "$1|$GOLD_IN_MD5|$GOLD_SEARCH_MD5|$src" | md5sum | awk '{print "'"$1"'_" $1}'
+}
+
+# baseline_gold <a|b> -> GOLD_<M>, GOLD_COUNTS_<M> (and BASE_<M>) from the cache, or from
+# a timed <m>_seq run whose gold is then cached
+baseline_gold () {
+  local m="$1" M="${1^^}" key="" entry="" gold t0 t1 e0 e1
+  local base="$OUTDIR/${M}_baseline.bin" sout="$OUTDIR/${M}_baseline.stdout" counts="$OUTDIR/${M}_baseline.counts"
+  if [[ "$GOLD_CACHE" == "true" ]]; then
+    key=$(gold_key "$m"); entry="$GOLD_CACHE_DIR/$key"
+    if [[ -s "$entry.md5" && -f "$entry.counts" ]]; then
+      gold=$(<"$entry.md5")
+      printf -v "GOLD_$M" '%s' "$gold"
+      printf -v "GOLD_COUNTS_$M" '%s' "$entry.counts"
+      echo "[gold] cached $M gold $key: $gold ($(wc -l < "$entry.counts") counts), ${m}_seq not re-run" | tee -a "$LOG"
+      return 0
+    fi
+  fi
+
+  printf -v "BASE_$M" '%s' "$base"
+  e0=$(rapl_read); t0=$(date +%s%N)
+  do_srun --cpus-per-task=1 "./${m}_seq" "$INFILE" "$base" "$SEARCH" > "$sout"
+  t1=$(date +%s%N); e1=$(rapl_read)
+  gold=$(md5sum "$base" | awk '{print $1}')
+  grep -E '^\*\* ' "$sout" > "$counts" || true
+  rm -f "$sout"
+  printf -v "GOLD_$M" '%s' "$gold"
+  printf -v "GOLD_COUNTS_$M" '%s' "$counts"
+  echo "GOLD_$M: $gold" | tee -a "$LOG"
+  record_baseline "${m}_seq" "${M}_seq$TAG_SUFFIX" $(( (t1 - t0)/1000000 )) \
+    "$(energy_fields "$e0" "$e1" $(( (t1 - t0)/1000000 )) /dev/null)"
+  cat "$counts" >> "$LOG"
+
+  if [[ -n "$entry" ]]; then
+    # written under temporary names and renamed, so a concurrent job never reads half an entry
+    mkdir -p "$GOLD_CACHE_DIR"
+    { echo "method=$M"; echo "input=$INFILE md5=$GOLD_IN_MD5"; echo "search=$SEARCH md5=$GOLD_SEARCH_MD5"
+      echo "sources=process-$m.c+rawimage.h"; echo "created=$(date -Is) host=$(hostname)"; } > "$entry.info.$$"
+    cp "$counts" "$entry.counts.$$"
+    echo "$gold" > "$entry.md5.$$"
+    mv "$entry.info.$$" "$entry.info"; mv "$entry.counts.$$" "$entry.counts"; mv "$entry.md5.$$" "$entry.md5"
+    printf -v "GOLD_COUNTS_$M" '%s' "$entry.counts"
+    echo "[gold] cached $M gold as $key" | tee -a "$LOG"
+  fi
+}
+
+# baseline_pgo <a|b> -> a timed <m>_seq_pgo run (build.pgo), recorded as <M>_seq_pgo next to
+# the plain baseline when its output and counts match the gold, so the _pgo variants have
+# a PGO reference too (analyse.sh pairs it with <M>_seq like any other _pgo tag)
+baseline_pgo () {
+  local m="$1" M="${1^^}" exe="${1}_seq${PGO_SUFFIX}"
+  local tag="${M}_seq${PGO_SUFFIX}$TAG_SUFFIX" out="$OUTDIR/${M}_baseline${PGO_SUFFIX}.bin"
+  local sout="$OUTDIR/${M}_baseline${PGO_SUFFIX}.stdout" goldvar="GOLD_$M" countsvar="GOLD_COUNTS_$M"
+  local gold="${!goldvar}" counts="${!countsvar}" md5 t0 t1 e0 e1
+  [[ -x "$exe" ]] || return 0
+  if (( RESUME )) && already_done "$tag"; then return 0; fi
+
+  e0=$(rapl_read); t0=$(date +%s%N)
+  do_srun --cpus-per-task=1 "./$exe" "$INFILE" "$out" "$SEARCH" > "$sout"
+  t1=$(date +%s%N); e1=$(rapl_read)
+  md5=$(md5sum "$out" | awk '{print $1}')
+  if [[ "$md5" != "$gold" ]] || { [[ -n "$counts" && -f "$counts" ]] && ! { grep -E '^\*\* ' "$sout" || true; } | cmp -s - "$counts"; }; then
+    echo "[gold] !! $exe: output or counts differ from ${m}_seq, $tag not recorded" | tee -a "$LOG"
+  else
+    echo "[gold] $exe matches ${m}_seq: $tag $(( (t1 - t0)/1000000 )) ms" | tee -a "$LOG"
+    record_baseline "$exe" "$tag" $(( (t1 - t0)/1000000 )) \
+      "$(energy_fields "$e0" "$e1" $(( (t1 - t0)/1000000 )) /dev/null)"
+  fi
+  rm -f "$out" "$sout"
+}
+
+# compute_golds -> GOLD_A / GOLD_B (and their counts) for the current INFILE / SEARCH
+compute_golds () {
+  GOLD_A="<unknown>"; GOLD_B="<unknown>"; GOLD_COUNTS_A=""; GOLD_COUNTS_B=""
+  USE_GOLD_A=0; USE_GOLD_B=0
+  (( !LISTONLY && !DRYRUN )) || return 0
+  if [[ "$GOLD_CACHE" == "true" ]]; then
+    GOLD_IN_MD5=$(md5sum "$INFILE" | awk '{print $1}')
+    GOLD_SEARCH_MD5=$(md5sum "$SEARCH" | awk '{print $1}')
+  fi
+
+  # provided golds belong to the dataset input, never to a generated one
+  if [[ "${USE_GOLDS}" == "true" && -z "$SET_PIXELS$SET_SEARCH" ]]; then
+    local data_dir; data_dir="$(dirname "$INFILE")"
 
     if [[ "$CASE_SEL" != "b" ]]; then
       GOLD_A_FILE=$(find "$data_dir" -maxdepth 1 -iregex '.*(output.*-a|.*-a\.raw|.*-a\.bin)$' -print | head -n1 || true)
@@ -229,31 +753,29 @@ if (( !LISTONLY && !DRYRUN )); then
         echo "[gold] Using provided B gold: $(basename "$GOLD_B_FILE") -> $GOLD_B" | tee -a "$LOG"
       fi
     fi
+    # provided golds carry no counts; a cached entry with the same MD5 supplies them
+    local m M entry
+    for m in a b; do
+      M="${m^^}"; [[ "$(eval echo "\$USE_GOLD_$M")" -eq 1 && "$GOLD_CACHE" == "true" ]] || continue
+      entry="$GOLD_CACHE_DIR/$(gold_key "$m")"
+      if [[ -f "$entry.counts" && "$(cat "$entry.md5" 2>/dev/null)" == "$(eval echo "\$GOLD_$M")" ]]; then
+        printf -v "GOLD_COUNTS_$M" '%s' "$entry.counts"
+      else
+        echo "[gold] no cached counts for the provided $M gold: counts unchecked" | tee -a "$LOG"
+      fi
+    done
   fi
 
-  echo "== Baselines (sequential) ==" | tee -a "$LOG"
+  echo "== Baselines (sequential) ${SET_LABEL:+[$SET_LABEL]} ==" | tee -a "$LOG"
   export OMP_NUM_THREADS=1
   unset OMP_SCHEDULE
 
-  if [[ "$CASE_SEL" != "b" && "$USE_GOLD_A" -eq 0 ]]; then
-    BASE_A="$OUTDIR/A_baseline.bin"
-    do_srun --cpus-per-task=1 ./a_seq "$INFILE" "$BASE_A" "$SEARCH" > "$OUTDIR/A_baseline.stdout"
-    GOLD_A=$(md5sum "$BASE_A" | awk '{print $1}')
-    echo "GOLD_A: $GOLD_A" | tee -a "$LOG"
-    grep -E '^\*\* ' "$OUTDIR/A_baseline.stdout" >> "$LOG" || true
-    rm -f "$OUTDIR/A_baseline.stdout"
-  fi
-
-  if [[ "$CASE_SEL" != "a" && "$USE_GOLD_B" -eq 0 ]]; then
-    BASE_B="$OUTDIR/B_baseline.bin"
-    do_srun --cpus-per-task=1 ./b_seq "$INFILE" "$BASE_B" "$SEARCH" > "$OUTDIR/B_baseline.stdout"
-    GOLD_B=$(md5sum "$BASE_B" | awk '{print $1}')
-    echo "GOLD_B: $GOLD_B" | tee -a "$LOG"
-    grep -E '^\*\* ' "$OUTDIR/B_baseline.stdout" >> "$LOG" || true
-    rm -f "$OUTDIR/B_baseline.stdout"
-  fi
+  if [[ "$CASE_SEL" != "b" && "$USE_GOLD_A" -eq 0 ]]; then baseline_gold a; fi
+  if [[ "$CASE_SEL" != "a" && "$USE_GOLD_B" -eq 0 ]]; then baseline_gold b; fi
+  if [[ "$CASE_SEL" != "b" ]]; then baseline_pgo a; fi
+  if [[ "$CASE_SEL" != "a" ]]; then baseline_pgo b; fi
   echo >> "$LOG"
-fi
+}
 
 # ---------- Discover built executables ----------
 shopt -s nullglob
@@ -275,18 +797,79 @@ echo "Found built Method A executables: ${#ALL_A[@]} -> ${ALL_A[*]:-(none)}" | t
 echo "Found built Method B executables: ${#ALL_B[@]} -> ${ALL_B[*]:-(none)}" | tee -a "$LOG"
 echo >> "$LOG"
 
-is_baked () { [[ "$1" =~ _ ]]; }  # contains underscore after tcN
+# build.pgo flavour: <exe>_pgo runs like <exe> and its tags end in _pgo (before any set suffix)
+PGO_SUFFIX="_pgo"
+flavour_of () { [[ "$1" == *"$PGO_SUFFIX" ]] && echo "$PGO_SUFFIX" || true; }
+
+is_baked () { [[ "${1%$PGO_SUFFIX}" =~ _ ]]; }  # contains underscore after tcN
+
+# config_tag <method> <tc> <threads> <schedule part> -> results.csv tag on the current input set
+config_tag () { printf "%s_tc%s_t%s_%s%s" "${1^^}" "$2" "$3" "$4" "$TAG_SUFFIX"; }
 
 PASSED_A=(); FAILED_A=()
 PASSED_B=(); FAILED_B=()
 
+# ---------- Input sets (matrix.pixels x matrix.search_sizes, weak scaling) ----------
+# Each set is "pixels|search|scaling|threads". Empty pixels and search mean the
+# dataset's own files; otherwise ab_gen writes the input, taking any empty dimension
+# from the dataset. Strong-scaling sets run every thread count on one input; weak
+# sets give each thread count its own input of weak_pixels_per_thread x threads.
+DATA_INFILE="$INFILE"; DATA_SEARCH="$SEARCH"
+DATA_PIXELS=$(( $(stat -c %s "$INFILE") / 12 ))
+DATA_SEARCH_LEN=$(( $(stat -c %s "$SEARCH") / 12 ))
+GEN_DIR="$OUTDIR/gen"
+(( ${#PIXELS[@]} ))       || PIXELS=("")
+(( ${#SEARCH_SIZES[@]} )) || SEARCH_SIZES=("")
+INPUT_SETS=()
+for n in "${PIXELS[@]}"; do
+  for ss in "${SEARCH_SIZES[@]}"; do INPUT_SETS+=("$n|$ss|strong|all"); done
+done
+if (( WEAK_PIXELS_PER_THREAD > 0 )); then
+  for t in "${THREADS[@]}"; do
+    for ss in "${SEARCH_SIZES[@]}"; do INPUT_SETS+=("$(( WEAK_PIXELS_PER_THREAD * t ))|$ss|weak|$t"); done
+  done
+fi
+if [[ "$SWEEP_MODE" == "halving" && "${INPUT_SETS[*]}" != "||strong|all" ]]; then
+  echo "sweep.mode=halving prunes on prefixes of the dataset input: leave matrix.pixels, search_sizes and weak_pixels_per_thread empty"; exit 2
+fi
+if [[ "${INPUT_SETS[*]}" != "||strong|all" ]]; then
+  ((LISTONLY || DRYRUN)) || [[ -x ab_gen ]] || { echo "ab_gen missing (needed for matrix.pixels / search_sizes / weak scaling)"; exit 1; }
+  echo "[cfg] input sets: ${#INPUT_SETS[@]} (pixels: ${PIXELS[*]:-dataset}; search: ${SEARCH_SIZES[*]:-dataset}; weak: ${WEAK_PIXELS_PER_THREAD}/thread)" | tee -a "$LOG"
+fi
+
+# prepare_input_set -> INFILE / SEARCH, TAG_SUFFIX, SET_LABEL and the results.csv SET_FIELDS
+# for SET_PIXELS / SET_SEARCH / SCALING
+prepare_input_set () {
+  if [[ -z "$SET_PIXELS$SET_SEARCH" && "$SCALING" == "strong" ]]; then
+    INFILE="$DATA_INFILE"; SEARCH="$DATA_SEARCH"; TAG_SUFFIX=""
+  else
+    local n="${SET_PIXELS:-$DATA_PIXELS}" ss="${SET_SEARCH:-$DATA_SEARCH_LEN}"
+    TAG_SUFFIX="_n${n}_s${ss}"
+    if [[ "$SCALING" == "weak" ]]; then TAG_SUFFIX="_weak$TAG_SUFFIX"; fi
+    INFILE="$GEN_DIR/n${n}_s${ss}-input.raw"; SEARCH="$GEN_DIR/n${n}_s${ss}-search.raw"
+    if (( !LISTONLY && !DRYRUN )) && [[ ! -f "$INFILE" || ! -f "$SEARCH" ]]; then
+      mkdir -p "$GEN_DIR"
+      # shellcheck disable=SC2086  # GEN_ARGS is a list of ab_gen options
+      ./ab_gen -n "$n" -s "$ss" $GEN_ARGS "$INFILE" "$SEARCH" | tail -n1 | tee -a "$LOG"
+    fi
+  fi
+  SET_LABEL="${TAG_SUFFIX#_}"
+  if [[ -f "$INFILE" && -f "$SEARCH" ]]; then
+    SET_FIELDS="$(( $(stat -c %s "$INFILE") / 12 )),$(( $(stat -c %s "$SEARCH") / 12 )),$SCALING"
+  else
+    SET_FIELDS=",,$SCALING"
+  fi
+  [[ -z "$SET_LABEL" ]] || echo "== Input set $SET_LABEL: $(basename "$INFILE") / $(basename "$SEARCH") ==" | tee -a "$LOG"
+}
+
 run_matrix_driven () {
   local exe="$1" method="$2" gold="$3"
-  local tc="${exe##${method}_tc}"
+  local fl; fl="$(flavour_of "$exe")"
+  local tc="${exe%$fl}"; tc="${tc##${method}_tc}"
   local fail=0
   local first_run=1
 
-  for th in "${THREADS[@]}"; do
+  for th in "${RUN_THREADS[@]}"; do
     ((fail)) && break
     export OMP_NUM_THREADS="$th"
     for sch in "${SCHEDULES[@]}"; do
@@ -308,12 +891,13 @@ run_matrix_driven () {
         fi
 
         local tag
-        tag="$(printf "%s_tc%s_t%s_%s" "${method^^}" "$tc" "$th" "$sched_tag")"
+        tag="$(config_tag "$method" "$tc" "$th" "$sched_tag$fl")"
         echo "[${method^^}] $exe -> $tag" | tee -a "$LOG"
 
         # Resume: skip if tag already recorded
         if (( RESUME )) && already_done "$tag"; then
           echo "[SKIP] already in results.csv: $tag" | tee -a "$LOG"
+          plan_add "$exe" "$tag" "$th" "$OMP_SCHEDULE"
           continue
         fi
 
@@ -326,41 +910,45 @@ run_matrix_driven () {
         if (( first_run || VERIFY_EACH_CONFIG )); then
           if run_case_md5 "$exe" "${method^^}" "$tag" "$gold"; then
             first_run=0
+            plan_add "$exe" "$tag" "$th" "$OMP_SCHEDULE"
           else
-            echo "[${method^^}] MD5 FAIL for $exe ($tag).$( ((STOP_ON_TESTCASE_FAIL)) && echo ' Stopping remaining configs for this testcase.' )" | tee -a "$LOG"
+            echo "[${method^^}] MD5/counts FAIL for $exe ($tag).$( ((STOP_ON_TESTCASE_FAIL)) && echo ' Stopping remaining configs for this testcase.' )" | tee -a "$LOG"
             ((STOP_ON_TESTCASE_FAIL)) && fail=1
             ((STRICT_MD5)) && { echo "[${method^^}] STRICT mode aborting whole job." | tee -a "$LOG"; exit 2; }
           fi
         else
           do_srun --cpu-bind=cores --ntasks=1 --cpus-per-task="$th" "./$exe" "$INFILE" /dev/null "$SEARCH" >/dev/null 2>&1
+          plan_add "$exe" "$tag" "$th" "$OMP_SCHEDULE"
         fi
       done
     done
   done
 
   if [[ "$method" == "a" ]]; then
-    ((fail)) && FAILED_A+=("$exe") || PASSED_A+=("$exe")
+    ((fail)) && FAILED_A+=("$exe$TAG_SUFFIX") || PASSED_A+=("$exe$TAG_SUFFIX")
   else
-    ((fail)) && FAILED_B+=("$exe") || PASSED_B+=("$exe")
+    ((fail)) && FAILED_B+=("$exe$TAG_SUFFIX") || PASSED_B+=("$exe$TAG_SUFFIX")
   fi
 }
 
 run_baked () {
   local exe="$1" method="$2" gold="$3"
+  local fl; fl="$(flavour_of "$exe")"
   local tc="${exe##${method}_tc}"; tc="${tc%%_*}"
-  local suffix="${exe#${method}_tc${tc}_}"
+  local suffix="${exe%$fl}"; suffix="${suffix#${method}_tc${tc}_}$fl"
   local fail=0
 
-  for th in "${THREADS[@]}"; do
+  for th in "${RUN_THREADS[@]}"; do
     export OMP_NUM_THREADS="$th"
     unset OMP_SCHEDULE
     local tag
-    tag="$(printf "%s_tc%s_t%s_%s" "${method^^}" "$tc" "$th" "$suffix")"
+    tag="$(config_tag "$method" "$tc" "$th" "$suffix")"
     echo "[${method^^}] $exe -> $tag" | tee -a "$LOG"
 
     # Resume: skip if tag already recorded
     if (( RESUME )) && already_done "$tag"; then
       echo "[SKIP] already in results.csv: $tag" | tee -a "$LOG"
+      plan_add "$exe" "$tag" "$th" ""
       continue
     fi
 
@@ -371,45 +959,294 @@ run_baked () {
     fi
 
     if run_case_md5 "$exe" "${method^^}" "$tag" "$gold"; then
-      :
+      plan_add "$exe" "$tag" "$th" ""
     else
-      echo "[${method^^}] MD5 FAIL for $exe ($tag).$( ((STOP_ON_TESTCASE_FAIL)) && echo ' Stopping remaining threads for this testcase.' )" | tee -a "$LOG"
+      echo "[${method^^}] MD5/counts FAIL for $exe ($tag).$( ((STOP_ON_TESTCASE_FAIL)) && echo ' Stopping remaining threads for this testcase.' )" | tee -a "$LOG"
       ((STOP_ON_TESTCASE_FAIL)) && { fail=1; break; }
       ((STRICT_MD5)) && { echo "[${method^^}] STRICT mode aborting whole job." | tee -a "$LOG"; exit 2; }
     fi
   done
 
   if [[ "$method" == "a" ]]; then
-    ((fail)) && FAILED_A+=("$exe") || PASSED_A+=("$exe")
+    ((fail)) && FAILED_A+=("$exe$TAG_SUFFIX") || PASSED_A+=("$exe$TAG_SUFFIX")
   else
-    ((fail)) && FAILED_B+=("$exe") || PASSED_B+=("$exe")
+    ((fail)) && FAILED_B+=("$exe$TAG_SUFFIX") || PASSED_B+=("$exe$TAG_SUFFIX")
   fi
 }
 
-# --- Execute ---
-for exe in "${ALL_A[@]}"; do
-  [[ -x "$exe" ]] || continue
-  if is_baked "$exe"; then run_baked "$exe" "a" "$GOLD_A"; else run_matrix_driven "$exe" "a" "$GOLD_A"; fi
-done
-for exe in "${ALL_B[@]}"; do
-  [[ -x "$exe" ]] || continue
-  if is_baked "$exe"; then run_baked "$exe" "b" "$GOLD_B"; else run_matrix_driven "$exe" "b" "$GOLD_B"; fi
+# ---------- Successive halving (sweep.mode = halving) ----------
+# Rather than timing every configuration (executable x threads x schedule/chunk) on the
+# full input, all of them first run on a prefix of the input; the fastest 1/eta of each
+# method move on to a prefix eta times longer, and so on, until at most sweep.keep per
+# method remain. Those then run on the full input exactly like a full sweep (results.csv
+# rows, counts check, repetitions, analysis). Rung runs are checked against a_seq/b_seq on the same prefix
+# and ranked by the median in-process total (PHASES total_ms, wall time where missing)
+# of sweep.repetitions runs, so launch overhead does not swamp the short inputs. Every
+# rung is logged, and each candidate's time and fate goes to sweep.csv.
+SWEEP_CSV="$OUTDIR/sweep.csv"
+SWEEP_HEADER="rung,rungs,pixels,tag,exe,threads,schedule,chunk,runs,median_ms,ok,decision"
+
+# sweep_candidates -> "method|exe|threads|OMP_SCHEDULE|tag" for every configuration
+sweep_candidates () {
+  local m exe tc fl sfx th sch chk list=()
+  for m in a b; do
+    if [[ "$m" == "a" ]]; then list=("${ALL_A[@]}"); else list=("${ALL_B[@]}"); fi
+    for exe in "${list[@]}"; do
+      [[ -x "$exe" ]] || continue
+      fl="$(flavour_of "$exe")"; tc="${exe%$fl}"; tc="${tc##${m}_tc}"
+      if is_baked "$exe"; then
+        sfx="${exe%$fl}"; sfx="${sfx#${m}_tc${tc%%_*}_}$fl"
+        for th in "${RUN_THREADS[@]}"; do echo "$m|$exe|$th||$(config_tag "$m" "${tc%%_*}" "$th" "$sfx")"; done
+        continue
+      fi
+      for th in "${RUN_THREADS[@]}"; do
+        for sch in "${SCHEDULES[@]}"; do
+          for chk in "${CHUNKS[@]}"; do
+            [[ "$sch" == "auto" && -n "$chk" ]] && continue
+            echo "$m|$exe|$th|$sch${chk:+,$chk}|$(config_tag "$m" "$tc" "$th" "$sch$chk$fl")"
+          done
+        done
+      done
+    done
+  done
+}
+
+# sweep_run <exe> <threads> <OMP_SCHEDULE> <input> <gold> -> "<ms> <ok>" for one rung run
+sweep_run () {
+  local out="$OUTDIR/sweep.bin" serr="$OUTDIR/sweep.stderr" rc=0 t0 t1 ms ok=0
+  export OMP_NUM_THREADS="$2"
+  if [[ -n "$3" ]]; then export OMP_SCHEDULE="$3"; else unset OMP_SCHEDULE; fi
+  t0=$(date +%s%N)
+  do_srun --cpu-bind=cores --ntasks=1 --cpus-per-task="$2" "./$1" "$4" "$out" "$SEARCH" >/dev/null 2>"$serr" || rc=$?
+  t1=$(date +%s%N)
+  ms=$(sed -n 's/^PHASES .* total_ms=\([^ ]*\).*/\1/p' "$serr" | head -n1)
+  [[ -n "$ms" ]] || ms=$(( (t1 - t0)/1000000 ))
+  if (( rc == 0 )) && [[ -f "$out" && "$(md5sum "$out" | awk '{print $1}')" == "$5" ]]; then ok=1; fi
+  rm -f "$out" "$serr"
+  echo "$ms $ok"
+}
+
+# sweep_failed <method> <exe> -> record the executable as failed (once)
+sweep_failed () {
+  if [[ "$1" == "a" ]]; then
+    [[ " ${FAILED_A[*]} " == *" $2$TAG_SUFFIX "* ]] || FAILED_A+=("$2$TAG_SUFFIX")
+  else
+    [[ " ${FAILED_B[*]} " == *" $2$TAG_SUFFIX "* ]] || FAILED_B+=("$2$TAG_SUFFIX")
+  fi
+}
+
+# run_halving -> eliminate on input prefixes, then run the survivors on the full input
+run_halving () {
+  local cands=() c m exe th sched tag
+  mapfile -t cands < <(sweep_candidates)
+  # A and B are ranked separately; the larger pool sets the number of rungs
+  local -A pool=([a]=0 [b]=0) keep=() rank=() cutoff=()
+  for c in "${cands[@]}"; do pool[${c%%|*}]=$(( pool[${c%%|*}] + 1 )); done
+  local n=$(( pool[a] > pool[b] ? pool[a] : pool[b] )) rungs=0
+  while (( n > SWEEP_KEEP )); do n=$(( (n + SWEEP_ETA - 1) / SWEEP_ETA )); rungs=$(( rungs + 1 )); done
+  echo "== Successive halving: ${#cands[@]} candidates (A ${pool[a]}, B ${pool[b]}), $rungs elimination rung(s), eta=$SWEEP_ETA keep=$SWEEP_KEEP per method ==" | tee -a "$LOG"
+  if (( !LISTONLY && !DRYRUN )) && [[ ! -f "$SWEEP_CSV" || "$(head -n1 "$SWEEP_CSV")" != "$SWEEP_HEADER" ]]; then
+    echo "$SWEEP_HEADER" > "$SWEEP_CSV"
+  fi
+
+  local r px div prefix gold_a gold_b scored ms ok k med failed_exes=" " line
+  for (( r=1; r<=rungs; ++r )); do
+    # rung r of R runs on 1/eta^(R-r+1) of the input: the last elimination rung on 1/eta
+    div=1; for (( k=r; k<=rungs; ++k )); do div=$(( div * SWEEP_ETA )); done
+    px=$(( DATA_PIXELS / div / 1000 * 1000 ))
+    (( px >= SWEEP_MIN_PIXELS )) || px=$SWEEP_MIN_PIXELS
+    (( px <= DATA_PIXELS )) || px=$DATA_PIXELS
+    pool=([a]=0 [b]=0)
+    for c in "${cands[@]}"; do pool[${c%%|*}]=$(( pool[${c%%|*}] + 1 )); done
+    for m in a b; do
+      keep[$m]=$(( (pool[$m] + SWEEP_ETA - 1) / SWEEP_ETA ))
+      (( keep[$m] >= SWEEP_KEEP )) || keep[$m]=$SWEEP_KEEP
+    done
+    echo "[sweep] rung $r/$rungs: ${#cands[@]} candidates on $px of $DATA_PIXELS pixels, $SWEEP_REPS run(s) each, keeping A ${keep[a]} / B ${keep[b]}" | tee -a "$LOG"
+    if (( LISTONLY || DRYRUN )); then
+      rank=([a]=0 [b]=0); local listed=()
+      for c in "${cands[@]}"; do
+        m="${c%%|*}"; rank[$m]=$(( rank[$m] + 1 ))
+        if (( rank[$m] <= keep[$m] )); then listed+=("$c"); fi
+      done
+      cands=("${listed[@]}")
+      continue
+    fi
+
+    # the prefix and its golds (a_seq / b_seq on the same prefix)
+    mkdir -p "$GEN_DIR"
+    prefix="$GEN_DIR/sweep_n${px}-input.raw"
+    head -c $(( px * 12 )) "$INFILE" > "$prefix"
+    gold_a=""; gold_b=""
+    export OMP_NUM_THREADS=1; unset OMP_SCHEDULE
+    if [[ "$CASE_SEL" != "b" ]]; then
+      do_srun --cpus-per-task=1 ./a_seq "$prefix" "$OUTDIR/sweep_gold.bin" "$SEARCH" > /dev/null
+      gold_a=$(md5sum "$OUTDIR/sweep_gold.bin" | awk '{print $1}')
+    fi
+    if [[ "$CASE_SEL" != "a" ]]; then
+      do_srun --cpus-per-task=1 ./b_seq "$prefix" "$OUTDIR/sweep_gold.bin" "$SEARCH" > /dev/null
+      gold_b=$(md5sum "$OUTDIR/sweep_gold.bin" | awk '{print $1}')
+    fi
+    rm -f "$OUTDIR/sweep_gold.bin"
+
+    scored=()
+    for c in "${cands[@]}"; do
+      IFS='|' read -r m exe th sched tag <<<"$c"
+      [[ "$failed_exes" == *" $exe "* ]] && continue
+      local times=()
+      ok=1
+      for (( k=0; k<SWEEP_REPS; ++k )); do
+        read -r ms ok < <(sweep_run "$exe" "$th" "$sched" "$prefix" "$( [[ "$m" == "a" ]] && echo "$gold_a" || echo "$gold_b")")
+        times+=("$ms")
+        (( ok )) || break
+      done
+      med=$(printf '%s\n' "${times[@]}" | sort -g | awk '{a[NR]=$1} END {print (NR % 2) ? a[(NR+1)/2] : (a[NR/2] + a[NR/2+1]) / 2}')
+      if (( ok )); then
+        scored+=("$med|$c")
+      else
+        echo "[sweep] FAIL $tag: output differs from ${m}_seq on the $px-pixel prefix" | tee -a "$LOG"
+        echo "$r,$rungs,$px,$tag,$exe,$th,$(OMP_SCHEDULE="$sched" sched_cols),${#times[@]},$med,0,fail" >> "$SWEEP_CSV"
+        sweep_failed "$m" "$exe"
+        if (( STRICT_MD5 )); then echo "[${m^^}] STRICT mode aborting whole job." | tee -a "$LOG"; exit 2; fi
+        if (( STOP_ON_TESTCASE_FAIL )); then failed_exes+="$exe "; fi
+      fi
+    done
+
+    # rank by median time within each method; the first keep[method] survive
+    cands=(); rank=([a]=0 [b]=0); cutoff=([a]="-" [b]="-")
+    while IFS= read -r line; do
+      [[ -n "$line" ]] || continue
+      ms="${line%%|*}"; c="${line#*|}"
+      IFS='|' read -r m exe th sched tag <<<"$c"
+      [[ "$failed_exes" == *" $exe "* ]] && continue
+      rank[$m]=$(( rank[$m] + 1 ))
+      if (( rank[$m] <= keep[$m] )); then cands+=("$c"); cutoff[$m]="$ms"; k=1; else k=0; fi
+      echo "$r,$rungs,$px,$tag,$exe,$th,$(OMP_SCHEDULE="$sched" sched_cols),$SWEEP_REPS,$ms,1,$( (( k )) && echo keep || echo cut)" >> "$SWEEP_CSV"
+      printf '[sweep]   %-4s %10.3f ms  %s\n' "$( (( k )) && echo keep || echo cut)" "$ms" "$tag" >> "$LOG"
+    done < <(printf '%s\n' "${scored[@]}" | sort -t'|' -k1,1g)
+    echo "[sweep] rung $r/$rungs done: kept ${#cands[@]} of ${#scored[@]} passing (slowest kept: A ${cutoff[a]} ms, B ${cutoff[b]} ms)" | tee -a "$LOG"
+    rm -f "$prefix"
+  done
+
+  # the survivors, on the full input like a full sweep
+  echo "[sweep] full input: ${#cands[@]} candidate(s): $(printf '%s\n' "${cands[@]}" | cut -d'|' -f5 | tr '\n' ' ')" | tee -a "$LOG"
+  local gold final_ok
+  for c in "${cands[@]}"; do
+    IFS='|' read -r m exe th sched tag <<<"$c"
+    [[ "$failed_exes" == *" $exe "* ]] && continue
+    export OMP_NUM_THREADS="$th"
+    if [[ -n "$sched" ]]; then export OMP_SCHEDULE="$sched"; else unset OMP_SCHEDULE; fi
+    echo "[${m^^}] $exe -> $tag" | tee -a "$LOG"
+    if (( RESUME )) && already_done "$tag"; then
+      echo "[SKIP] already in results.csv: $tag" | tee -a "$LOG"
+      plan_add "$exe" "$tag" "$th" "$sched"
+      continue
+    fi
+    if (( LISTONLY )); then continue; fi
+    if (( DRYRUN )); then
+      do_srun --cpu-bind=cores --ntasks=1 --cpus-per-task="$th" "./$exe" "$INFILE" /dev/null "$SEARCH" >/dev/null 2>&1
+      continue
+    fi
+    if [[ "$m" == "a" ]]; then gold="$GOLD_A"; else gold="$GOLD_B"; fi
+    final_ok=1
+    if run_case_md5 "$exe" "${m^^}" "$tag" "$gold"; then
+      plan_add "$exe" "$tag" "$th" "$sched"
+    else
+      final_ok=0
+      echo "[${m^^}] MD5/counts FAIL for $exe ($tag)." | tee -a "$LOG"
+      sweep_failed "$m" "$exe"
+      ((STRICT_MD5)) && { echo "[${m^^}] STRICT mode aborting whole job." | tee -a "$LOG"; exit 2; }
+      if (( STOP_ON_TESTCASE_FAIL )); then failed_exes+="$exe "; fi
+    fi
+    echo "$(( rungs + 1 )),$rungs,$DATA_PIXELS,$tag,$exe,$th,$(sched_cols),$REPETITIONS,$(tail -n1 "$RESULTS_CSV" | cut -d',' -f7),$final_ok,final" >> "$SWEEP_CSV"
+  done
+
+  # every executable that did not fail counts as passed, pruned or not
+  for exe in "${ALL_A[@]}"; do
+    [[ " ${FAILED_A[*]} " == *" $exe$TAG_SUFFIX "* ]] || PASSED_A+=("$exe$TAG_SUFFIX")
+  done
+  for exe in "${ALL_B[@]}"; do
+    [[ " ${FAILED_B[*]} " == *" $exe$TAG_SUFFIX "* ]] || PASSED_B+=("$exe$TAG_SUFFIX")
+  done
+}
+
+# --- Roofline calibration: sustainable bandwidth and integer throughput of this allocation ---
+ROOFLINE_TXT="$OUTDIR/roofline.txt"
+if (( !LISTONLY && !DRYRUN )) && [[ "$ROOFLINE" == "true" ]]; then
+  if (( RESUME )) && grep -q '^ROOF summary ' "$ROOFLINE_TXT" 2>/dev/null; then
+    echo "[SKIP] roofline already calibrated: $ROOFLINE_TXT" | tee -a "$LOG"
+  elif [[ -x ab_roofline ]]; then
+    echo "== Roofline calibration ==" | tee -a "$LOG"
+    ( unset OMP_SCHEDULE; do_srun --ntasks=1 --cpus-per-task="$( (( MAX_CPUS > 0 )) && echo "$MAX_CPUS" || nproc)" ./ab_roofline > "$ROOFLINE_TXT" )
+    tee -a "$LOG" < "$ROOFLINE_TXT"
+  else
+    echo "[roofline] ab_roofline missing; no calibration" | tee -a "$LOG"
+  fi
+fi
+
+# --- Execute (once per input set) ---
+for set in "${INPUT_SETS[@]}"; do
+  IFS='|' read -r SET_PIXELS SET_SEARCH SCALING set_threads <<<"$set"
+  prepare_input_set
+  if [[ "$set_threads" == "all" ]]; then RUN_THREADS=("${THREADS[@]}"); else RUN_THREADS=("$set_threads"); fi
+  compute_golds
+
+  if [[ "$SWEEP_MODE" == "halving" ]]; then
+    run_halving
+    if (( !LISTONLY )); then rm -f "${BASE_A:-}" "${BASE_B:-}" "$OUTDIR/A_baseline.counts" "$OUTDIR/B_baseline.counts"; fi
+    continue
+  fi
+  for exe in "${ALL_A[@]}"; do
+    [[ -x "$exe" ]] || continue
+    if is_baked "$exe"; then run_baked "$exe" "a" "$GOLD_A"; else run_matrix_driven "$exe" "a" "$GOLD_A"; fi
+  done
+  for exe in "${ALL_B[@]}"; do
+    [[ -x "$exe" ]] || continue
+    if is_baked "$exe"; then run_baked "$exe" "b" "$GOLD_B"; else run_matrix_driven "$exe" "b" "$GOLD_B"; fi
+  done
+
+  # Clean baseline artifacts (skip in list mode)
+  if (( !LISTONLY )); then rm -f "${BASE_A:-}" "${BASE_B:-}" "$OUTDIR/A_baseline.counts" "$OUTDIR/B_baseline.counts"; fi
 done
+INFILE="$DATA_INFILE"; SEARCH="$DATA_SEARCH"
+
+if (( !LISTONLY && !DRYRUN )); then run_repetitions; fi
 
-# Clean baseline artifacts (skip in list mode)
-if (( !LISTONLY )); then rm -f "${BASE_A:-}" "${BASE_B:-}"; fi
+# Generated inputs are cheap to recreate; keep them only if asked
+if [[ -d "$GEN_DIR" && "$KEEP_GENERATED" != "true" ]]; then rm -rf "$GEN_DIR"; fi
+
+# Scaling report, plus the regression check when analysis.baseline names a results.csv;
+# a regression marks the job (status REGRESSION, exit 1) once the summary is out
+REGRESSED=0
+if (( !LISTONLY && !DRYRUN )) && [[ -f analyse.sh && -f "$RESULTS_CSV" ]]; then
+  analyse_args=(-o "$OUTDIR/analysis" -t "$REGRESSION_PCT")
+  if [[ -n "$ANALYSIS_BASELINE" ]]; then analyse_args+=(-b "$ANALYSIS_BASELINE"); fi
+  if [[ -n "$REGRESSION_THRESHOLDS" ]]; then analyse_args+=(-T "$REGRESSION_THRESHOLDS"); fi
+  if [[ -f "$ROOFLINE_TXT" ]]; then analyse_args+=(-r "$ROOFLINE_TXT"); fi
+  rc=0
+  bash analyse.sh "${analyse_args[@]}" "$RESULTS_CSV" | tee -a "$LOG" || rc=$?
+  if (( rc == 1 )); then REGRESSED=1; JOB_STATUS="REGRESSION"
+  elif (( rc )); then echo "[analysis] analyse.sh failed (exit $rc)" | tee -a "$LOG"; fi
+fi
 
 echo "=== DONE: $(date) ===" | tee -a "$LOG"
 
 # -------------------------
 # FASTEST CONFIGURATION (from results.csv) — in addition to the standard summary
 # -------------------------
+# Only rows on the dataset's own input (strong scaling, DATA_PIXELS / DATA_SEARCH_LEN)
+# compete: generated sets from matrix.pixels / search_sizes / weak scaling are smaller or
+# larger inputs, so their times are not comparable (analyse.sh keeps each set apart).
 if [[ -f "$RESULTS_CSV" && "$LISTONLY" -eq 0 && "$DRYRUN" -eq 0 ]]; then
-  fastest_line=$(awk -F',' 'NR>1 && $6==1 {if(min=="" || $7<min){min=$7; line=$0}} END{print line}' "$RESULTS_CSV")
+  dataset_rows () {
+    awk -F',' -v px="$DATA_PIXELS" -v ss="$DATA_SEARCH_LEN" \
+      'NR>1 && $6==1 && $29 != "0" && $1 !~ /_seq(_pgo)?$/ && ($27=="" || $27=="strong") && ($25=="" || $25==px) && ($26=="" || $26==ss)' "$RESULTS_CSV"
+  }
+  fastest_line=$(dataset_rows | awk -F',' '{if(min=="" || $7<min){min=$7; line=$0}} END{print line}')
   if [[ -n "$fastest_line" ]]; then
-    IFS=',' read -r exe tag threads sched chunk md5_ok time_ms <<<"$fastest_line"
+    IFS=',' read -r exe tag threads sched chunk md5_ok time_ms _phases <<<"$fastest_line"
     echo
-    echo "  Fastest configuration (overall):"
+    echo "  Fastest configuration (overall, dataset input):"
     echo "  Executable : $exe"
     echo "  Tag        : $tag"
     echo "  Threads    : $threads"
@@ -421,11 +1258,11 @@ if [[ -f "$RESULTS_CSV" && "$LISTONLY" -eq 0 && "$DRYRUN" -eq 0 ]]; then
     echo "⚡ No successful timings recorded."
   fi
 
-  fastest_A=$(awk -F',' 'NR>1 && $6==1 && $1 ~ /^a_/ {if(min=="" || $7<min){min=$7; line=$0}} END{print line}' "$RESULTS_CSV")
+  fastest_A=$(dataset_rows | awk -F',' '$1 ~ /^a_/ {if(min=="" || $7<min){min=$7; line=$0}} END{print line}')
   if [[ -n "$fastest_A" ]]; then
-    IFS=',' read -r exe tag threads sched chunk md5_ok time_ms <<<"$fastest_A"
+    IFS=',' read -r exe tag threads sched chunk md5_ok time_ms _phases <<<"$fastest_A"
     echo
-    echo "  Fastest configuration (Method A):"
+    echo "  Fastest configuration (Method A, dataset input):"
     echo "  Executable : $exe"
     echo "  Tag        : $tag"
     echo "  Threads    : $threads"
@@ -434,11 +1271,11 @@ if [[ -f "$RESULTS_CSV" && "$LISTONLY" -eq 0 && "$DRYRUN" -eq 0 ]]; then
     echo "  Time (ms)  : $time_ms"
   fi
 
-  fastest_B=$(awk -F',' 'NR>1 && $6==1 && $1 ~ /^b_/ {if(min=="" || $7<min){min=$7; line=$0}} END{print line}' "$RESULTS_CSV")
+  fastest_B=$(dataset_rows | awk -F',' '$1 ~ /^b_/ {if(min=="" || $7<min){min=$7; line=$0}} END{print line}')
   if [[ -n "$fastest_B" ]]; then
-    IFS=',' read -r exe tag threads sched chunk md5_ok time_ms <<<"$fastest_B"
+    IFS=',' read -r exe tag threads sched chunk md5_ok time_ms _phases <<<"$fastest_B"
     echo
-    echo "  Fastest configuration (Method B):"
+    echo "  Fastest configuration (Method B, dataset input):"
     echo "  Executable : $exe"
     echo "  Tag        : $tag"
     echo "  Threads    : $threads"
@@ -446,6 +1283,22 @@ if [[ -f "$RESULTS_CSV" && "$LISTONLY" -eq 0 && "$DRYRUN" -eq 0 ]]; then
     echo "  Chunk      : $chunk"
     echo "  Time (ms)  : $time_ms"
   fi
+
+  # With repetitions, rank by median instead of a single run
+  if [[ -f "$STATS_CSV" ]]; then
+    for m in a b; do
+      # dataset tags carry no input-set suffix (_n<pixels>_s<search>, _weak)
+      best=$(awk -F',' -v m="^${m}_" 'NR>1 && $1 ~ m && $1 !~ /_seq(_pgo)?$/ && $2 !~ /_n[0-9]+_s[0-9]+/ && $2 !~ /_weak/ {if(min=="" || $7<min){min=$7; line=$0}} END{print line}' "$STATS_CSV")
+      [[ -n "$best" ]] || continue
+      IFS=',' read -r exe tag threads sched chunk n med mad _rel lo hi mhz _spread unstable <<<"$best"
+      echo
+      echo "  Fastest by median of $n runs (Method ${m^^}, dataset input):"
+      echo "  Executable : $exe"
+      echo "  Tag        : $tag"
+      echo "  Median (ms): $med  (MAD $mad, 95% CI $lo-$hi, ${mhz:-?} MHz)"
+      if [[ -n "$unstable" ]]; then echo "  Unstable   : $unstable"; fi
+    done
+  fi
 fi
 
 # -------------------------
@@ -464,5 +1317,9 @@ echo "  Method B -> PASSED: ${#PASSED_B[@]}  FAILED: ${#FAILED_B[@]}"
 (( ${#PASSED_B[@]} )) && echo "    ✓ $(join_by ' ' "${PASSED_B[@]}")"
 (( ${#FAILED_B[@]} )) && echo "    ✗ $(join_by ' ' "${FAILED_B[@]}")"
 echo "CSV      : $RESULTS_CSV"
+if [[ -f "$STATS_CSV" ]]; then echo "Stats    : $STATS_CSV ($REPS_CSV)"; fi
+if [[ -d "$OUTDIR/analysis" ]]; then echo "Analysis : $OUTDIR/analysis (scaling.csv, variants.csv, regressions.csv with a baseline)"; fi
+if (( REGRESSED )); then echo "Regression: slower than $ANALYSIS_BASELINE beyond threshold (see regressions.csv)"; fi
 echo "Log file : $LOG"
 echo "=============================================================="
+if (( REGRESSED )); then exit 1; fi
@@ -0,0 +1,150 @@
+// Search Index for the CSC4010 image search
+//
+// The search set is loaded as a single-line Image (see rawimage.h). The original
+// programs compare every pixel against every search entry; this index maps each
+// distinct (r,g,b) value to a "slot" so a lookup is a single hash probe.
+//
+// Counting is done per slot (one counter per distinct colour) and expanded back to
+// one counter per search entry at the end, so duplicate search entries all report
+// the same count exactly as the brute-force loop does.
+//
+// Include after rawimage.h.
+// Like rawimage.h, the functions are defined here unless RAWIMAGE_LIB is set, in
+// which case they come from librawimage.
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <stdlib.h>
+#include <string.h>
+
+// One open-addressing hash table entry (slot < 0 means empty)
+struct SearchIndexEntry {
+    int red;
+    int green;
+    int blue;
+    long slot;
+};
+
+// Struct to hold a built search index
+struct SearchIndex {
+    unsigned long length;           // number of search entries (search.length)
+    unsigned long slots;            // number of distinct colours
+    unsigned long mask;             // table size - 1 (table size is a power of two)
+    struct SearchIndexEntry *table; // hash table
+    unsigned long *slot_of;         // search entry -> slot
+};
+
+// Hash a pixel value into the table
+// r, g, b - the colour values
+static inline unsigned long SearchIndexHash(int r, int g, int b)
+{
+    unsigned long long h = (unsigned long long)(unsigned int)r * 0x9E3779B97F4A7C15ULL;
+    h ^= (unsigned long long)(unsigned int)g * 0xC2B2AE3D27D4EB4FULL;
+    h ^= (unsigned long long)(unsigned int)b * 0x165667B19E3779F9ULL;
+    h ^= h >> 29;
+    return (unsigned long)h;
+}
+
+// Find the slot for a colour
+// index - the built SearchIndex
+// r, g, b - the colour values
+// returns the slot number or -1 if the colour is not in the search set
+static inline long SearchIndexFind(const struct SearchIndex *index, int r, int g, int b)
+{
+    unsigned long pos = SearchIndexHash(r, g, b) & index->mask;
+    for (;;)
+    {
+        const struct SearchIndexEntry *e = &(index->table[pos]);
+        if (e->slot < 0)
+            return -1;
+        if (e->red == r && e->green == g && e->blue == b)
+            return e->slot;
+        pos = (pos + 1) & index->mask;
+    }
+}
+
+#ifdef RAWIMAGE_LIB
+
+// Defined in librawimage
+void SearchIndexBuild(struct SearchIndex *index, struct Image *search);
+unsigned long *SearchIndexCounters(const struct SearchIndex *index);
+void SearchIndexExpand(const struct SearchIndex *index, const unsigned long *hits, unsigned long *counter);
+void SearchIndexFree(struct SearchIndex *index);
+
+#else
+
+// Build a SearchIndex from a loaded search Image
+// index - the SearchIndex to build
+// search - the search Image (loaded with linesize 0)
+void SearchIndexBuild(struct SearchIndex *index, struct Image *search)
+{
+    unsigned long size = 16;
+    while (size < search->length * 2) // keep the load factor at or below 0.5
+        size <<= 1;
+
+    index->length = search->length;
+    index->slots = 0;
+    index->mask = size - 1;
+    index->table = (struct SearchIndexEntry*)malloc(size * sizeof(struct SearchIndexEntry));
+    index->slot_of = (unsigned long*)malloc((search->length ? search->length : 1) * sizeof(unsigned long));
+    if (index->table == NULL || index->slot_of == NULL)
+        FatalError("Cannot allocate memory for search index");
+
+    for (unsigned long i=0; i<size; ++i)
+        index->table[i].slot = -1;
+
+    for (unsigned long i=0; i<search->length; ++i)
+    {
+        struct Pixel *s = &(search->pixels[0][i]);
+        unsigned long pos = SearchIndexHash(s->red, s->green, s->blue) & index->mask;
+        while (index->table[pos].slot >= 0 &&
+               !(index->table[pos].red == s->red &&
+                 index->table[pos].green == s->green &&
+                 index->table[pos].blue == s->blue))
+            pos = (pos + 1) & index->mask;
+
+        if (index->table[pos].slot < 0) // new distinct colour
+        {
+            index->table[pos].red = s->red;
+            index->table[pos].green = s->green;
+            index->table[pos].blue = s->blue;
+            index->table[pos].slot = (long)index->slots++;
+        }
+        index->slot_of[i] = (unsigned long)index->table[pos].slot;
+    }
+}
+
+// Allocate a zeroed per-slot counter array for an index
+// index - the built SearchIndex
+unsigned long *SearchIndexCounters(const struct SearchIndex *index)
+{
+    unsigned long *hits = (unsigned long*)calloc(index->slots ? index->slots : 1, sizeof(unsigned long));
+    if (hits == NULL)
+        FatalError("Cannot allocate memory for search counters");
+    return hits;
+}
+
+// Expand per-slot counts into the per-search-entry counter array
+// index - the built SearchIndex
+// hits - per-slot counts
+// counter - output, one count per search entry (search.length long)
+void SearchIndexExpand(const struct SearchIndex *index, const unsigned long *hits, unsigned long *counter)
+{
+    for (unsigned long i=0; i<index->length; ++i)
+        counter[i] = hits[index->slot_of[i]];
+}
+
+// Free the memory held by a SearchIndex
+void SearchIndexFree(struct SearchIndex *index)
+{
+    free(index->table);
+    free(index->slot_of);
+    index->table = NULL;
+    index->slot_of = NULL;
+    index->length = index->slots = 0;
+}
+
+#endif // RAWIMAGE_LIB
+
+#endif
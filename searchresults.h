@@ -0,0 +1,193 @@
+// Search results emitter
+//
+// Every program ends with one "** (RRR,GGG,BBB) = n" line per search entry. Printed
+// with PrintRGBValue that is seven printf calls per entry, each taking the stdout
+// lock and parsing a format, which for search sets of a million entries costs more
+// than the transform. Here each line is formatted by hand (the same space padding as
+// PrintRGBValue, so the text is byte for byte the same) into one buffer that goes to
+// write(2) whenever it fills: a handful of calls for the whole block. stdout is
+// flushed first, so the block stays in order with the printf output before it.
+//
+// With RESULTS_BINARY=<path> in the environment PrintSearchResults also writes the
+// counts for machine consumers, in native byte order:
+//   header  char magic[4] "ABSR", uint32 version (1), uint64 entries
+//   entry   int32 red, green, blue, uint32 reserved (0), uint64 count
+// one 24-byte entry per search entry, in search order (duplicates included).
+//
+// Uses only struct Pixel / struct Image from rawimage.h; include after it.
+// Needs _POSIX_C_SOURCE >= 200809L.
+// Like rawimage.h, the functions are defined here unless RAWIMAGE_LIB is set, in
+// which case they come from librawimage.
+
+#ifndef SEARCHRESULTS_H
+#define SEARCHRESULTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define RESULTS_BUFSIZE (1UL << 20)  // bytes formatted per write
+#define RESULTS_LINE_MAX 96          // longest line: three 11-digit ints and a 20-digit count
+
+#define RESULTS_BINARY_MAGIC "ABSR"
+#define RESULTS_BINARY_VERSION 1
+
+struct SearchResultRecord {
+    int32_t red;
+    int32_t green;
+    int32_t blue;
+    uint32_t reserved;
+    uint64_t count;
+};
+
+#ifdef RAWIMAGE_LIB
+
+// Defined in librawimage
+size_t FormatSearchResult(char *out, const struct Pixel *px, unsigned long count);
+int WriteSearchResults(int fd, const struct Image *search, const unsigned long *counter);
+int WriteSearchResultsBinary(const char *path, const struct Image *search, const unsigned long *counter);
+void PrintSearchResults(const struct Image *search, const unsigned long *counter);
+
+#else
+
+// Write exactly n bytes (returns 0, or -1 with errno set); EINTR and short writes retried
+static int ResultsWriteAll(int fd, const void *buf, size_t n)
+{
+    const char *p = (const char*)buf;
+    while (n > 0)
+    {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0) return -1;
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+// Decimal digits of v at o; returns the end
+static char *FormatULong(char *o, unsigned long v)
+{
+    char tmp[20];
+    int n = 0;
+    do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v);
+    while (n) *o++ = tmp[--n];
+    return o;
+}
+
+// Same padding as PrintRGBValue (" 7" -> "  7", "42" -> " 42"), any int
+static char *FormatRGBValue(char *o, int value)
+{
+    if (value<100) *o++ = ' ';
+    if (value<10) *o++ = ' ';
+    if (value < 0)
+    {
+        *o++ = '-';
+        return FormatULong(o, 0UL - (unsigned long)(long)value);
+    }
+    return FormatULong(o, (unsigned long)value);
+}
+
+// One "** (RRR,GGG,BBB) = n\n" line into out (at least RESULTS_LINE_MAX bytes); returns its length
+size_t FormatSearchResult(char *out, const struct Pixel *px, unsigned long count)
+{
+    char *o = out;
+    memcpy(o, "** (", 4); o += 4;
+    o = FormatRGBValue(o, px->red);
+    *o++ = ',';
+    o = FormatRGBValue(o, px->green);
+    *o++ = ',';
+    o = FormatRGBValue(o, px->blue);
+    memcpy(o, ") = ", 4); o += 4;
+    o = FormatULong(o, count);
+    *o++ = '\n';
+    return (size_t)(o - out);
+}
+
+// The text block for every search entry to fd (returns 0, or -1 with errno set, also
+// when the buffer cannot be allocated)
+int WriteSearchResults(int fd, const struct Image *search, const unsigned long *counter)
+{
+    size_t cap = RESULTS_BUFSIZE;
+    if (search->length < cap / RESULTS_LINE_MAX) cap = (search->length + 1) * RESULTS_LINE_MAX;
+    char *buf = (char*)malloc(cap);
+    if (buf == NULL) return -1;
+    size_t used = 0;
+    int rc = 0;
+    for (unsigned long i=0; i<search->length && rc == 0; ++i)
+    {
+        if (used + RESULTS_LINE_MAX > cap)
+        {
+            rc = ResultsWriteAll(fd, buf, used);
+            used = 0;
+        }
+        used += FormatSearchResult(buf + used, &(search->pixels[0][i]), counter[i]);
+    }
+    if (rc == 0) rc = ResultsWriteAll(fd, buf, used);
+    free(buf);
+    return rc;
+}
+
+// The binary form (see above) to path, created or truncated (returns 0, or -1 with errno set)
+int WriteSearchResultsBinary(const char *path, const struct Image *search, const unsigned long *counter)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return -1;
+
+    const size_t per = RESULTS_BUFSIZE / sizeof(struct SearchResultRecord);
+    struct SearchResultRecord *rec = (struct SearchResultRecord*)malloc(per * sizeof(*rec));
+    if (rec == NULL) { close(fd); return -1; }
+
+    char header[16];
+    uint32_t version = RESULTS_BINARY_VERSION;
+    uint64_t entries = search->length;
+    memcpy(header, RESULTS_BINARY_MAGIC, 4);
+    memcpy(header + 4, &version, 4);
+    memcpy(header + 8, &entries, 8);
+    int rc = ResultsWriteAll(fd, header, sizeof(header));
+
+    for (unsigned long i=0; i<search->length && rc == 0; i += per)
+    {
+        size_t n = search->length - i < per ? search->length - i : per;
+        for (size_t k=0; k<n; ++k)
+        {
+            const struct Pixel *px = &(search->pixels[0][i + k]);
+            rec[k].red = px->red;
+            rec[k].green = px->green;
+            rec[k].blue = px->blue;
+            rec[k].reserved = 0;
+            rec[k].count = counter[i + k];
+        }
+        rc = ResultsWriteAll(fd, rec, n * sizeof(*rec));
+    }
+    free(rec);
+    if (close(fd) != 0) rc = -1;
+    return rc;
+}
+
+// Report a results error on stderr and exit, as FatalError does
+static void ResultsFail(const char *err)
+{
+    fprintf(stderr, "%s: %s\n", err, strerror(errno));
+    exit(1);
+}
+
+// The results block on stdout (after anything printf left buffered), and the binary
+// file when RESULTS_BINARY is set; exits with an error if either cannot be written
+void PrintSearchResults(const struct Image *search, const unsigned long *counter)
+{
+    fflush(stdout);
+    if (WriteSearchResults(STDOUT_FILENO, search, counter) != 0)
+        ResultsFail("Cannot write search results to stdout");
+    const char *bin = getenv("RESULTS_BINARY");
+    if (bin != NULL && *bin && WriteSearchResultsBinary(bin, search, counter) != 0)
+        ResultsFail("Cannot write binary search results (RESULTS_BINARY)");
+}
+
+#endif // RAWIMAGE_LIB
+
+#endif
@@ -0,0 +1,311 @@
+// Per-thread timeline tracing for the testcase variants
+//
+// TRACE_FILE=trace.json in the environment turns tracing on; without it every hook
+// is a single branch on a global flag. Each OpenMP thread appends complete events
+// (start + duration) to its own preallocated buffer, so recording takes no locks and
+// allocates nothing. The buffers are written at exit as Chrome trace-event JSON,
+// which chrome://tracing and https://ui.perfetto.dev open directly.
+//
+// Events recorded by the variants:
+//   region  - a thread's time inside the parallel region
+//   row     - one Method A row (loop iteration or task), args.row
+//   spawn   - the a_tc4 producer creating the row tasks
+//   block   - TRACE_BLOCK consecutive Method B pixels, args.first/last/barrier_wait_us
+//   barrier - a wait at a team barrier (PhaseBarrier); inside a block only waits of at
+//             least TRACE_MIN_WAIT_US are recorded (all of them count towards the block)
+//   merge   - combining thread-local counters
+// plus the PhaseTimer phases on their own "phases" track and, per thread, a
+// "barrier wait %" counter sampled once per block.
+//
+// TRACE_EVENTS sets the per-thread buffer size (default 131072 events); events past
+// it are dropped and counted in the summary line on stderr. TRACE_BLOCK (pixels,
+// default 4096) and TRACE_MIN_WAIT_US (default 100) tune Method B's granularity.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+#define TRACE_PHASE_EVENTS 64  // size of the phases track
+
+enum TraceKind {
+    TRACE_REGION,
+    TRACE_ROW,
+    TRACE_SPAWN,
+    TRACE_BLOCK,
+    TRACE_BARRIER,
+    TRACE_MERGE,
+    TRACE_PHASE,
+    TRACE_KIND_COUNT
+};
+
+static const char *const TraceKindNames[TRACE_KIND_COUNT] = {
+    "region", "row", "spawn", "block", "barrier", "merge", "phase"
+};
+
+struct TraceRecord {
+    double ts;              // start (omp_get_wtime)
+    double dur;             // seconds
+    double wait;            // barrier wait inside a block, seconds
+    unsigned long a0, a1;   // row, or first/last pixel of a block
+    const char *name;       // phase name (TRACE_PHASE only)
+    int kind;
+};
+
+// One thread's buffer; aligned so neighbouring threads never share a cache line
+struct TraceBuffer {
+    _Alignas(64) struct TraceRecord *rec;
+    unsigned long n;
+    unsigned long dropped;
+    int inblock;            // a Method B block is open
+    unsigned long blockfirst;
+    double blockstart;
+    double blockwait;
+};
+
+struct TraceState {
+    int on;
+    int nthreads;           // team buffers; buf[nthreads] is the phases track
+    unsigned long cap;
+    unsigned long blocksize;
+    double minwait;         // seconds
+    double start;
+    const char *file;
+    const char *exe;
+    struct TraceBuffer *buf;
+};
+
+struct TraceState Trace;    // zero: tracing off
+
+// Read an unsigned setting from the environment (def if unset or invalid)
+static unsigned long TraceEnv(const char *name, unsigned long def)
+{
+    const char *s = getenv(name);
+    if (s == NULL || *s == '\0') return def;
+    char *end;
+    unsigned long v = strtoul(s, &end, 10);
+    return (*end == '\0' && v > 0) ? v : def;
+}
+
+void TraceWrite(void);
+
+// Allocate the per-thread buffers if TRACE_FILE is set (called from PhaseInit)
+void TraceInit(void)
+{
+    const char *file = getenv("TRACE_FILE");
+    if (file == NULL || *file == '\0') return;
+
+    int nthreads = omp_get_max_threads();
+    unsigned long cap = TraceEnv("TRACE_EVENTS", 131072);
+    struct TraceBuffer *buf = NULL;
+    if (posix_memalign((void**)&buf, 64, (size_t)(nthreads + 1) * sizeof(struct TraceBuffer)) != 0)
+    {
+        fprintf(stderr, "TRACE disabled: out of memory\n");
+        return;
+    }
+    memset(buf, 0, (size_t)(nthreads + 1) * sizeof(struct TraceBuffer));
+
+    // each thread allocates and touches its own buffer, so the pages are local to it
+    // and no page faults land inside the traced loops
+    int failed = 0;
+    #pragma omp parallel num_threads(nthreads) default(none) shared(buf, cap, failed)
+    {
+        int me = omp_get_thread_num();
+        buf[me].rec = (struct TraceRecord*)malloc(cap * sizeof(struct TraceRecord));
+        if (buf[me].rec == NULL)
+        {
+            #pragma omp atomic write
+            failed = 1;
+        }
+        else memset(buf[me].rec, 0, cap * sizeof(struct TraceRecord));
+    }
+    buf[nthreads].rec = (struct TraceRecord*)calloc(TRACE_PHASE_EVENTS, sizeof(struct TraceRecord));
+    if (failed || buf[nthreads].rec == NULL)
+    {
+        for (int th=0; th<=nthreads; ++th) free(buf[th].rec);
+        free(buf);
+        fprintf(stderr, "TRACE disabled: cannot allocate %lu events per thread (lower TRACE_EVENTS)\n", cap);
+        return;
+    }
+
+    Trace.nthreads = nthreads;
+    Trace.cap = cap;
+    Trace.blocksize = TraceEnv("TRACE_BLOCK", 4096);
+    Trace.minwait = (double)TraceEnv("TRACE_MIN_WAIT_US", 100) * 1e-6;
+    Trace.file = file;
+    Trace.exe = "";
+    Trace.buf = buf;
+    Trace.start = omp_get_wtime();
+    Trace.on = 1;
+    atexit(TraceWrite);
+}
+
+// Name the traced executable (shown as the process name)
+void TraceName(const char *exe)
+{
+    Trace.exe = exe;
+}
+
+// Current time for a later TraceSpan (0 when tracing is off)
+double TraceNow(void)
+{
+    return Trace.on ? omp_get_wtime() : 0.0;
+}
+
+// Append a record to a buffer (dropped and counted when the buffer is full)
+static struct TraceRecord *TraceAppend(struct TraceBuffer *b, unsigned long cap, int kind, double start, double end)
+{
+    if (b->n >= cap)
+    {
+        b->dropped++;
+        return NULL;
+    }
+    struct TraceRecord *r = &b->rec[b->n++];
+    r->kind = kind;
+    r->ts = start;
+    r->dur = end - start;
+    return r;
+}
+
+// The calling thread's buffer (NULL if tracing is off or the thread has none)
+static struct TraceBuffer *TraceBuf(void)
+{
+    if (!Trace.on) return NULL;
+    int me = omp_get_thread_num();
+    return me < Trace.nthreads ? &Trace.buf[me] : NULL;
+}
+
+// Record an event on the calling thread from start (TraceNow) until now
+// kind - what the thread was doing
+// arg - the row for TRACE_ROW, otherwise ignored
+void TraceSpan(enum TraceKind kind, double start, unsigned long arg)
+{
+    struct TraceBuffer *b = TraceBuf();
+    if (b == NULL) return;
+    struct TraceRecord *r = TraceAppend(b, Trace.cap, kind, start, omp_get_wtime());
+    if (r != NULL) r->a0 = arg;
+}
+
+// Record that the calling thread waited at a barrier from start to end
+void TraceWait(double start, double end)
+{
+    struct TraceBuffer *b = TraceBuf();
+    if (b == NULL) return;
+    if (b->inblock)
+    {
+        b->blockwait += end - start;
+        if (end - start < Trace.minwait) return;
+    }
+    TraceAppend(b, Trace.cap, TRACE_BARRIER, start, end);
+}
+
+// Close the calling thread's open block at pixel last
+static void TraceBlockClose(struct TraceBuffer *b, double now, unsigned long last)
+{
+    struct TraceRecord *r = TraceAppend(b, Trace.cap, TRACE_BLOCK, b->blockstart, now);
+    if (r != NULL)
+    {
+        r->a0 = b->blockfirst;
+        r->a1 = last;
+        r->wait = b->blockwait;
+    }
+    b->inblock = 0;
+}
+
+// Mark that the calling thread starts Method B pixel p; every TRACE_BLOCK pixels
+// the previous block is recorded and a new one opened
+void TraceBlock(unsigned long p)
+{
+    struct TraceBuffer *b = TraceBuf();
+    if (b == NULL || p % Trace.blocksize != 0) return;
+    double now = omp_get_wtime();
+    if (b->inblock) TraceBlockClose(b, now, p - 1);
+    b->inblock = 1;
+    b->blockfirst = p;
+    b->blockstart = now;
+    b->blockwait = 0.0;
+}
+
+// Record the calling thread's last block once the pixel loop is done
+// end - one past the last pixel processed
+void TraceBlockEnd(unsigned long end)
+{
+    struct TraceBuffer *b = TraceBuf();
+    if (b == NULL || !b->inblock) return;
+    TraceBlockClose(b, omp_get_wtime(), end - 1);
+}
+
+// Record a PhaseTimer phase on the phases track (outside parallel regions only)
+void TracePhase(const char *name, double start, double end)
+{
+    if (!Trace.on) return;
+    struct TraceRecord *r = TraceAppend(&Trace.buf[Trace.nthreads], TRACE_PHASE_EVENTS, TRACE_PHASE, start, end);
+    if (r != NULL) r->name = name;
+}
+
+// Write the buffers as Chrome trace-event JSON (registered with atexit by TraceInit)
+void TraceWrite(void)
+{
+    if (!Trace.on) return;
+    Trace.on = 0;
+
+    FILE *f = fopen(Trace.file, "w");
+    if (f == NULL)
+    {
+        fprintf(stderr, "TRACE cannot write %s\n", Trace.file);
+        return;
+    }
+
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"%s\"}}", Trace.exe);
+    for (int th=0; th<=Trace.nthreads; ++th)
+    {
+        if (th < Trace.nthreads)
+            fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", th, th);
+        else
+            fprintf(f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"phases\"}}", th);
+        fprintf(f, ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"sort_index\":%d}}",
+            th, th < Trace.nthreads ? th + 1 : 0);
+    }
+
+    unsigned long events = 0, dropped = 0;
+    for (int th=0; th<=Trace.nthreads; ++th)
+    {
+        const struct TraceBuffer *b = &Trace.buf[th];
+        dropped += b->dropped;
+        for (unsigned long k=0; k<b->n; ++k)
+        {
+            const struct TraceRecord *r = &b->rec[k];
+            double ts = (r->ts - Trace.start) * 1e6, dur = r->dur * 1e6;
+            const char *name = r->kind == TRACE_PHASE ? r->name : TraceKindNames[r->kind];
+            fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                name, TraceKindNames[r->kind], th, ts, dur);
+            if (r->kind == TRACE_ROW)
+                fprintf(f, ",\"args\":{\"row\":%lu}}", r->a0);
+            else if (r->kind == TRACE_BLOCK)
+            {
+                fprintf(f, ",\"args\":{\"first\":%lu,\"last\":%lu,\"barrier_wait_us\":%.3f}}",
+                    r->a0, r->a1, r->wait * 1e6);
+                fprintf(f, ",\n{\"name\":\"barrier wait %% (thread %d)\",\"ph\":\"C\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                           "\"args\":{\"wait\":%.2f}}",
+                    th, th, ts, r->dur > 0 ? 100.0 * r->wait / r->dur : 0.0);
+            }
+            else
+                fprintf(f, "}");
+            events++;
+        }
+    }
+    fprintf(f, "\n]}\n");
+
+    if (fclose(f) != 0)
+        fprintf(stderr, "TRACE error writing %s\n", Trace.file);
+    else
+        fprintf(stderr, "TRACE file=%s events=%lu dropped=%lu threads=%d\n", Trace.file, events, dropped, Trace.nthreads);
+    for (int th=0; th<=Trace.nthreads; ++th) free(Trace.buf[th].rec);
+    free(Trace.buf);
+}
+
+#endif
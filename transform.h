@@ -0,0 +1,97 @@
+// Transform kernel shared by the batch/service tools
+//
+// Applies exactly the per-pixel work of process-a.c / process-b.c to a run of
+// pixels on one line: search the original value, bleed from up to 10 pixels to
+// the left, Greyscale, XOR by 13, then search the new value.
+//
+// Pixels before `start` on the line must already be transformed, which is what
+// allows a line to be processed in pieces (and resumed) with identical output.
+//
+// Include after rawimage.h and searchindex.h.
+// Like rawimage.h, the functions are defined here unless RAWIMAGE_LIB is set, in
+// which case they come from librawimage.
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#define BLEED_WINDOW 10
+#define XOR_VALUE 13
+
+// Count a pixel against the search index
+// index - the SearchIndex (NULL skips searching)
+// px - the pixel to look up
+// hits - per-slot counters
+static inline void SearchCount(const struct SearchIndex *index, const struct Pixel *px, unsigned long *hits)
+{
+    if (index == NULL)
+        return;
+    long slot = SearchIndexFind(index, px->red, px->green, px->blue);
+    if (slot >= 0)
+        hits[slot]++;
+}
+
+#ifdef RAWIMAGE_LIB
+
+// Defined in librawimage
+void TransformRange(struct Pixel *line, unsigned long start, unsigned long end,
+                    const struct SearchIndex *index, unsigned long *hits);
+
+#else
+
+// Transform (and search) the pixels [start, end) of one line
+// line - the line of pixels, pixels before start already transformed
+// start - first pixel (line position) to transform
+// end - one past the last pixel to transform
+// index - the SearchIndex to count against (NULL for no searching)
+// hits - per-slot counters to add matches to (may be NULL if index is NULL)
+void TransformRange(struct Pixel *line, unsigned long start, unsigned long end,
+                    const struct SearchIndex *index, unsigned long *hits)
+{
+    // running sums of the (already transformed) bleed window to the left of p
+    int rsum = 0, gsum = 0, bsum = 0;
+    unsigned long first = (start > BLEED_WINDOW) ? start - BLEED_WINDOW : 0;
+    for (unsigned long i=first; i<start; ++i)
+    {
+        rsum += line[i].red;
+        gsum += line[i].green;
+        bsum += line[i].blue;
+    }
+
+    for (unsigned long p=start; p<end; ++p)
+    {
+        struct Pixel *px = &(line[p]);
+
+        // Search for the original values
+        SearchCount(index, px, hits);
+
+        // "Bleed" colours from left to right up to 10 pixels (if we have pixels to the left)
+        if (p > 0)
+        {
+            int pixlen = (p > BLEED_WINDOW) ? BLEED_WINDOW : (int)p;
+            px->red += (rsum / pixlen - px->red) / 3;
+            px->green += (gsum / pixlen - px->green) / 3;
+            px->blue += (bsum / pixlen - px->blue) / 3;
+        }
+
+        Greyscale(px);
+        XOR(px, XOR_VALUE);
+
+        // Now search for the new grey and XOR values
+        SearchCount(index, px, hits);
+
+        // slide the window on to include p
+        rsum += px->red;
+        gsum += px->green;
+        bsum += px->blue;
+        if (p >= BLEED_WINDOW)
+        {
+            rsum -= line[p - BLEED_WINDOW].red;
+            gsum -= line[p - BLEED_WINDOW].green;
+            bsum -= line[p - BLEED_WINDOW].blue;
+        }
+    }
+}
+
+#endif // RAWIMAGE_LIB
+
+#endif